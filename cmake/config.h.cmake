@@ -1 +1,8 @@
 #cmakedefine HAVE_GCC_VISIBILITY
+#cmakedefine SQLITE3_SERIALIZED
+#cmakedefine SQLITE3_MEMSTATUS
+#cmakedefine HAVE_SQLITE3_SNAPSHOT
+#cmakedefine HAVE_SQLITE3_SESSION
+#cmakedefine HAVE_SQLITE3_PREUPDATE_HOOK
+#cmakedefine HAVE_SQLITE3_COLUMN_METADATA
+#cmakedefine HAVE_SQLITE3_PREPARE_V3
@@ -44,7 +44,7 @@
 
 Summary: SQLite3 DBI module for Qore
 Name: qore-sqlite3-module
-Version: 1.1.0
+Version: 1.2.0
 Release: 1%{dist}
 License: LGPL
 Group: Development/Languages
@@ -61,6 +61,7 @@ BuildRequires:  devtoolset-7-gcc-c++
 BuildRequires: qore-devel
 BuildRequires: qore
 BuildRequires: openssl-devel
+BuildRequires: zlib-devel
 # Sqlite RPM package name are different in distros
 %if 0%{?suse_version}
 Requires: sqlite3
@@ -114,9 +115,12 @@ This RPM provides API documentation, test and example programs
 
 %files doc
 %defattr(-,root,root,-)
-%doc docs/sqlite3/html test/basic.qtest test/sqlite3test-threading.q test/blob.png
+%doc docs/sqlite3/html test/basic.qtest test/sqlite3test-threading.q test/sqlite3-bench.q test/blob.png
 
 %changelog
+* Sun Oct 18 2026 Qore Technologies <info@qoretechnologies.com>
+- updated to version 1.2.0
+
 * Mon May 2 2022 David Nichols <david.nichols@qoretechnologies.com>
 - updated to version 1.1.0
 
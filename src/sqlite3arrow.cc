@@ -0,0 +1,507 @@
+/*
+    sqlite3arrow.cc
+
+    Qore Programming Language
+
+    Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "sqlite3arrow.h"
+#include "sqlite3module.h"
+
+#include <string.h>
+#include <strings.h>
+
+// a batch is also written when the variable-length data of a column reaches this size, so that value offsets fit in
+// 32 bits
+#define QORE_SQLITE3_ARROW_MAX_DATA (1 << 30)
+
+// Arrow metadata constants (see Schema.fbs and Message.fbs in the Arrow format specification)
+#define ARROW_METADATA_V5       4
+#define ARROW_HEADER_SCHEMA     1
+#define ARROW_HEADER_BATCH      3
+#define ARROW_TYPE_INT          2
+#define ARROW_TYPE_FLOAT        3
+#define ARROW_TYPE_BINARY       4
+#define ARROW_TYPE_UTF8         5
+#define ARROW_PRECISION_DOUBLE  2
+
+static const uint32_t arrow_continuation = 0xffffffff;
+static const char arrow_padding[8] = {};
+
+namespace {
+/*! \brief A minimal flatbuffer builder for Arrow message metadata.
+
+    Like the reference implementation, the buffer is built back to front, so that objects are created before the
+    objects referring to them; positions are offsets from the end of the buffer.  Metadata is small, so bytes are
+    simply inserted at the front.  Scalars are written in host byte order, which must be little-endian.
+*/
+class ArrowFlatBuilder {
+public:
+    uint32_t size() const {
+        return (uint32_t)buf.size();
+    }
+
+    //! Creates a string and returns its position
+    uint32_t createString(const std::string& str) {
+        align(str.size() + 1, 4);
+        pad(1);
+        prepend(str.data(), str.size());
+        return push<uint32_t>((uint32_t)str.size());
+    }
+
+    //! Creates a vector of objects and returns its position
+    uint32_t createVector(const std::vector<uint32_t>& v) {
+        align(v.size() * 4, 4);
+        for (size_t i = v.size(); i; --i) {
+            pushOffset(v[i - 1]);
+        }
+        return push<uint32_t>((uint32_t)v.size());
+    }
+
+    //! Creates a vector of structs of 8-byte aligned fields and returns its position
+    uint32_t createStructVector(const void* data, size_t count, size_t struct_size) {
+        align(count * struct_size, 8);
+        prepend(data, count * struct_size);
+        return push<uint32_t>((uint32_t)count);
+    }
+
+    void startTable() {
+        fields.clear();
+        table_start = size();
+    }
+
+    template <typename T>
+    void addScalar(uint16_t id, T v) {
+        fields.push_back({id, push<T>(v)});
+    }
+
+    void addOffset(uint16_t id, uint32_t pos) {
+        align(4, 4);
+        fields.push_back({id, pushOffset(pos)});
+    }
+
+    //! Finishes a table and returns its position
+    uint32_t endTable() {
+        push<int32_t>(0);
+        uint32_t table_pos = size();
+
+        uint16_t nfields = 0;
+        for (const auto& f : fields) {
+            if (f.id >= nfields) {
+                nfields = f.id + 1;
+            }
+        }
+        std::vector<uint16_t> vt(nfields, 0);
+        for (const auto& f : fields) {
+            vt[f.id] = (uint16_t)(table_pos - f.pos);
+        }
+        for (size_t i = nfields; i; --i) {
+            push<uint16_t>(vt[i - 1]);
+        }
+        push<uint16_t>((uint16_t)(table_pos - table_start));
+        push<uint16_t>((uint16_t)((nfields + 2) * 2));
+
+        // the table refers to its vtable, which precedes it
+        int32_t vt_offset = (int32_t)(size() - table_pos);
+        memcpy(&buf[size() - table_pos], &vt_offset, 4);
+        return table_pos;
+    }
+
+    //! Finishes the buffer with the given root table and returns it; the size is a multiple of 8
+    std::string finish(uint32_t root) {
+        align(4, 8);
+        pushOffset(root);
+        return std::string(buf.begin(), buf.end());
+    }
+
+private:
+    struct Field {
+        uint16_t id;
+        uint32_t pos;
+    };
+
+    std::vector<char> buf;
+    std::vector<Field> fields;
+    uint32_t table_start = 0;
+
+    void prepend(const void* data, size_t len) {
+        buf.insert(buf.begin(), (const char*)data, (const char*)data + len);
+    }
+
+    void pad(size_t len) {
+        buf.insert(buf.begin(), len, 0);
+    }
+
+    // pads the buffer so that it is aligned after prepending len bytes
+    void align(size_t len, size_t alignment) {
+        pad((alignment - (buf.size() + len) % alignment) % alignment);
+    }
+
+    template <typename T>
+    uint32_t push(T v) {
+        align(sizeof(T), sizeof(T));
+        prepend(&v, sizeof(T));
+        return size();
+    }
+
+    // offsets point forward from their own position
+    uint32_t pushOffset(uint32_t pos) {
+        uint32_t v = size() + 4 - pos;
+        prepend(&v, 4);
+        return size();
+    }
+};
+}
+
+// returns the type for a declared column type with a clear affinity; columns without a declared type and with
+// NUMERIC affinity take the type of their first non-null value
+static QoreSqlite3ArrowType get_declared_type(const char* decl) {
+    if (!decl || !*decl) {
+        return SQLITE3_ARROW_AUTO;
+    }
+    switch (qore_sqlite3_get_affinity(decl)) {
+        case QORE_SQLITE3_AFF_INTEGER: return SQLITE3_ARROW_INT64;
+        case QORE_SQLITE3_AFF_TEXT: return SQLITE3_ARROW_UTF8;
+        case QORE_SQLITE3_AFF_BLOB: return SQLITE3_ARROW_BINARY;
+        case QORE_SQLITE3_AFF_REAL: return SQLITE3_ARROW_FLOAT64;
+        default: return SQLITE3_ARROW_AUTO;
+    }
+}
+
+// returns the type for a value of the given storage class
+static QoreSqlite3ArrowType get_value_type(int storage) {
+    switch (storage) {
+        case SQLITE_INTEGER: return SQLITE3_ARROW_INT64;
+        case SQLITE_FLOAT: return SQLITE3_ARROW_FLOAT64;
+        case SQLITE_BLOB: return SQLITE3_ARROW_BINARY;
+        default: return SQLITE3_ARROW_UTF8;
+    }
+}
+
+// returns true if a value of the given storage class can be stored in a column of the given type without losing
+// data: integers as doubles, numbers as strings and text as binary
+static bool is_compatible(QoreSqlite3ArrowType type, int storage) {
+    switch (type) {
+        case SQLITE3_ARROW_INT64: return storage == SQLITE_INTEGER;
+        case SQLITE3_ARROW_FLOAT64: return storage == SQLITE_FLOAT || storage == SQLITE_INTEGER;
+        case SQLITE3_ARROW_UTF8: return storage != SQLITE_BLOB;
+        default: return storage == SQLITE_BLOB || storage == SQLITE_TEXT;
+    }
+}
+
+static const char* get_type_name(QoreSqlite3ArrowType type) {
+    switch (type) {
+        case SQLITE3_ARROW_INT64: return "int";
+        case SQLITE3_ARROW_FLOAT64: return "float";
+        case SQLITE3_ARROW_BINARY: return "binary";
+        default: return "string";
+    }
+}
+
+static const char* get_storage_name(int storage) {
+    switch (storage) {
+        case SQLITE_INTEGER: return "integer";
+        case SQLITE_FLOAT: return "real";
+        case SQLITE_BLOB: return "blob";
+        default: return "text";
+    }
+}
+
+QoreSqlite3ArrowWriter::QoreSqlite3ArrowWriter(sqlite3_stmt* stmt, size_t batch_rows, Output out)
+        : stmt(stmt), batch_rows(batch_rows ? batch_rows : 1), out(out) {
+    int n = sqlite3_column_count(stmt);
+    cols.resize(n);
+    for (int i = 0; i < n; ++i) {
+        cols[i].name = sqlite3_column_name(stmt, i);
+    }
+}
+
+int QoreSqlite3ArrowWriter::setType(const char* name, QoreSqlite3ArrowType type) {
+    for (auto& c : cols) {
+        if (c.name == name) {
+            c.type = type;
+            c.convert = true;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void QoreSqlite3ArrowWriter::setType(Column& c, QoreSqlite3ArrowType type) {
+    c.type = type;
+    // the rows already in the batch are null
+    if (type == SQLITE3_ARROW_UTF8 || type == SQLITE3_ARROW_BINARY) {
+        c.offsets.assign(batch_size + 1, 0);
+    } else {
+        c.data.assign(batch_size * 8, '\0');
+    }
+}
+
+int QoreSqlite3ArrowWriter::append(std::string& err) {
+    size_t bit = batch_size % 8;
+    for (int i = 0, e = (int)cols.size(); i < e; ++i) {
+        Column& c = cols[i];
+        if (!bit) {
+            c.validity.push_back(0);
+        }
+        int storage = sqlite3_column_type(stmt, i);
+        bool null = storage == SQLITE_NULL;
+        if (null) {
+            ++c.nulls;
+        } else {
+            c.validity.back() |= (char)(1 << bit);
+            if (c.type == SQLITE3_ARROW_AUTO) {
+                // the type of a column without a declared type is taken from its first non-null value
+                setType(c, get_value_type(storage));
+                c.inferred = true;
+            } else if (!c.convert && !is_compatible(c.type, storage)) {
+                if (c.inferred && !schema_written && c.type == SQLITE3_ARROW_INT64 && storage == SQLITE_FLOAT) {
+                    // the integers in the batch are converted, as the schema has not been written yet
+                    for (size_t j = 0; j < c.data.size(); j += 8) {
+                        int64 iv;
+                        memcpy(&iv, &c.data[j], 8);
+                        double dv = (double)iv;
+                        memcpy(&c.data[j], &dv, 8);
+                    }
+                    c.type = SQLITE3_ARROW_FLOAT64;
+                } else {
+                    err = "column '" + c.name + "' is exported as type '" + get_type_name(c.type) + "' but row "
+                        + std::to_string(rows + 1) + " has a value with storage class '" + get_storage_name(storage)
+                        + "'; set the type of the column with the 'types' option to convert its values";
+                    return -1;
+                }
+            }
+        }
+        if (c.type == SQLITE3_ARROW_AUTO) {
+            // the type is not known yet; the buffers are filled when it is
+            continue;
+        }
+
+        switch (c.type) {
+            case SQLITE3_ARROW_INT64: {
+                int64 v = null ? 0 : sqlite3_column_int64(stmt, i);
+                c.data.append((const char*)&v, sizeof(v));
+                break;
+            }
+            case SQLITE3_ARROW_FLOAT64: {
+                double v = null ? 0 : sqlite3_column_double(stmt, i);
+                c.data.append((const char*)&v, sizeof(v));
+                break;
+            }
+            default: {
+                if (c.offsets.empty()) {
+                    c.offsets.push_back(0);
+                }
+                if (!null) {
+                    const void* p = c.type == SQLITE3_ARROW_UTF8
+                        ? (const void*)sqlite3_column_text(stmt, i)
+                        : sqlite3_column_blob(stmt, i);
+                    c.data.append((const char*)p, sqlite3_column_bytes(stmt, i));
+                }
+                c.offsets.push_back((int32_t)c.data.size());
+                break;
+            }
+        }
+    }
+    ++batch_size;
+    ++rows;
+    return 0;
+}
+
+int QoreSqlite3ArrowWriter::writeMessage(const std::string& meta) {
+    // the metadata is padded so that the body starts at a multiple of 8 bytes
+    uint32_t len = (uint32_t)((meta.size() + 7) & ~(size_t)7);
+    if (out(&arrow_continuation, 4) || out(&len, 4) || out(meta.data(), meta.size())) {
+        return -1;
+    }
+    return len > meta.size() ? out(arrow_padding, len - meta.size()) : 0;
+}
+
+int QoreSqlite3ArrowWriter::writeBuffer(const void* data, size_t len) {
+    if (len && out(data, len)) {
+        return -1;
+    }
+    return len % 8 ? out(arrow_padding, 8 - len % 8) : 0;
+}
+
+int QoreSqlite3ArrowWriter::writeSchema() {
+    // columns that only had nulls so far are exported as strings
+    for (auto& c : cols) {
+        if (c.type == SQLITE3_ARROW_AUTO) {
+            setType(c, SQLITE3_ARROW_UTF8);
+        }
+    }
+    schema_written = true;
+
+    ArrowFlatBuilder b;
+    std::vector<uint32_t> fields;
+    for (const auto& c : cols) {
+        uint32_t name = b.createString(c.name);
+        uint32_t children = b.createVector(std::vector<uint32_t>());
+        uint8_t type_type;
+        b.startTable();
+        switch (c.type) {
+            case SQLITE3_ARROW_INT64:
+                type_type = ARROW_TYPE_INT;
+                b.addScalar<int32_t>(0, 64);
+                b.addScalar<uint8_t>(1, 1);
+                break;
+            case SQLITE3_ARROW_FLOAT64:
+                type_type = ARROW_TYPE_FLOAT;
+                b.addScalar<int16_t>(0, ARROW_PRECISION_DOUBLE);
+                break;
+            case SQLITE3_ARROW_BINARY:
+                type_type = ARROW_TYPE_BINARY;
+                break;
+            default:
+                type_type = ARROW_TYPE_UTF8;
+                break;
+        }
+        uint32_t type = b.endTable();
+
+        b.startTable();
+        b.addOffset(0, name);
+        b.addScalar<uint8_t>(1, 1);
+        b.addScalar<uint8_t>(2, type_type);
+        b.addOffset(3, type);
+        b.addOffset(5, children);
+        fields.push_back(b.endTable());
+    }
+    uint32_t field_vector = b.createVector(fields);
+
+    b.startTable();
+    b.addOffset(1, field_vector);
+    uint32_t schema = b.endTable();
+
+    b.startTable();
+    b.addScalar<int64_t>(3, 0);
+    b.addOffset(2, schema);
+    b.addScalar<int16_t>(0, ARROW_METADATA_V5);
+    b.addScalar<uint8_t>(1, ARROW_HEADER_SCHEMA);
+    return writeMessage(b.finish(b.endTable()));
+}
+
+int QoreSqlite3ArrowWriter::writeBatch() {
+    // the schema is written with the first batch, so that column types can be taken from its values
+    if (!schema_written && writeSchema()) {
+        return -1;
+    }
+
+    // the field nodes and buffers as defined in Message.fbs
+    std::vector<int64_t> nodes;
+    std::vector<int64_t> buffers;
+    int64_t body_len = 0;
+    auto add_buffer = [&buffers, &body_len] (size_t len) {
+        buffers.push_back(body_len);
+        buffers.push_back((int64_t)len);
+        body_len += (len + 7) & ~(size_t)7;
+    };
+
+    for (const auto& c : cols) {
+        nodes.push_back((int64_t)batch_size);
+        nodes.push_back(c.nulls);
+        // the validity bitmap may be omitted if there are no nulls
+        add_buffer(c.nulls ? c.validity.size() : 0);
+        if (c.type == SQLITE3_ARROW_UTF8 || c.type == SQLITE3_ARROW_BINARY) {
+            add_buffer(c.offsets.size() * 4);
+        }
+        add_buffer(c.data.size());
+    }
+
+    ArrowFlatBuilder b;
+    uint32_t node_vector = b.createStructVector(nodes.data(), cols.size(), 16);
+    uint32_t buffer_vector = b.createStructVector(buffers.data(), buffers.size() / 2, 16);
+    b.startTable();
+    b.addScalar<int64_t>(0, (int64_t)batch_size);
+    b.addOffset(1, node_vector);
+    b.addOffset(2, buffer_vector);
+    uint32_t batch = b.endTable();
+
+    b.startTable();
+    b.addScalar<int64_t>(3, body_len);
+    b.addOffset(2, batch);
+    b.addScalar<int16_t>(0, ARROW_METADATA_V5);
+    b.addScalar<uint8_t>(1, ARROW_HEADER_BATCH);
+    if (writeMessage(b.finish(b.endTable()))) {
+        return -1;
+    }
+
+    for (auto& c : cols) {
+        if (writeBuffer(c.validity.data(), c.nulls ? c.validity.size() : 0)) {
+            return -1;
+        }
+        if ((c.type == SQLITE3_ARROW_UTF8 || c.type == SQLITE3_ARROW_BINARY)
+            && writeBuffer(c.offsets.data(), c.offsets.size() * 4)) {
+            return -1;
+        }
+        if (writeBuffer(c.data.data(), c.data.size())) {
+            return -1;
+        }
+        c.validity.clear();
+        c.offsets.clear();
+        c.data.clear();
+        c.nulls = 0;
+    }
+    batch_size = 0;
+    return 0;
+}
+
+int QoreSqlite3ArrowWriter::run(std::string& err) {
+    const uint16_t endian_test = 1;
+    if (*(const char*)&endian_test != 1) {
+        err = "Arrow export is only supported on little-endian platforms";
+        return -1;
+    }
+
+    for (size_t i = 0; i < cols.size(); ++i) {
+        if (cols[i].type == SQLITE3_ARROW_AUTO) {
+            cols[i].type = get_declared_type(sqlite3_column_decltype(stmt, (int)i));
+        }
+    }
+
+    int rc = sqlite3_step(stmt);
+    for (; rc == SQLITE_ROW; rc = sqlite3_step(stmt)) {
+        if (append(err)) {
+            return -1;
+        }
+        bool full = batch_size == batch_rows;
+        for (size_t i = 0; !full && i < cols.size(); ++i) {
+            full = cols[i].data.size() >= QORE_SQLITE3_ARROW_MAX_DATA;
+        }
+        if (full && writeBatch()) {
+            err = "cannot write the output";
+            return -1;
+        }
+    }
+    if (rc != SQLITE_DONE) {
+        err = sqlite3_errmsg(sqlite3_db_handle(stmt));
+        return -1;
+    }
+    if ((!schema_written && writeSchema()) || (batch_size && writeBatch())) {
+        err = "cannot write the output";
+        return -1;
+    }
+
+    // end-of-stream marker
+    const uint32_t eos[2] = {arrow_continuation, 0};
+    if (out(eos, sizeof(eos))) {
+        err = "cannot write the output";
+        return -1;
+    }
+    return 0;
+}
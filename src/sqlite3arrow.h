@@ -0,0 +1,131 @@
+/*
+  sqlite3arrow.h
+
+  Qore Programming Language
+
+  Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SQLITE3ARROW_H
+#define SQLITE3ARROW_H
+
+#include <sqlite3.h>
+#include <qore/Qore.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+//! The Arrow type of an exported column
+enum QoreSqlite3ArrowType {
+    SQLITE3_ARROW_AUTO,
+    SQLITE3_ARROW_INT64,
+    SQLITE3_ARROW_FLOAT64,
+    SQLITE3_ARROW_UTF8,
+    SQLITE3_ARROW_BINARY,
+};
+
+/*! \brief Writes the result set of a statement in the Arrow IPC streaming format.
+
+    Values are copied directly from the sqlite3_column_*() functions into typed column buffers with validity
+    bitmaps, and a record batch is written each time the batch size is reached, so no Qore values are created for
+    the rows and memory use is bounded by the batch size.
+
+    Column types are taken from the declared type of the column if it has a clear affinity and otherwise from the
+    storage class of the first non-null value, in which case the schema is written with the first batch.  Integers
+    are accepted in float columns, numbers in string columns and text in binary columns; an integer column whose
+    type was taken from a value becomes a float column if a float is found in the first batch.  Any other value
+    raises an error, unless the type was set with setType(), in which case values are converted by sqlite3.
+
+    This class only uses the sqlite3 API, so it can run on any thread.
+*/
+class QoreSqlite3ArrowWriter {
+public:
+    //! Writes data to the output; returns 0 on success, -1 on error
+    typedef std::function<int (const void* data, size_t len)> Output;
+
+    /*! \brief Creates the writer.
+
+        \param stmt a prepared statement with its parameters bound
+        \param batch_rows the maximum number of rows in a record batch
+        \param out the output function
+    */
+    DLLLOCAL QoreSqlite3ArrowWriter(sqlite3_stmt* stmt, size_t batch_rows, Output out);
+
+    //! Sets the type of a column; returns -1 if there is no column with the given name
+    DLLLOCAL int setType(const char* name, QoreSqlite3ArrowType type);
+
+    /*! \brief Runs the statement and writes the stream.
+
+        \param err the error message on error
+
+        \retval int 0 on success, -1 on error
+    */
+    DLLLOCAL int run(std::string& err);
+
+    //! Returns the number of rows written
+    DLLLOCAL int64 getRows() const {
+        return rows;
+    }
+
+private:
+    //! The buffers of a column for the current batch
+    struct Column {
+        std::string name;
+        QoreSqlite3ArrowType type = SQLITE3_ARROW_AUTO;
+        //! one bit per row, set for non-null values
+        std::string validity;
+        //! value offsets of variable-length columns
+        std::vector<int32_t> offsets;
+        //! fixed-size values or the bytes of variable-length values
+        std::string data;
+        int64 nulls = 0;
+        //! true if the type was set with setType() and values are converted by sqlite3
+        bool convert = false;
+        //! true if the type was taken from a value
+        bool inferred = false;
+    };
+
+    sqlite3_stmt* stmt;
+    size_t batch_rows;
+    Output out;
+    std::vector<Column> cols;
+    //! The number of rows in the current batch and in total
+    size_t batch_size = 0;
+    int64 rows = 0;
+    bool schema_written = false;
+
+    //! Sets the type of a column once it is known; the rows already in the batch are null
+    DLLLOCAL void setType(Column& c, QoreSqlite3ArrowType type);
+
+    //! Appends the current row to the column buffers; returns -1 if a value cannot be exported
+    DLLLOCAL int append(std::string& err);
+
+    //! Writes the schema message
+    DLLLOCAL int writeSchema();
+
+    //! Writes the current batch as a record batch message and clears the column buffers
+    DLLLOCAL int writeBatch();
+
+    //! Writes the metadata of an encapsulated message; the body follows it
+    DLLLOCAL int writeMessage(const std::string& meta);
+
+    //! Writes a body buffer padded to 8 bytes
+    DLLLOCAL int writeBuffer(const void* data, size_t len);
+};
+
+#endif
@@ -0,0 +1,294 @@
+/*
+    sqlite3async.cc
+
+    Qore Programming Language
+
+    Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "sqlite3async.h"
+#include "sqlite3module.h"
+
+#include <ctype.h>
+#include <strings.h>
+
+#include <chrono>
+#include <map>
+
+// how long the query connection waits for locks held by other connections
+#define QORE_SQLITE3_ASYNC_BUSY_TIMEOUT 5000
+
+// the registry of queries by handle
+typedef std::map<int64, QoreSqlite3AsyncQuery*> query_map_t;
+static query_map_t query_map;
+static std::mutex query_map_lock;
+static int64 query_seq = 0;
+
+static const char* state_names[] = {"running", "done", "error", "cancelled"};
+
+int64 QoreSqlite3AsyncQuery::start(const char* filename, const QoreString& sql, const QoreHashNode* opts,
+        ExceptionSink* xsink) {
+    QoreSqlite3AsyncQuery* q = new QoreSqlite3AsyncQuery;
+    if (q->setOptions(opts, xsink) || q->prepare(filename, sql, xsink)) {
+        delete q;
+        return -1;
+    }
+    q->thread = std::thread(&QoreSqlite3AsyncQuery::run, q);
+
+    std::lock_guard<std::mutex> l(query_map_lock);
+    q->id = ++query_seq;
+    query_map[q->id] = q;
+    return q->id;
+}
+
+QoreSqlite3AsyncQuery* QoreSqlite3AsyncQuery::find(int64 id, ExceptionSink* xsink) {
+    std::lock_guard<std::mutex> l(query_map_lock);
+    query_map_t::iterator i = query_map.find(id);
+    if (i == query_map.end()) {
+        xsink->raiseException("SQLITE3-ASYNC-ERROR", "query " QLLD " does not exist or has already been closed", id);
+        return nullptr;
+    }
+    ++i->second->refs;
+    return i->second;
+}
+
+int QoreSqlite3AsyncQuery::close(int64 id, ExceptionSink* xsink) {
+    QoreSqlite3AsyncQuery* q;
+    {
+        std::lock_guard<std::mutex> l(query_map_lock);
+        query_map_t::iterator i = query_map.find(id);
+        if (i == query_map.end()) {
+            xsink->raiseException("SQLITE3-ASYNC-ERROR", "query " QLLD " does not exist or has already been closed",
+                id);
+            return -1;
+        }
+        q = i->second;
+        query_map.erase(i);
+    }
+    // the query is cancelled immediately, even if other threads still hold references to it
+    q->cancel();
+    q->deref();
+    return 0;
+}
+
+void QoreSqlite3AsyncQuery::closeAll() {
+    query_map_t queries;
+    {
+        std::lock_guard<std::mutex> l(query_map_lock);
+        queries.swap(query_map);
+    }
+    for (auto& i : queries) {
+        i.second->cancel();
+        i.second->deref();
+    }
+}
+
+void QoreSqlite3AsyncQuery::deref() {
+    {
+        std::lock_guard<std::mutex> l(query_map_lock);
+        if (--refs) {
+            return;
+        }
+    }
+    delete this;
+}
+
+QoreSqlite3AsyncQuery::~QoreSqlite3AsyncQuery() {
+    if (thread.joinable()) {
+        cancel();
+        thread.join();
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+}
+
+int QoreSqlite3AsyncQuery::setOptions(const QoreHashNode* opts, ExceptionSink* xsink) {
+    if (!opts) {
+        return 0;
+    }
+
+    ConstHashIterator hi(opts);
+    while (hi.next()) {
+        const char* opt = hi.getKey();
+        const QoreValue v = hi.get();
+
+        if (!strcasecmp(opt, "args")) {
+            if (v.getType() != NT_LIST) {
+                xsink->raiseException("SQLITE3-ASYNC-ERROR", "option '%s' expects a list; got type '%s'", opt,
+                    v.getTypeName());
+                return -1;
+            }
+            args = v.get<const QoreListNode>();
+        } else if (!strcasecmp(opt, "batch") || !strcasecmp(opt, "queue")) {
+            int64 i = v.getAsBigInt();
+            if (i < 1) {
+                xsink->raiseException("SQLITE3-ASYNC-ERROR", "option '%s' must be positive; got " QLLD, opt, i);
+                return -1;
+            }
+            (tolower(*opt) == 'b' ? batch : queue) = i;
+        } else if (!strcasecmp(opt, "rows")) {
+            rows_format = v.getAsBool();
+        } else {
+            xsink->raiseException("SQLITE3-ASYNC-ERROR", "unknown option '%s'", opt);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int QoreSqlite3AsyncQuery::prepare(const char* filename, const QoreString& sql, ExceptionSink* xsink) {
+    // the query runs on its own read-only connection, so it cannot modify the database
+    int rc = sqlite3_open_v2(filename, &db, SQLITE_OPEN_READONLY
+        | (qore_sqlite3_open_flags & (SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_FULLMUTEX)), nullptr);
+    if (rc != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-ASYNC-ERROR", "cannot open %s: %s", filename,
+            db ? sqlite3_errmsg(db) : sqlite3_errstr(rc));
+        return -1;
+    }
+    sqlite3_busy_timeout(db, QORE_SQLITE3_ASYNC_BUSY_TIMEOUT);
+
+    TempEncodingHelper sql_utf8(sql, QCS_UTF8, xsink);
+    if (*xsink) {
+        return -1;
+    }
+    QoreString statement(sql_utf8->c_str(), sql_utf8->size(), QCS_UTF8);
+    if (binder.parseForBind(statement, args, xsink)) {
+        return -1;
+    }
+    if (qore_sqlite3_prepare(db, statement.c_str(), statement.size() + 1, SQLITE_PREPARE_PERSISTENT, &stmt)
+        != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-ASYNC-ERROR", "%s", sqlite3_errmsg(db));
+        return -1;
+    }
+    // statements that write, such as DML or pragmas with side effects, are rejected before they are run
+    if (!stmt || !sqlite3_stmt_readonly(stmt)) {
+        xsink->raiseException("SQLITE3-ASYNC-ERROR", "only read-only statements can be run asynchronously: %s",
+            sql_utf8->c_str());
+        return -1;
+    }
+    if (binder.bindParameters(stmt, xsink)) {
+        return -1;
+    }
+
+    ncols = sqlite3_column_count(stmt);
+    for (int i = 0; i < ncols; ++i) {
+        names.push_back(sqlite3_column_name(stmt, i));
+    }
+    return 0;
+}
+
+void QoreSqlite3AsyncQuery::run() {
+    std::unique_lock<std::mutex> l(m);
+    while (true) {
+        while (!stop && batches.size() >= (size_t)queue) {
+            worker_cond.wait(l);
+        }
+        if (stop) {
+            state = QUERY_CANCELLED;
+            break;
+        }
+        l.unlock();
+
+        QoreSqlite3RowBuffer b;
+        int rc = SQLITE_ROW;
+        while (b.rows < (size_t)batch && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            b.appendRow(stmt, ncols);
+        }
+
+        l.lock();
+        if (b.rows) {
+            rows += b.rows;
+            batches.push_back(std::move(b));
+        }
+        if (rc == SQLITE_DONE) {
+            state = QUERY_DONE;
+        } else if (rc != SQLITE_ROW) {
+            if (stop || rc == SQLITE_INTERRUPT) {
+                state = QUERY_CANCELLED;
+            } else {
+                state = QUERY_ERROR;
+                error = sqlite3_errmsg(db);
+            }
+        }
+        if (state != QUERY_RUNNING) {
+            break;
+        }
+        consumer_cond.notify_all();
+    }
+    sqlite3_reset(stmt);
+    consumer_cond.notify_all();
+}
+
+void QoreSqlite3AsyncQuery::cancel() {
+    {
+        std::lock_guard<std::mutex> l(m);
+        if (state != QUERY_RUNNING) {
+            return;
+        }
+        stop = true;
+    }
+    worker_cond.notify_one();
+    // interrupts a running sqlite3_step() call; the connection stays open until the worker thread has been joined
+    sqlite3_interrupt(db);
+}
+
+QoreHashNode* QoreSqlite3AsyncQuery::poll(ExceptionSink* xsink) {
+    ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+
+    std::lock_guard<std::mutex> l(m);
+    h->setKeyValue("state", new QoreStringNode(state_names[state]), xsink);
+    h->setKeyValue("rows", rows, xsink);
+    h->setKeyValue("batches", (int64)batches.size(), xsink);
+    if (state == QUERY_ERROR) {
+        h->setKeyValue("error", new QoreStringNode(error.c_str(), QCS_UTF8), xsink);
+    }
+    return h.release();
+}
+
+bool QoreSqlite3AsyncQuery::wait(int64 timeout_ms) {
+    std::unique_lock<std::mutex> l(m);
+    auto ready = [this] () { return !batches.empty() || state != QUERY_RUNNING; };
+    if (timeout_ms < 0) {
+        consumer_cond.wait(l, ready);
+        return true;
+    }
+    return consumer_cond.wait_for(l, std::chrono::milliseconds(timeout_ms), ready);
+}
+
+QoreValue QoreSqlite3AsyncQuery::fetch(ExceptionSink* xsink) {
+    QoreSqlite3RowBuffer b;
+    {
+        std::unique_lock<std::mutex> l(m);
+        consumer_cond.wait(l, [this] () { return !batches.empty() || state != QUERY_RUNNING; });
+        if (batches.empty()) {
+            // rows read before an error or cancellation are returned first
+            if (state == QUERY_ERROR) {
+                xsink->raiseException("SQLITE3-ASYNC-ERROR", "query " QLLD " failed: %s", id, error.c_str());
+            } else if (state == QUERY_CANCELLED) {
+                xsink->raiseException("SQLITE3-ASYNC-ERROR", "query " QLLD " was cancelled", id);
+            }
+            return QoreValue();
+        }
+        b = std::move(batches.front());
+        batches.pop_front();
+    }
+    worker_cond.notify_one();
+
+    ValueHolder rv(QoreSqlite3RowBuffer::newResult(names, rows_format), xsink);
+    b.appendTo(*rv, names, rows_format, xsink);
+    return rv.release();
+}
@@ -0,0 +1,153 @@
+/*
+  sqlite3async.h
+
+  Qore Programming Language
+
+  Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SQLITE3ASYNC_H
+#define SQLITE3ASYNC_H
+
+#include <sqlite3.h>
+#include <qore/Qore.h>
+
+#include "sqlite3parallel.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*! \brief A query run asynchronously by a worker thread with its own connection.
+
+    The statement is prepared and bound by the calling thread, so that errors in the SQL are raised immediately, and
+    then stepped by the worker thread, which only uses the sqlite3 API and buffers the rows in batches; batches are
+    converted to Qore values by the thread that fetches them.  The worker pauses when the maximum number of batches
+    is buffered, so memory use is bounded if the rows are not fetched as fast as they are read.
+
+    Queries are identified by integer handles, like snapshots; they are reference-counted and freed when they have
+    been closed and the last reference is released.  A running query is cancelled with sqlite3_interrupt().
+*/
+class QoreSqlite3AsyncQuery {
+public:
+    /*! \brief Starts a query and registers it.
+
+        \param filename the database file
+        \param sql the query
+        \param opts the options as documented for Sqlite3::async_select(); may be nullptr
+        \param xsink exception handler
+
+        \retval int64 the handle of the query; -1 on error
+    */
+    DLLLOCAL static int64 start(const char* filename, const QoreString& sql, const QoreHashNode* opts,
+        ExceptionSink* xsink);
+
+    /*! \brief Returns a referenced query for the given handle.
+
+        \retval QoreSqlite3AsyncQuery* a query with a new reference for the caller; nullptr on error
+    */
+    DLLLOCAL static QoreSqlite3AsyncQuery* find(int64 id, ExceptionSink* xsink);
+
+    //! Cancels the query if it is still running and unregisters it; returns -1 if the handle does not exist
+    DLLLOCAL static int close(int64 id, ExceptionSink* xsink);
+
+    //! Closes all queries; called when the module is unloaded
+    DLLLOCAL static void closeAll();
+
+    //! Releases a reference
+    DLLLOCAL void deref();
+
+    //! Returns a hash with the state of the query and the number of rows read and buffered
+    DLLLOCAL QoreHashNode* poll(ExceptionSink* xsink);
+
+    /*! \brief Waits until a batch of rows is available or the query has finished.
+
+        \param timeout_ms the maximum time to wait in milliseconds; negative to wait indefinitely
+
+        \retval bool true if a batch is available or the query has finished, false if the timeout expired
+    */
+    DLLLOCAL bool wait(int64 timeout_ms);
+
+    /*! \brief Returns the next batch of rows, waiting for it if necessary.
+
+        \retval QoreValue the rows as a hash of lists or a list of hashes; no value if all rows have been fetched;
+        an exception is raised if the query failed or was cancelled
+    */
+    DLLLOCAL QoreValue fetch(ExceptionSink* xsink);
+
+    //! Interrupts the query if it is still running
+    DLLLOCAL void cancel();
+
+private:
+    enum State {
+        QUERY_RUNNING,
+        QUERY_DONE,
+        QUERY_ERROR,
+        QUERY_CANCELLED,
+    };
+
+    //! The handle
+    int64 id = 0;
+    //! Reference count; protected by the registry lock
+    int refs = 1;
+
+    // options
+    const QoreListNode* args = nullptr;
+    int64 batch = 1000;
+    int64 queue = 4;
+    bool rows_format = false;
+
+    sqlite3* db = nullptr;
+    sqlite3_stmt* stmt = nullptr;
+    //! Converts the bind markers and keeps the bound values alive while the worker thread runs the statement
+    QoreSqlite3ExecBase binder;
+    int ncols = 0;
+    std::vector<std::string> names;
+    std::thread thread;
+
+    std::mutex m;
+    //! Signaled when a batch has been read or the query has finished
+    std::condition_variable consumer_cond;
+    //! Signaled when a batch has been fetched or the query is cancelled
+    std::condition_variable worker_cond;
+    std::deque<QoreSqlite3RowBuffer> batches;
+    State state = QUERY_RUNNING;
+    bool stop = false;
+    //! The number of rows read
+    int64 rows = 0;
+    std::string error;
+
+    DLLLOCAL QoreSqlite3AsyncQuery() : binder(QCS_UTF8, new QoreListNode(autoTypeInfo)) {
+    }
+
+    //! Stops and joins the worker thread and closes the connection
+    DLLLOCAL ~QoreSqlite3AsyncQuery();
+
+    //! Sets the query options
+    DLLLOCAL int setOptions(const QoreHashNode* opts, ExceptionSink* xsink);
+
+    //! Opens the connection and prepares and binds the statement
+    DLLLOCAL int prepare(const char* filename, const QoreString& sql, ExceptionSink* xsink);
+
+    //! Worker thread main loop
+    DLLLOCAL void run();
+};
+
+#endif
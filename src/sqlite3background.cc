@@ -0,0 +1,289 @@
+/*
+    sqlite3background.cc
+
+    Qore Programming Language
+
+    Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "sqlite3background.h"
+#include "sqlite3module.h"
+
+#include <sys/stat.h>
+
+#include <map>
+
+// how long a RESTART or TRUNCATE checkpoint waits for readers and writers on the dedicated connection
+#define QORE_SQLITE3_CHECKPOINT_BUSY_TIMEOUT 1000
+
+// SQLite's default automatic checkpoint threshold in WAL frames, restored when a connection is detached
+#define QORE_SQLITE3_DEFAULT_WAL_AUTOCHECKPOINT 1000
+
+// the registry of workers by database file name
+typedef std::map<std::string, QoreSqlite3BackgroundWorker*> worker_map_t;
+static worker_map_t worker_map;
+static std::mutex worker_map_lock;
+
+QoreSqlite3BackgroundWorker::QoreSqlite3BackgroundWorker(const char* filename, int flags)
+        : filename(filename), flags(flags), last_commit(clock::now()), last_checkpoint(clock::now()),
+          last_maintenance(clock::now()) {
+    thread = std::thread(&QoreSqlite3BackgroundWorker::run, this);
+}
+
+QoreSqlite3BackgroundWorker::~QoreSqlite3BackgroundWorker() {
+    {
+        std::lock_guard<std::mutex> l(m);
+        stop = true;
+    }
+    cond.notify_one();
+    thread.join();
+}
+
+QoreSqlite3BackgroundWorker* QoreSqlite3BackgroundWorker::get(sqlite3* db, ExceptionSink* xsink) {
+    const char* fn = sqlite3_db_filename(db, "main");
+    if (!fn || !*fn) {
+        xsink->raiseException("SQLITE3-BACKGROUND-ERROR", "background processing is only supported for database "
+            "files; it cannot be used with in-memory or temporary databases");
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> l(worker_map_lock);
+    worker_map_t::iterator i = worker_map.find(fn);
+    if (i != worker_map.end()) {
+        ++i->second->refs;
+        return i->second;
+    }
+
+    QoreSqlite3BackgroundWorker* w = new QoreSqlite3BackgroundWorker(fn, qore_sqlite3_open_flags);
+    worker_map[fn] = w;
+    return w;
+}
+
+QoreSqlite3BackgroundWorker* QoreSqlite3BackgroundWorker::find(sqlite3* db) {
+    const char* fn = sqlite3_db_filename(db, "main");
+    if (!fn || !*fn) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> l(worker_map_lock);
+    worker_map_t::iterator i = worker_map.find(fn);
+    if (i == worker_map.end()) {
+        return nullptr;
+    }
+    ++i->second->refs;
+    return i->second;
+}
+
+void QoreSqlite3BackgroundWorker::deref() {
+    {
+        std::lock_guard<std::mutex> l(worker_map_lock);
+        if (--refs) {
+            return;
+        }
+        worker_map.erase(filename);
+    }
+    delete this;
+}
+
+void QoreSqlite3BackgroundWorker::attach(sqlite3* db) {
+    // replaces SQLite's own auto-checkpoint WAL hook
+    sqlite3_wal_hook(db, walHook, this);
+}
+
+void QoreSqlite3BackgroundWorker::detach(sqlite3* db) {
+    sqlite3_wal_autocheckpoint(db, QORE_SQLITE3_DEFAULT_WAL_AUTOCHECKPOINT);
+}
+
+void QoreSqlite3BackgroundWorker::setCheckpointPolicy(const QoreSqlite3CheckpointPolicy& p) {
+    {
+        std::lock_guard<std::mutex> l(m);
+        policy = p;
+    }
+    cond.notify_one();
+}
+
+void QoreSqlite3BackgroundWorker::setMaintenancePolicy(const QoreSqlite3MaintenancePolicy& p) {
+    {
+        std::lock_guard<std::mutex> l(m);
+        maintenance_policy = p;
+    }
+    cond.notify_one();
+}
+
+int QoreSqlite3BackgroundWorker::walHook(void* arg, sqlite3* db, const char* schema, int frames) {
+    if (strcmp(schema, "main")) {
+        return SQLITE_OK;
+    }
+
+    QoreSqlite3BackgroundWorker* w = reinterpret_cast<QoreSqlite3BackgroundWorker*>(arg);
+    bool wake;
+    {
+        std::lock_guard<std::mutex> l(w->m);
+        // a smaller WAL means it was restarted after a complete checkpoint
+        w->lag_frames = frames < w->wal_frames ? frames : w->lag_frames + (frames - w->wal_frames);
+        w->wal_frames = frames;
+        w->last_commit = clock::now();
+        wake = w->policy.pages && w->lag_frames >= w->policy.pages;
+    }
+    if (wake) {
+        w->cond.notify_one();
+    }
+    return SQLITE_OK;
+}
+
+void QoreSqlite3BackgroundWorker::run() {
+    sqlite3* db = nullptr;
+    int rc = sqlite3_open_v2(filename.c_str(), &db, flags & ~SQLITE_OPEN_CREATE, nullptr);
+    if (rc != SQLITE_OK) {
+        std::lock_guard<std::mutex> l(m);
+        ++errors;
+        last_error = db ? sqlite3_errmsg(db) : sqlite3_errstr(rc);
+        sqlite3_close(db);
+        return;
+    }
+    ON_BLOCK_EXIT(sqlite3_close, db);
+    sqlite3_busy_timeout(db, QORE_SQLITE3_CHECKPOINT_BUSY_TIMEOUT);
+    // this connection must never checkpoint on its own; maintenance commits are tracked like any others
+    attach(db);
+
+    std::unique_lock<std::mutex> l(m);
+    while (!stop) {
+        clock::time_point now = clock::now();
+        clock::time_point wakeup = clock::time_point::max();
+        bool run_checkpoint = false;
+
+        if (lag_frames > 0) {
+            // size and idle triggers only fire for commits made after the last checkpoint, so that a checkpoint
+            // that cannot make progress because of open readers is not retried in a loop
+            bool committed = last_commit > last_checkpoint;
+            if (committed && policy.pages && lag_frames >= policy.pages) {
+                run_checkpoint = true;
+            }
+            if (!run_checkpoint && policy.interval_ms) {
+                clock::time_point t = last_checkpoint + std::chrono::milliseconds(policy.interval_ms);
+                if (t <= now) {
+                    run_checkpoint = true;
+                } else if (t < wakeup) {
+                    wakeup = t;
+                }
+            }
+            if (!run_checkpoint && committed && policy.idle_ms) {
+                clock::time_point t = last_commit + std::chrono::milliseconds(policy.idle_ms);
+                if (t <= now) {
+                    run_checkpoint = true;
+                } else if (t < wakeup) {
+                    wakeup = t;
+                }
+            }
+        }
+
+        if (run_checkpoint) {
+            int mode = policy.mode;
+            l.unlock();
+            checkpoint(db, mode);
+            l.lock();
+            continue;
+        }
+
+        if (maintenance_policy.interval_ms) {
+            clock::time_point t = last_maintenance + std::chrono::milliseconds(maintenance_policy.interval_ms);
+            if (t <= now) {
+                QoreSqlite3MaintenancePolicy p = maintenance_policy;
+                QoreSqlite3MaintenanceResult r = maintenance_result;
+                l.unlock();
+                QoreSqlite3Maintenance::run(db, p, p.budget_ms, r);
+                l.lock();
+                maintenance_result = r;
+                last_maintenance = clock::now();
+                continue;
+            }
+            if (t < wakeup) {
+                wakeup = t;
+            }
+        }
+
+        if (wakeup == clock::time_point::max()) {
+            cond.wait(l);
+        } else {
+            cond.wait_until(l, wakeup);
+        }
+    }
+}
+
+void QoreSqlite3BackgroundWorker::checkpoint(sqlite3* db, int mode) {
+    int log = -1, ckpt = -1;
+    clock::time_point start = clock::now();
+    int rc = sqlite3_wal_checkpoint_v2(db, nullptr, mode, &log, &ckpt);
+    clock::time_point end = clock::now();
+
+    std::lock_guard<std::mutex> l(m);
+    last_checkpoint = end;
+    last_duration_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    total_duration_us += last_duration_us;
+    if (rc == SQLITE_BUSY) {
+        // the checkpoint could not complete because of readers or writers; the frames it copied are still counted
+        ++busy;
+    } else if (rc != SQLITE_OK) {
+        ++errors;
+        last_error = sqlite3_errmsg(db);
+        return;
+    } else {
+        ++checkpoints;
+    }
+    // log and ckpt are -1 if the database is not in WAL mode
+    if (log >= 0) {
+        wal_frames = log;
+        lag_frames = log - ckpt;
+    }
+}
+
+QoreHashNode* QoreSqlite3BackgroundWorker::getWalStats(ExceptionSink* xsink) {
+    int64 wal_size = 0;
+    struct stat sbuf;
+    if (!stat((filename + "-wal").c_str(), &sbuf)) {
+        wal_size = sbuf.st_size;
+    }
+
+    ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+
+    std::lock_guard<std::mutex> l(m);
+    clock::time_point now = clock::now();
+    h->setKeyValue("wal_size", wal_size, xsink);
+    h->setKeyValue("wal_frames", wal_frames, xsink);
+    h->setKeyValue("lag_frames", lag_frames, xsink);
+    h->setKeyValue("lag_ms", lag_frames
+        ? (int64)std::chrono::duration_cast<std::chrono::milliseconds>(now - last_checkpoint).count()
+        : 0, xsink);
+    h->setKeyValue("checkpoints", checkpoints, xsink);
+    h->setKeyValue("busy", busy, xsink);
+    h->setKeyValue("errors", errors, xsink);
+    h->setKeyValue("last_duration_us", last_duration_us, xsink);
+    h->setKeyValue("total_duration_us", total_duration_us, xsink);
+    if (!last_error.empty()) {
+        h->setKeyValue("last_error", new QoreStringNode(last_error.c_str()), xsink);
+    }
+
+    return h.release();
+}
+
+QoreHashNode* QoreSqlite3BackgroundWorker::getMaintenanceStats(ExceptionSink* xsink) {
+    std::lock_guard<std::mutex> l(m);
+    if (!maintenance_policy.interval_ms) {
+        return nullptr;
+    }
+    return maintenance_result.getHash(xsink);
+}
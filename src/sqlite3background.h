@@ -0,0 +1,150 @@
+/*
+  sqlite3background.h
+
+  Qore Programming Language
+
+  Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SQLITE3BACKGROUND_H
+#define SQLITE3BACKGROUND_H
+
+#include <sqlite3.h>
+#include <qore/Qore.h>
+
+#include "sqlite3maintenance.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+//! WAL checkpoint policy for a database file
+struct QoreSqlite3CheckpointPolicy {
+    //! the checkpoint mode: SQLITE_CHECKPOINT_PASSIVE, SQLITE_CHECKPOINT_RESTART or SQLITE_CHECKPOINT_TRUNCATE
+    int mode = SQLITE_CHECKPOINT_PASSIVE;
+    //! checkpoint as soon as the WAL has at least this many frames (0 = no size trigger)
+    int64 pages = 1000;
+    //! checkpoint at least this often if the WAL is not empty (0 = no time trigger)
+    int64 interval_ms = 10000;
+    //! checkpoint when no transaction has been committed for this long (0 = no idle trigger)
+    int64 idle_ms = 1000;
+};
+
+/*! \brief Background worker for a single database file.
+
+    There is one instance per database file shared by all connections to it; it owns a dedicated connection and
+    thread that run WAL checkpoints according to a QoreSqlite3CheckpointPolicy, so that checkpoints are not run
+    inline by whichever application connection happens to commit, and periodic time-boxed maintenance according to
+    a QoreSqlite3MaintenancePolicy.
+
+    Instances are reference-counted and acquired with get(); the thread is stopped when the last reference is
+    released.
+*/
+class QoreSqlite3BackgroundWorker {
+public:
+    /*! \brief Returns the worker for the database file used by the given connection.
+
+        \param db an open application connection; must refer to a file database
+        \param xsink exception handler
+
+        \retval QoreSqlite3BackgroundWorker* a referenced worker; the caller must call deref(); nullptr on error
+    */
+    DLLLOCAL static QoreSqlite3BackgroundWorker* get(sqlite3* db, ExceptionSink* xsink);
+
+    //! Returns a referenced worker for the database file used by the given connection, if one exists
+    DLLLOCAL static QoreSqlite3BackgroundWorker* find(sqlite3* db);
+
+    //! Releases a reference acquired with get()
+    DLLLOCAL void deref();
+
+    /*! \brief Hands WAL checkpointing for an application connection over to this worker.
+        The connection's automatic checkpoints are disabled by installing a WAL hook that reports commits here.
+    */
+    DLLLOCAL void attach(sqlite3* db);
+
+    //! Removes the WAL hook installed by attach() and restores SQLite's automatic checkpointing
+    DLLLOCAL void detach(sqlite3* db);
+
+    /*! \brief Sets the checkpoint policy; the new policy takes effect immediately
+
+        The policy is per file: it replaces the policy set by any other connection to the same file.
+    */
+    DLLLOCAL void setCheckpointPolicy(const QoreSqlite3CheckpointPolicy& p);
+
+    //! Sets the maintenance policy; as with the checkpoint policy, the last one set applies to the file
+    DLLLOCAL void setMaintenancePolicy(const QoreSqlite3MaintenancePolicy& p);
+
+    //! Returns WAL size and checkpoint statistics
+    DLLLOCAL QoreHashNode* getWalStats(ExceptionSink* xsink);
+
+    //! Returns the results of background maintenance runs, or nullptr if background maintenance is not enabled
+    DLLLOCAL QoreHashNode* getMaintenanceStats(ExceptionSink* xsink);
+
+private:
+    //! The database file name
+    std::string filename;
+    //! Connection flags used for the dedicated connection
+    int flags;
+    //! Reference count; protected by the registry lock
+    int refs = 1;
+
+    std::mutex m;
+    std::condition_variable cond;
+    std::thread thread;
+    bool stop = false;
+
+    QoreSqlite3CheckpointPolicy policy;
+    QoreSqlite3MaintenancePolicy maintenance_policy;
+    QoreSqlite3MaintenanceResult maintenance_result;
+
+    typedef std::chrono::steady_clock clock;
+
+    //! Frames in the WAL as last reported by a commit or checkpoint
+    int wal_frames = 0;
+    //! Frames in the WAL that have not been checkpointed yet
+    int lag_frames = 0;
+    //! Time of the last commit reported by the WAL hook
+    clock::time_point last_commit;
+    //! Time of the last checkpoint
+    clock::time_point last_checkpoint;
+    //! Time of the last maintenance run
+    clock::time_point last_maintenance;
+
+    // statistics
+    int64 checkpoints = 0;
+    int64 busy = 0;
+    int64 errors = 0;
+    int64 last_duration_us = 0;
+    int64 total_duration_us = 0;
+    std::string last_error;
+
+    DLLLOCAL QoreSqlite3BackgroundWorker(const char* filename, int flags);
+    DLLLOCAL ~QoreSqlite3BackgroundWorker();
+
+    //! The WAL hook installed on application connections
+    DLLLOCAL static int walHook(void* arg, sqlite3* db, const char* schema, int frames);
+
+    //! Thread main loop
+    DLLLOCAL void run();
+
+    //! Runs a checkpoint on the dedicated connection; called without the lock held
+    DLLLOCAL void checkpoint(sqlite3* db, int mode);
+};
+
+#endif
@@ -0,0 +1,483 @@
+/*
+    sqlite3cache.cc
+
+    Qore Programming Language
+
+    Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "sqlite3cache.h"
+#include "sqlite3module.h"
+
+#include <string.h>
+#include <strings.h>
+
+// the estimated size of an entry in the cache besides its key and result
+#define QORE_SQLITE3_CACHE_ENTRY_SIZE 128
+
+// built-in functions whose results can differ between calls with the same arguments on the same data
+static const char* volatile_functions[] = {
+    "changes", "current_date", "current_time", "current_timestamp", "date", "datetime", "julianday",
+    "last_insert_rowid", "random", "randomblob", "strftime", "time", "timediff", "total_changes", "unixepoch",
+    "qore_snapshot", "qore_changeset", "qore_patchset",
+};
+
+static bool is_volatile_function(const char* name) {
+    for (const char* f : volatile_functions) {
+        if (!strcasecmp(name, f)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// appends a length-prefixed byte string to a key, so that values cannot run into each other
+static void append_bytes(std::string& key, const char* data, size_t len) {
+    key += std::to_string(len);
+    key += ':';
+    key.append(data, len);
+}
+
+static int append_value(std::string& key, const QoreValue v) {
+    switch (v.getType()) {
+        case NT_NOTHING:
+            key += 'N';
+            return 0;
+        case NT_NULL:
+            key += 'L';
+            return 0;
+        case NT_INT:
+            key += 'i';
+            key += std::to_string(v.getAsBigInt());
+            key += ';';
+            return 0;
+        case NT_FLOAT: {
+            double f = v.getAsFloat();
+            key += 'f';
+            key.append((const char*)&f, sizeof f);
+            return 0;
+        }
+        case NT_BOOLEAN:
+            key += v.getAsBool() ? 'T' : 'F';
+            return 0;
+        case NT_STRING: {
+            const QoreStringNode* str = v.get<const QoreStringNode>();
+            key += 's';
+            key += str->getEncoding()->getCode();
+            key += ':';
+            append_bytes(key, str->c_str(), str->size());
+            return 0;
+        }
+        case NT_DATE: {
+            // dates are bound in this format
+            QoreString str;
+            v.get<const DateTimeNode>()->format(str, "IF");
+            key += 'd';
+            append_bytes(key, str.c_str(), str.size());
+            return 0;
+        }
+        case NT_NUMBER: {
+            QoreString str;
+            v.get<const QoreNumberNode>()->toString(str);
+            key += 'n';
+            append_bytes(key, str.c_str(), str.size());
+            return 0;
+        }
+        case NT_BINARY: {
+            const BinaryNode* b = v.get<const BinaryNode>();
+            key += 'b';
+            append_bytes(key, (const char*)b->getPtr(), b->size());
+            return 0;
+        }
+        case NT_LIST: {
+            // bound as JSON text
+            const QoreListNode* l = v.get<const QoreListNode>();
+            key += 'l';
+            key += std::to_string(l->size());
+            key += ':';
+            ConstListIterator li(l);
+            while (li.next()) {
+                if (append_value(key, li.getValue())) {
+                    return -1;
+                }
+            }
+            return 0;
+        }
+        case NT_HASH: {
+            // arguments for named parameters with native binding, or a value bound as JSON text
+            const QoreHashNode* h = v.get<const QoreHashNode>();
+            key += 'h';
+            key += std::to_string(h->size());
+            key += ':';
+            ConstHashIterator hi(h);
+            while (hi.next()) {
+                const char* k = hi.getKey();
+                append_bytes(key, k, strlen(k));
+                if (append_value(key, hi.get())) {
+                    return -1;
+                }
+            }
+            return 0;
+        }
+        default:
+            break;
+    }
+    return -1;
+}
+
+// returns the estimated memory used by a result value
+static size_t estimate_size(const QoreValue v) {
+    switch (v.getType()) {
+        case NT_STRING:
+            return sizeof(QoreStringNode) + v.get<const QoreStringNode>()->size();
+        case NT_BINARY:
+            return sizeof(BinaryNode) + v.get<const BinaryNode>()->size();
+        case NT_NUMBER:
+        case NT_DATE:
+            return 64;
+        case NT_LIST: {
+            size_t rv = sizeof(QoreListNode);
+            ConstListIterator li(v.get<const QoreListNode>());
+            while (li.next()) {
+                rv += sizeof(QoreValue) + estimate_size(li.getValue());
+            }
+            return rv;
+        }
+        case NT_HASH: {
+            size_t rv = sizeof(QoreHashNode);
+            ConstHashIterator hi(v.get<const QoreHashNode>());
+            while (hi.next()) {
+                rv += 64 + strlen(hi.getKey()) + estimate_size(hi.get());
+            }
+            return rv;
+        }
+        default:
+            break;
+    }
+    return 0;
+}
+
+QoreSqlite3ResultCache::QoreSqlite3ResultCache(sqlite3* db, int64 max_size) : db(db), max_size(max_size),
+        total_changes(sqlite3_total_changes(db)) {
+    // the authorizer is installed once, as installing it expires all prepared statements on the connection
+    sqlite3_set_authorizer(db, authorize, this);
+}
+
+QoreSqlite3ResultCache::~QoreSqlite3ResultCache() {
+    assert(entries.empty());
+    sqlite3_set_authorizer(db, nullptr, nullptr);
+    for (auto& i : schemas) {
+        sqlite3_finalize(i.second.data_stmt);
+        sqlite3_finalize(i.second.schema_stmt);
+    }
+}
+
+void QoreSqlite3ResultCache::setMaxSize(int64 new_size, ExceptionSink* xsink) {
+    max_size = new_size;
+    while (size > (size_t)max_size) {
+        erase(--entries.end(), xsink);
+    }
+}
+
+int QoreSqlite3ResultCache::makeKey(std::string& key, char method, const QoreString* sql, const QoreListNode* args,
+        bool native) {
+    key = method;
+    key += native ? 'n' : 'p';
+    append_bytes(key, sql->c_str(), sql->size());
+    if (args) {
+        ConstListIterator li(args);
+        while (li.next()) {
+            if (append_value(key, li.getValue())) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+bool QoreSqlite3ResultCache::get(const std::string& key, QoreValue& rv, ExceptionSink* xsink) {
+    validate(xsink);
+
+    std::unordered_map<std::string, entry_list_t::iterator>::iterator i = index.find(key);
+    if (i == index.end()) {
+        ++misses;
+        return false;
+    }
+    ++hits;
+    entries.splice(entries.begin(), entries, i->second);
+    rv = i->second->value.refSelf();
+    return true;
+}
+
+void QoreSqlite3ResultCache::beginCapture() {
+    capturing = true;
+    uncacheable = false;
+    captured.clear();
+}
+
+void QoreSqlite3ResultCache::endCapture(const std::string& key, const QoreValue rv, ExceptionSink* xsink) {
+    capturing = false;
+    // results read with uncommitted changes are not cached, as the changes could still be rolled back
+    if (uncacheable || dirty || !max_size) {
+        return;
+    }
+
+    // tables read without a schema name in the authorizer can be in any database on the connection
+    std::set<std::string> names;
+    for (const table_t& t : captured) {
+        if (!t.first.empty()) {
+            names.insert(t.first);
+            continue;
+        }
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, "pragma database_list", -1, &stmt, nullptr) != SQLITE_OK) {
+            return;
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            names.insert((const char*)sqlite3_column_text(stmt, 1));
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    // the versions of a schema that has not been read before are only known from now on, so results that were
+    // read from it before they were known are not cached
+    bool new_schema = false;
+    for (const std::string& name : names) {
+        if (schemas.find(name) == schemas.end()) {
+            if (addSchema(name)) {
+                return;
+            }
+            new_schema = true;
+        }
+    }
+    if (new_schema) {
+        return;
+    }
+
+    size_t entry_size = QORE_SQLITE3_CACHE_ENTRY_SIZE + key.size() + estimate_size(rv);
+    if (entry_size > (size_t)max_size) {
+        return;
+    }
+    while (size + entry_size > (size_t)max_size) {
+        erase(--entries.end(), xsink);
+    }
+
+    entries.push_front(Entry{key, rv.refSelf(), entry_size, std::vector<table_t>(captured.begin(), captured.end())});
+    index[key] = entries.begin();
+    for (const auto& t : captured) {
+        table_keys[t].insert(key);
+    }
+    size += entry_size;
+}
+
+void QoreSqlite3ResultCache::clear(ExceptionSink* xsink) {
+    for (Entry& e : entries) {
+        e.value.discard(xsink);
+    }
+    entries.clear();
+    index.clear();
+    table_keys.clear();
+    size = 0;
+}
+
+QoreHashNode* QoreSqlite3ResultCache::getStats(ExceptionSink* xsink) const {
+    ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+    h->setKeyValue("entries", (int64)entries.size(), xsink);
+    h->setKeyValue("size", (int64)size, xsink);
+    h->setKeyValue("max_size", max_size, xsink);
+    h->setKeyValue("hits", hits, xsink);
+    h->setKeyValue("misses", misses, xsink);
+    h->setKeyValue("invalidations", invalidations, xsink);
+    return h.release();
+}
+
+void QoreSqlite3ResultCache::rowChanged(const char* dbname, const char* table) {
+    ++hook_changes;
+    dirty = true;
+    if (table_keys.empty()) {
+        return;
+    }
+    ExceptionSink xsink;
+    invalidateTable(std::make_pair(std::string(dbname), std::string(table)), &xsink);
+    invalidateTable(std::make_pair(std::string(), std::string(table)), &xsink);
+}
+
+void QoreSqlite3ResultCache::validate(ExceptionSink* xsink) {
+    // the update hook is not called for WITHOUT ROWID tables and deletes with the truncate optimization, so the
+    // cache is cleared if the connection made changes that were not reported to it
+    int64 tc = sqlite3_total_changes(db);
+    if (tc - total_changes != hook_changes) {
+        if (!entries.empty()) {
+            ++invalidations;
+            clear(xsink);
+        }
+        if (!sqlite3_get_autocommit(db)) {
+            dirty = true;
+        }
+    }
+    total_changes = tc;
+    hook_changes = 0;
+
+    std::map<std::string, SchemaVersion>::iterator i = schemas.begin();
+    while (i != schemas.end()) {
+        int64 data_version, schema_version;
+        if (getVersions(i->second, data_version, schema_version)) {
+            // the database has been detached
+            invalidateSchema(i->first, xsink);
+            sqlite3_finalize(i->second.data_stmt);
+            sqlite3_finalize(i->second.schema_stmt);
+            schemas.erase(i++);
+            continue;
+        }
+        if (schema_version != i->second.schema_version) {
+            // tables may have been dropped and created again
+            if (!entries.empty()) {
+                ++invalidations;
+                clear(xsink);
+            }
+        } else if (data_version != i->second.data_version) {
+            // another connection has committed changes to the database
+            invalidateSchema(i->first, xsink);
+        }
+        i->second.data_version = data_version;
+        i->second.schema_version = schema_version;
+        ++i;
+    }
+}
+
+int QoreSqlite3ResultCache::addSchema(const std::string& name) {
+    SchemaVersion sv;
+    std::string sql = "pragma " + qore_sqlite3_quote_identifier(name) + ".data_version";
+    if (qore_sqlite3_prepare(db, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &sv.data_stmt) == SQLITE_OK) {
+        sql = "pragma " + qore_sqlite3_quote_identifier(name) + ".schema_version";
+        if (qore_sqlite3_prepare(db, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &sv.schema_stmt) == SQLITE_OK
+            && !getVersions(sv, sv.data_version, sv.schema_version)) {
+            schemas[name] = sv;
+            return 0;
+        }
+    }
+    sqlite3_finalize(sv.data_stmt);
+    sqlite3_finalize(sv.schema_stmt);
+    return -1;
+}
+
+int QoreSqlite3ResultCache::getVersions(SchemaVersion& sv, int64& data_version, int64& schema_version) {
+    int rc = sqlite3_step(sv.data_stmt);
+    data_version = sqlite3_column_int64(sv.data_stmt, 0);
+    sqlite3_reset(sv.data_stmt);
+    if (rc != SQLITE_ROW) {
+        return -1;
+    }
+    rc = sqlite3_step(sv.schema_stmt);
+    schema_version = sqlite3_column_int64(sv.schema_stmt, 0);
+    sqlite3_reset(sv.schema_stmt);
+    return rc == SQLITE_ROW ? 0 : -1;
+}
+
+void QoreSqlite3ResultCache::invalidateTable(const table_t& table, ExceptionSink* xsink) {
+    std::map<table_t, std::set<std::string>>::iterator i = table_keys.find(table);
+    if (i == table_keys.end()) {
+        return;
+    }
+    // erasing the entries removes their keys from the set
+    std::set<std::string> keys = i->second;
+    for (const std::string& key : keys) {
+        erase(index[key], xsink);
+        ++invalidations;
+    }
+}
+
+void QoreSqlite3ResultCache::invalidateSchema(const std::string& schema, ExceptionSink* xsink) {
+    // tables read without a schema name can be in any schema
+    std::vector<table_t> tables;
+    for (const std::string& name : {std::string(), schema}) {
+        std::map<table_t, std::set<std::string>>::iterator i = table_keys.lower_bound(std::make_pair(name,
+            std::string()));
+        for (; i != table_keys.end() && i->first.first == name; ++i) {
+            tables.push_back(i->first);
+        }
+    }
+    for (const table_t& t : tables) {
+        invalidateTable(t, xsink);
+    }
+}
+
+void QoreSqlite3ResultCache::erase(entry_list_t::iterator i, ExceptionSink* xsink) {
+    size -= i->size;
+    for (const table_t& t : i->tables) {
+        std::map<table_t, std::set<std::string>>::iterator ti = table_keys.find(t);
+        ti->second.erase(i->key);
+        if (ti->second.empty()) {
+            table_keys.erase(ti);
+        }
+    }
+    index.erase(i->key);
+    i->value.discard(xsink);
+    entries.erase(i);
+}
+
+int QoreSqlite3ResultCache::authorize(void* arg, int action, const char* arg1, const char* arg2,
+        const char* dbname, const char* trigger) {
+    QoreSqlite3ResultCache* cache = reinterpret_cast<QoreSqlite3ResultCache*>(arg);
+    if (!cache->capturing) {
+        return SQLITE_OK;
+    }
+    switch (action) {
+        case SQLITE_SELECT:
+        case SQLITE_RECURSIVE:
+            break;
+        case SQLITE_READ:
+            // the schema name is not given for some optimized reads, such as count(*)
+            cache->captured.insert(std::make_pair(std::string(dbname ? dbname : ""), std::string(arg1)));
+            break;
+        case SQLITE_FUNCTION:
+            if (is_volatile_function(arg2)) {
+                cache->uncacheable = true;
+            }
+            break;
+        default:
+            // statements that write, run pragmas or manage transactions are never cached
+            cache->uncacheable = true;
+            break;
+    }
+    return SQLITE_OK;
+}
+
+QoreSqlite3CachedQuery::QoreSqlite3CachedQuery(QoreSqlite3ResultCache* cache, char method, const QoreString* sql,
+        const QoreListNode* args, bool native, ExceptionSink* xsink) {
+    if (!cache || QoreSqlite3ResultCache::makeKey(key, method, sql, args, native)) {
+        return;
+    }
+    if (cache->get(key, rv, xsink)) {
+        is_hit = true;
+        return;
+    }
+    this->cache = cache;
+    cache->beginCapture();
+}
+
+QoreValue QoreSqlite3CachedQuery::store(QoreValue val, ExceptionSink* xsink) {
+    if (cache) {
+        if (*xsink) {
+            cache->cancelCapture();
+        } else {
+            cache->endCapture(key, val, xsink);
+        }
+        cache = nullptr;
+    }
+    return val;
+}
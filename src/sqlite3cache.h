@@ -0,0 +1,245 @@
+/*
+  sqlite3cache.h
+
+  Qore Programming Language
+
+  Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SQLITE3CACHE_H
+#define SQLITE3CACHE_H
+
+#include <sqlite3.h>
+#include <qore/Qore.h>
+
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*! \brief A cache of read query results on a connection.
+
+    Results are keyed by the query method, the SQL text and the bound arguments, and are returned as new references
+    to the cached values, which are never modified.  The tables read by a query are captured with an authorizer when
+    it is prepared; queries that write, run pragmas or call functions whose results can change between calls are
+    not cached.
+
+    Entries are invalidated:
+    - per table by the update hook on the connection, for changes made on the connection
+    - per schema when <tt>PRAGMA data_version</tt> changes, for changes committed by other connections and processes
+    - completely when the schema version changes or the number of changes on the connection does not match the
+      number of rows reported to the update hook, for changes that the update hook does not report
+
+    No results are cached while the connection has uncommitted changes, so that a rollback does not leave results
+    of the discarded changes in the cache.  The least recently used entries are dropped when the total estimated
+    size of the cached results would exceed the maximum size.
+
+    A cache is only used by the thread that holds its connection, so it needs no locking.
+*/
+class QoreSqlite3ResultCache {
+public:
+    //! Creates the cache and installs its authorizer on the connection
+    DLLLOCAL QoreSqlite3ResultCache(sqlite3* db, int64 max_size);
+
+    //! Removes the authorizer and finalizes the version statements; the entries must have been cleared
+    DLLLOCAL ~QoreSqlite3ResultCache();
+
+    //! Sets the maximum total size of the cached results in bytes, dropping entries if necessary
+    DLLLOCAL void setMaxSize(int64 size, ExceptionSink* xsink);
+
+    //! Returns the maximum total size of the cached results in bytes
+    DLLLOCAL int64 getMaxSize() const {
+        return max_size;
+    }
+
+    /*! \brief Builds the key for a query.
+
+        \param key the key is returned here
+        \param method a character identifying the query method, as the results of each method differ
+        \param sql the SQL text
+        \param args the arguments; may be nullptr
+        \param native true if native binding is used, as the SQL is then interpreted differently
+
+        \retval int 0 on success, -1 if the arguments have types that cannot be part of a key
+    */
+    DLLLOCAL static int makeKey(std::string& key, char method, const QoreString* sql, const QoreListNode* args,
+        bool native);
+
+    /*! \brief Looks up the result of a query after invalidating entries that are no longer valid.
+
+        \param key the key of the query
+        \param rv the result is returned here as a new reference on a hit
+
+        \retval bool true on a hit
+    */
+    DLLLOCAL bool get(const std::string& key, QoreValue& rv, ExceptionSink* xsink);
+
+    //! Starts capturing the tables read by statements prepared on the connection
+    DLLLOCAL void beginCapture();
+
+    //! Stops capturing and caches the result if the statements prepared since beginCapture() can be cached
+    DLLLOCAL void endCapture(const std::string& key, const QoreValue rv, ExceptionSink* xsink);
+
+    //! Stops capturing without caching a result
+    DLLLOCAL void cancelCapture() {
+        capturing = false;
+    }
+
+    //! Removes all entries
+    DLLLOCAL void clear(ExceptionSink* xsink);
+
+    //! Returns a hash with the size of the cache and hit and miss counters
+    DLLLOCAL QoreHashNode* getStats(ExceptionSink* xsink) const;
+
+    //! Called from the update hook when a row of a table is changed on the connection
+    DLLLOCAL void rowChanged(const char* dbname, const char* table);
+
+    //! Called from the commit and rollback hooks when a transaction ends
+    DLLLOCAL void transactionEnded() {
+        dirty = false;
+    }
+
+private:
+    //! A table as a schema name, which is empty if it is not known, and a table name
+    typedef std::pair<std::string, std::string> table_t;
+
+    struct Entry {
+        std::string key;
+        QoreValue value;
+        size_t size;
+        //! The tables read by the query
+        std::vector<table_t> tables;
+    };
+
+    typedef std::list<Entry> entry_list_t;
+
+    //! The data and schema versions of a database on the connection that cached results depend on
+    struct SchemaVersion {
+        sqlite3_stmt* data_stmt = nullptr;
+        sqlite3_stmt* schema_stmt = nullptr;
+        int64 data_version = -1;
+        int64 schema_version = -1;
+    };
+
+    sqlite3* db;
+    int64 max_size;
+    size_t size = 0;
+
+    //! Entries in order of use, most recently used first
+    entry_list_t entries;
+    std::unordered_map<std::string, entry_list_t::iterator> index;
+    //! The keys of the entries that read each table
+    std::map<table_t, std::set<std::string>> table_keys;
+    //! The versions of each schema read by cached queries
+    std::map<std::string, SchemaVersion> schemas;
+
+    //! The number of changes on the connection when the cache was last validated
+    int64 total_changes;
+    //! The number of rows reported to the update hook since the cache was last validated
+    int64 hook_changes = 0;
+    //! True if the connection may have uncommitted changes
+    bool dirty = false;
+
+    //! True while the tables read by prepared statements are being captured
+    bool capturing = false;
+    //! True if a statement prepared while capturing cannot be cached
+    bool uncacheable = false;
+    //! The tables read by the statements prepared while capturing
+    std::set<table_t> captured;
+
+    // statistics
+    int64 hits = 0;
+    int64 misses = 0;
+    int64 invalidations = 0;
+
+    //! Removes entries that have been invalidated by changes not reported to the update hook
+    DLLLOCAL void validate(ExceptionSink* xsink);
+
+    //! Starts tracking the versions of a schema; returns -1 on error
+    DLLLOCAL int addSchema(const std::string& name);
+
+    //! Returns the current data and schema version of a schema; -1 on error
+    DLLLOCAL int getVersions(SchemaVersion& sv, int64& data_version, int64& schema_version);
+
+    //! Removes the entries that read the given table
+    DLLLOCAL void invalidateTable(const table_t& table, ExceptionSink* xsink);
+
+    //! Removes the entries that read any table in the given schema
+    DLLLOCAL void invalidateSchema(const std::string& schema, ExceptionSink* xsink);
+
+    //! Removes an entry
+    DLLLOCAL void erase(entry_list_t::iterator i, ExceptionSink* xsink);
+
+    //! The authorizer, which records the tables read by a statement and whether it can be cached
+    DLLLOCAL static int authorize(void* arg, int action, const char* arg1, const char* arg2, const char* dbname,
+        const char* trigger);
+};
+
+/*! \brief Looks up and caches the result of a single query.
+
+    If the query can be cached and its result is not in the cache, the tables it reads are captured until the
+    result is passed to store().
+*/
+class QoreSqlite3CachedQuery {
+public:
+    /*! \brief Looks up the result of a query.
+
+        \param cache the result cache; nullptr if results are not cached
+        \param method a character identifying the query method
+        \param sql the SQL text
+        \param args the arguments; may be nullptr
+        \param native true if native binding is used
+        \param xsink exception handler
+    */
+    DLLLOCAL QoreSqlite3CachedQuery(QoreSqlite3ResultCache* cache, char method, const QoreString* sql,
+        const QoreListNode* args, bool native, ExceptionSink* xsink);
+
+    //! Stops capturing if the result has not been stored
+    DLLLOCAL ~QoreSqlite3CachedQuery() {
+        if (cache) {
+            cache->cancelCapture();
+        }
+    }
+
+    //! Returns true if the result was found in the cache
+    DLLLOCAL bool hit() const {
+        return is_hit;
+    }
+
+    //! Returns true if the tables read by the query are being captured, which requires it to be prepared again
+    DLLLOCAL bool capturing() const {
+        return (bool)cache;
+    }
+
+    //! Returns the cached result after a hit
+    DLLLOCAL QoreValue getResult() {
+        return rv;
+    }
+
+    //! Caches the result of the query unless an error occurred and returns it
+    DLLLOCAL QoreValue store(QoreValue val, ExceptionSink* xsink);
+
+private:
+    QoreSqlite3ResultCache* cache = nullptr;
+    std::string key;
+    bool is_hit = false;
+    QoreValue rv;
+};
+
+#endif
@@ -0,0 +1,149 @@
+/*
+    sqlite3compress.cc
+
+    Qore Programming Language
+
+    Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "sqlite3compress.h"
+
+#include <stdlib.h>
+
+#include <zlib.h>
+
+// compresses a value into a new buffer with the header; returns nullptr unless the compressed value is smaller than
+// the original
+static char* compress_value(const void* data, size_t len, bool text, size_t& out_len) {
+    if (len > 0xffffffff) {
+        return nullptr;
+    }
+    uLongf zlen = compressBound(len);
+    unsigned char* buf = (unsigned char*)malloc(QORE_SQLITE3_COMPRESSED_HEADER_SIZE + zlen);
+    if (!buf) {
+        return nullptr;
+    }
+    if (compress2(buf + QORE_SQLITE3_COMPRESSED_HEADER_SIZE, &zlen, (const Bytef*)data, len, Z_DEFAULT_COMPRESSION)
+        != Z_OK || QORE_SQLITE3_COMPRESSED_HEADER_SIZE + zlen >= len) {
+        free(buf);
+        return nullptr;
+    }
+    buf[0] = text ? QORE_SQLITE3_COMPRESSED_TEXT : QORE_SQLITE3_COMPRESSED_BLOB;
+    for (int i = 0; i < 4; ++i) {
+        buf[i + 1] = (unsigned char)(len >> (i * 8));
+    }
+    out_len = QORE_SQLITE3_COMPRESSED_HEADER_SIZE + zlen;
+    return (char*)buf;
+}
+
+// decompresses a value into a new buffer, which is terminated for TEXT values; returns nullptr if the value is not
+// a valid compressed value
+static char* decompress_value(const void* data, size_t len, bool& text, size_t& out_len) {
+    const unsigned char* p = (const unsigned char*)data;
+    if (len < QORE_SQLITE3_COMPRESSED_HEADER_SIZE
+        || (p[0] != QORE_SQLITE3_COMPRESSED_TEXT && p[0] != QORE_SQLITE3_COMPRESSED_BLOB)) {
+        return nullptr;
+    }
+    text = p[0] == QORE_SQLITE3_COMPRESSED_TEXT;
+    size_t size = 0;
+    for (int i = 0; i < 4; ++i) {
+        size |= (size_t)p[i + 1] << (i * 8);
+    }
+    // zlib cannot compress by more than about 1032:1, so the size of a value that only looks compressed is not
+    // trusted for the allocation
+    if (size > (len - QORE_SQLITE3_COMPRESSED_HEADER_SIZE) * 1032 + 64) {
+        return nullptr;
+    }
+    // the stored size is known, so the value is decompressed into a buffer allocated once
+    char* buf = (char*)malloc(size + 1);
+    if (!buf) {
+        return nullptr;
+    }
+    uLongf dlen = size;
+    if (uncompress((Bytef*)buf, &dlen, p + QORE_SQLITE3_COMPRESSED_HEADER_SIZE,
+        len - QORE_SQLITE3_COMPRESSED_HEADER_SIZE) != Z_OK || dlen != size) {
+        free(buf);
+        return nullptr;
+    }
+    buf[size] = '\0';
+    out_len = size;
+    return buf;
+}
+
+QoreValue QoreSqlite3Compression::decompress(const void* data, size_t len) {
+    bool text;
+    size_t size;
+    char* buf = decompress_value(data, len, text, size);
+    if (!buf) {
+        return QoreValue();
+    }
+    if (text) {
+        return new QoreStringNode(buf, size, size + 1, QCS_UTF8);
+    }
+    return new BinaryNode(buf, size);
+}
+
+static void qore_compress(sqlite3_context* ctx, int argc, sqlite3_value** argv) {
+    int type = sqlite3_value_type(argv[0]);
+    if (type != SQLITE_TEXT && type != SQLITE_BLOB) {
+        // NULL and numeric values are returned unchanged
+        sqlite3_result_value(ctx, argv[0]);
+        return;
+    }
+    const void* data = type == SQLITE_TEXT ? (const void*)sqlite3_value_text(argv[0]) : sqlite3_value_blob(argv[0]);
+    int size = sqlite3_value_bytes(argv[0]);
+    // values below the connection's threshold, and values that compression does not make smaller, are stored as
+    // they are, so that small values can still be compared and searched in SQL
+    size_t len;
+    char* buf = size < *(const int64*)sqlite3_user_data(ctx) ? nullptr
+        : compress_value(data, size, type == SQLITE_TEXT, len);
+    if (!buf) {
+        sqlite3_result_value(ctx, argv[0]);
+        return;
+    }
+    sqlite3_result_blob64(ctx, buf, len, free);
+}
+
+static void qore_decompress(sqlite3_context* ctx, int argc, sqlite3_value** argv) {
+    if (sqlite3_value_type(argv[0]) != SQLITE_BLOB) {
+        sqlite3_result_value(ctx, argv[0]);
+        return;
+    }
+    bool text;
+    size_t len;
+    char* buf = decompress_value(sqlite3_value_blob(argv[0]), sqlite3_value_bytes(argv[0]), text, len);
+    if (!buf) {
+        // values that were not compressed by the driver are returned as stored
+        sqlite3_result_value(ctx, argv[0]);
+    } else if (text) {
+        sqlite3_result_text64(ctx, buf, len, free, SQLITE_UTF8);
+    } else {
+        sqlite3_result_blob64(ctx, buf, len, free);
+    }
+}
+
+int QoreSqlite3Compression::registerFunctions(sqlite3* db, const int64* threshold) {
+    // qore_compress() depends on the connection's threshold, which can change; qore_decompress() is deterministic,
+    // so that it can be used in indexes, generated columns and constant folding
+    int rc = sqlite3_create_function_v2(db, SQLITE3_COMPRESS_FUNC, 1, SQLITE_UTF8, (void*)threshold, qore_compress,
+        nullptr, nullptr, nullptr);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_create_function_v2(db, SQLITE3_DECOMPRESS_FUNC, 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+            qore_decompress, nullptr, nullptr, nullptr);
+    }
+    return rc;
+}
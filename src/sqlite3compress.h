@@ -0,0 +1,67 @@
+/*
+  sqlite3compress.h
+
+  Qore Programming Language
+
+  Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SQLITE3COMPRESS_H
+#define SQLITE3COMPRESS_H
+
+#include <sqlite3.h>
+#include <qore/Qore.h>
+
+//! The SQL function that compresses a value
+#define SQLITE3_COMPRESS_FUNC "qore_compress"
+//! The SQL function that decompresses a value compressed by the driver
+#define SQLITE3_DECOMPRESS_FUNC "qore_decompress"
+
+//! The header byte of compressed TEXT values
+#define QORE_SQLITE3_COMPRESSED_TEXT 0xc1
+//! The header byte of compressed BLOB values
+#define QORE_SQLITE3_COMPRESSED_BLOB 0xc2
+//! The size of the header: the header byte and the uncompressed size as a 32-bit little-endian integer
+#define QORE_SQLITE3_COMPRESSED_HEADER_SIZE 5
+
+/*! \brief Compresses large TEXT and BLOB values with zlib in SQL with qore_compress().
+
+    Compressed values are stored as BLOBs that start with a header byte for the original type, followed by the
+    uncompressed size and the zlib stream.  Values that do not start with a valid header, such as values stored
+    before compression was enabled, are returned as stored.
+*/
+class QoreSqlite3Compression {
+public:
+    /*! \brief Decompresses a value compressed by compress().
+
+        \retval QoreValue a string for TEXT values or a binary for BLOB values; no value if the data does not start
+        with a valid header or cannot be decompressed
+    */
+    DLLLOCAL static QoreValue decompress(const void* data, size_t len);
+
+    /*! \brief Registers the qore_compress() and qore_decompress() SQL functions on a connection.
+
+        \param db the connection
+        \param threshold the size from which qore_compress() compresses values; must stay valid while the
+        connection is open
+
+        \retval int an SQLite result code
+    */
+    DLLLOCAL static int registerFunctions(sqlite3* db, const int64* threshold);
+};
+
+#endif
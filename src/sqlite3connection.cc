@@ -21,7 +21,69 @@
 */
 
 #include "sqlite3connection.h"
+#include "config.h"
+#include "sqlite3compress.h"
+#include "sqlite3lob.h"
+#include "sqlite3module.h"
 
+#include <ctype.h>
+#include <strings.h>
+
+//! WAL checkpoint mode names for the "checkpoint" option
+static const struct {
+    const char* name;
+    int mode;
+} checkpoint_modes[] = {
+    {"passive", SQLITE_CHECKPOINT_PASSIVE},
+    {"restart", SQLITE_CHECKPOINT_RESTART},
+    {"truncate", SQLITE_CHECKPOINT_TRUNCATE},
+};
+
+//! Conflict action names for the "conflict" option
+static const struct {
+    const char* name;
+    QoreSqlite3ConflictAction action;
+} conflict_actions[] = {
+    {"abort", SQLITE3_CONFLICT_ABORT},
+    {"omit", SQLITE3_CONFLICT_OMIT},
+    {"replace", SQLITE3_CONFLICT_REPLACE},
+};
+
+//! Per-schema settings for the "attach" option, applied with PRAGMA schema.setting = value
+static const struct {
+    const char* name;
+    bool numeric;
+} attach_settings[] = {
+    {"cache_size", true},
+    {"mmap_size", true},
+    {"journal_mode", false},
+    {"synchronous", false},
+};
+
+// options that run an operation when set instead of configuring the connection; they cannot be used as connection
+// options, which are applied again every time the connection is opened
+static const char* command_options[] = {
+    SQLITE3_OPT_APPLY_CHANGESET, SQLITE3_OPT_SAVEPOINT, SQLITE3_OPT_RELEASE_SAVEPOINT, SQLITE3_OPT_ROLLBACK_SAVEPOINT,
+};
+
+// runs ATTACH or DETACH with its arguments bound to ?1 and ?2
+static int exec_attach(sqlite3* db, const char* sql, const char* p1, const char* p2, ExceptionSink* xsink) {
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, p1, -1, SQLITE_STATIC);
+        if (p2) {
+            sqlite3_bind_text(stmt, 2, p2, -1, SQLITE_STATIC);
+        }
+        rc = sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+    }
+    if (rc != SQLITE_OK && rc != SQLITE_DONE) {
+        xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s': %s", SQLITE3_OPT_ATTACH, sqlite3_errmsg(db));
+        return -1;
+    }
+    return 0;
+}
 
 QoreSqlite3Connection::QoreSqlite3Connection(sqlite3* handler, const QoreEncoding* enc)
         : m_handler(handler), enc(enc) {
@@ -32,12 +94,25 @@ bool QoreSqlite3Connection::begin(ExceptionSink* xsink) {
         return true;
     }
     char * zErrMsg = 0;
-    int rc = sqlite3_exec(m_handler, "BEGIN;", NULL, 0, &zErrMsg);
+    // a connection may not know that the database is in WAL mode before it has read from it
+    int rc = sqlite3_exec(m_handler, pending_snapshot ? "PRAGMA application_id; BEGIN;" : "BEGIN;", NULL, 0,
+        &zErrMsg);
     if (rc != SQLITE_OK) {
         xsink->raiseException("SQLITE3-BEGIN-ERROR", zErrMsg);
         sqlite3_free(zErrMsg);
         return false;
     }
+    endTransaction();
+
+    if (pending_snapshot) {
+        QoreSqlite3Snapshot* s = pending_snapshot;
+        pending_snapshot = nullptr;
+        ON_BLOCK_EXIT_OBJ(*s, &QoreSqlite3Snapshot::deref);
+        if (s->open(m_handler, xsink)) {
+            sqlite3_exec(m_handler, "ROLLBACK;", NULL, 0, NULL);
+            return false;
+        }
+    }
     return true;
 }
 
@@ -45,14 +120,20 @@ bool QoreSqlite3Connection::commit(ExceptionSink* xsink) {
     char * zErrMsg = 0;
     int rc = sqlite3_exec(m_handler, "COMMIT;", NULL, 0, &zErrMsg);
     if (rc != SQLITE_OK) {
+        // a failed commit, for example with SQLITE_BUSY, leaves the transaction open with its savepoints and snapshot
+        if (sqlite3_get_autocommit(m_handler)) {
+            endTransaction();
+        }
         xsink->raiseException("SQLITE3-COMMIT-ERROR", zErrMsg);
         sqlite3_free(zErrMsg);
         return false;
     }
+    endTransaction();
     return true;
 }
 
 bool QoreSqlite3Connection::rollback(ExceptionSink* xsink) {
+    endTransaction();
     char * zErrMsg = 0;
 
     int rc = sqlite3_exec(m_handler, "ROLLBACK;", NULL, 0, &zErrMsg);
@@ -65,10 +146,986 @@ bool QoreSqlite3Connection::rollback(ExceptionSink* xsink) {
 }
 
 bool QoreSqlite3Connection::close() {
+    // sessions and the statements of the caches must be deleted before the connection is closed
+    clearSession();
+    stmt_cache.clear();
+    {
+        ExceptionSink xsink;
+        deleteResultCache(&xsink);
+        deleteChangeEvents(&xsink);
+    }
     int rc = sqlite3_close(m_handler);
-    return (rc == SQLITE_OK);
+    if (rc != SQLITE_OK) {
+        return false;
+    }
+    if (bg) {
+        bg->deref();
+        bg = nullptr;
+    }
+    endTransaction();
+    if (pending_snapshot) {
+        pending_snapshot->deref();
+        pending_snapshot = nullptr;
+    }
+    return true;
+}
+
+void QoreSqlite3Connection::addReprepares(sqlite3_stmt* stmt) {
+#ifdef SQLITE_STMTSTATUS_REPREPARE
+    reprepares += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_REPREPARE, 0);
+#endif
+}
+
+int64 QoreSqlite3Connection::getReprepares() {
+    // cached statements are not SQLStatements
+    int64 rv = reprepares - stmt_cache.getReprepares();
+#ifdef SQLITE_STMTSTATUS_REPREPARE
+    // statements that are still open
+    for (sqlite3_stmt* stmt = sqlite3_next_stmt(m_handler, nullptr); stmt; stmt = sqlite3_next_stmt(m_handler, stmt)) {
+        rv += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_REPREPARE, 0);
+    }
+#endif
+    return rv;
+}
+
+void QoreSqlite3Connection::updateHook(void* arg, int op, const char* dbname, const char* table,
+        sqlite3_int64 rowid) {
+    QoreSqlite3Connection* conn = reinterpret_cast<QoreSqlite3Connection*>(arg);
+    if (conn->result_cache) {
+        conn->result_cache->rowChanged(dbname, table);
+    }
+    // with column values, changes are recorded by the preupdate hook
+    if (conn->events && !conn->preupdate_hook) {
+        conn->events->rowChanged(op, dbname, table, rowid);
+    }
+}
+
+int QoreSqlite3Connection::commitHook(void* arg) {
+    QoreSqlite3Connection* conn = reinterpret_cast<QoreSqlite3Connection*>(arg);
+    if (conn->result_cache) {
+        conn->result_cache->transactionEnded();
+    }
+    if (conn->events) {
+        conn->events->committing();
+    }
+    return 0;
+}
+
+void QoreSqlite3Connection::rollbackHook(void* arg) {
+    QoreSqlite3Connection* conn = reinterpret_cast<QoreSqlite3Connection*>(arg);
+    if (conn->result_cache) {
+        conn->result_cache->transactionEnded();
+    }
+    if (conn->events) {
+        conn->events->rolledBack();
+    }
+}
+
+void QoreSqlite3Connection::preupdateHook(void* arg, sqlite3* db, int op, const char* dbname, const char* table,
+        sqlite3_int64 old_rowid, sqlite3_int64 new_rowid) {
+    QoreSqlite3Connection* conn = reinterpret_cast<QoreSqlite3Connection*>(arg);
+    if (conn->events) {
+        conn->events->rowChanging(db, op, dbname, table, old_rowid, new_rowid);
+    }
+}
+
+void QoreSqlite3Connection::setHooks() {
+    if (result_cache || events) {
+        sqlite3_update_hook(m_handler, updateHook, this);
+        sqlite3_commit_hook(m_handler, commitHook, this);
+        sqlite3_rollback_hook(m_handler, rollbackHook, this);
+    } else {
+        sqlite3_update_hook(m_handler, nullptr, nullptr);
+        sqlite3_commit_hook(m_handler, nullptr, nullptr);
+        sqlite3_rollback_hook(m_handler, nullptr, nullptr);
+    }
+#ifdef HAVE_SQLITE3_PREUPDATE_HOOK
+    // the preupdate hook is shared with the session extension, so it is only installed while it is needed
+    bool need_preupdate = events && change_values;
+    if (need_preupdate != preupdate_hook) {
+        if (need_preupdate) {
+            sqlite3_preupdate_hook(m_handler, preupdateHook, this);
+        } else {
+            sqlite3_preupdate_hook(m_handler, nullptr, nullptr);
+        }
+        preupdate_hook = need_preupdate;
+    }
+#endif
+}
+
+int QoreSqlite3Connection::setResultCache(const QoreValue val, ExceptionSink* xsink) {
+    int64 size = val.getAsBigInt();
+    if (size < 0) {
+        xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s' must not be negative; got " QLLD,
+            SQLITE3_OPT_RESULT_CACHE, size);
+        return -1;
+    }
+    if (!size) {
+        deleteResultCache(xsink);
+        return 0;
+    }
+    if (result_cache) {
+        result_cache->setMaxSize(size, xsink);
+        return 0;
+    }
+    result_cache = new QoreSqlite3ResultCache(m_handler, size);
+    setHooks();
+    return 0;
+}
+
+void QoreSqlite3Connection::deleteResultCache(ExceptionSink* xsink) {
+    if (!result_cache) {
+        return;
+    }
+    result_cache->clear(xsink);
+    delete result_cache;
+    result_cache = nullptr;
+    setHooks();
+}
+
+int QoreSqlite3Connection::setChangeEvents(const QoreValue val, ExceptionSink* xsink) {
+    if (val.isNullOrNothing()) {
+        deleteChangeEvents(xsink);
+        return 0;
+    }
+    const ResolvedCallReferenceNode* callback = dynamic_cast<const ResolvedCallReferenceNode*>(
+        val.getInternalNode());
+    if (!callback) {
+        xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s' expects a closure or call reference or "
+            "NOTHING; got type '%s'", SQLITE3_OPT_CHANGE_EVENTS, val.getTypeName());
+        return -1;
+    }
+    callback->ref();
+    if (events) {
+        events->setCallback(const_cast<ResolvedCallReferenceNode*>(callback), xsink);
+        return 0;
+    }
+    events = new QoreSqlite3ChangeEvents(const_cast<ResolvedCallReferenceNode*>(callback));
+    setHooks();
+    return 0;
+}
+
+int QoreSqlite3Connection::setChangeValues(bool val, ExceptionSink* xsink) {
+#ifdef HAVE_SQLITE3_PREUPDATE_HOOK
+    if (val && session) {
+        xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s' cannot be enabled while a session is "
+            "recording changes", SQLITE3_OPT_CHANGE_VALUES);
+        return -1;
+    }
+    change_values = val;
+    setHooks();
+    return 0;
+#else
+    if (!val) {
+        return 0;
+    }
+    xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s' requires an sqlite3 library built with "
+        "SQLITE_ENABLE_PREUPDATE_HOOK", SQLITE3_OPT_CHANGE_VALUES);
+    return -1;
+#endif
+}
+
+void QoreSqlite3Connection::deleteChangeEvents(ExceptionSink* xsink) {
+    if (!events) {
+        return;
+    }
+    events->release(xsink);
+    delete events;
+    events = nullptr;
+    setHooks();
+}
+
+QoreValue QoreSqlite3Connection::getDataVersion(ExceptionSink* xsink) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(m_handler, "pragma data_version", -1, &stmt, nullptr) != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s': %s", SQLITE3_OPT_DATA_VERSION,
+            sqlite3_errmsg(m_handler));
+        return QoreValue();
+    }
+    ON_BLOCK_EXIT(sqlite3_finalize, stmt);
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s': %s", SQLITE3_OPT_DATA_VERSION,
+            sqlite3_errmsg(m_handler));
+        return QoreValue();
+    }
+    return (int64)sqlite3_column_int64(stmt, 0);
 }
 
 char * QoreSqlite3Connection::getServerVersion() {
     return (char*)sqlite3_libversion();
 }
+
+int QoreSqlite3Connection::updateBackground(bool new_checkpoint, ExceptionSink* xsink) {
+    if (!new_checkpoint && !maintenance_policy.interval_ms) {
+        if (bg) {
+            if (checkpoint) {
+                bg->detach(m_handler);
+            }
+            bg->deref();
+            bg = nullptr;
+        }
+        checkpoint = false;
+        return 0;
+    }
+
+    if (!bg) {
+        bg = QoreSqlite3BackgroundWorker::get(m_handler, xsink);
+        if (!bg) {
+            return -1;
+        }
+    }
+    if (new_checkpoint != checkpoint) {
+        if (new_checkpoint) {
+            bg->attach(m_handler);
+        } else {
+            bg->detach(m_handler);
+        }
+        checkpoint = new_checkpoint;
+    }
+    if (checkpoint) {
+        bg->setCheckpointPolicy(checkpoint_policy);
+    }
+    // always pushed, so that setting maintenance-interval to 0 stops background maintenance while checkpoints continue
+    bg->setMaintenancePolicy(maintenance_policy);
+    return 0;
+}
+
+void QoreSqlite3Connection::endTransaction() {
+    if (snapshot) {
+        snapshot->deref();
+        snapshot = nullptr;
+    }
+    savepoints.clear();
+}
+
+int QoreSqlite3Connection::setSavepoint(const QoreValue val, ExceptionSink* xsink) {
+    if (sqlite3_get_autocommit(m_handler)) {
+        savepoints.clear();
+        xsink->raiseException("SQLITE3-SAVEPOINT-ERROR", "a savepoint can only be set in a transaction");
+        return -1;
+    }
+
+    std::string name;
+    if (!val.isNullOrNothing()) {
+        QoreStringValueHelper str(val, QCS_UTF8, xsink);
+        if (*xsink) {
+            return -1;
+        }
+        name = str->c_str();
+    }
+    if (name.empty()) {
+        name = "qore_savepoint_" + std::to_string(savepoints.size() + 1);
+    }
+
+    std::string sql = "savepoint " + qore_sqlite3_quote_identifier(name);
+    if (sqlite3_exec(m_handler, sql.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-SAVEPOINT-ERROR", "%s", sqlite3_errmsg(m_handler));
+        return -1;
+    }
+    savepoint_changes.resize(savepoints.size());
+    savepoint_changes.push_back(events ? events->getPendingCount() : 0);
+    savepoints.push_back(name);
+    return 0;
+}
+
+int QoreSqlite3Connection::endSavepoint(const char* opt, const QoreValue val, bool rollback,
+        ExceptionSink* xsink) {
+    // an error may have rolled back the transaction
+    if (sqlite3_get_autocommit(m_handler)) {
+        savepoints.clear();
+    }
+    if (savepoints.empty()) {
+        xsink->raiseException("SQLITE3-SAVEPOINT-ERROR", "option '%s': there is no savepoint in the current "
+            "transaction", opt);
+        return -1;
+    }
+
+    // the innermost savepoint with the given name is used, as in SQLite
+    size_t i = savepoints.size() - 1;
+    if (!val.isNullOrNothing()) {
+        QoreStringValueHelper str(val, QCS_UTF8, xsink);
+        if (*xsink) {
+            return -1;
+        }
+        // savepoint names are case-insensitive in SQLite
+        while (strcasecmp(savepoints[i].c_str(), str->c_str())) {
+            if (!i--) {
+                xsink->raiseException("SQLITE3-SAVEPOINT-ERROR", "option '%s': there is no savepoint '%s' in the "
+                    "current transaction", opt, str->c_str());
+                return -1;
+            }
+        }
+    }
+
+    std::string sql = (rollback ? "rollback to " : "release ") + qore_sqlite3_quote_identifier(savepoints[i]);
+    if (sqlite3_exec(m_handler, sql.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-SAVEPOINT-ERROR", "%s", sqlite3_errmsg(m_handler));
+        return -1;
+    }
+    if (rollback && events && i < savepoint_changes.size()) {
+        events->discardPending(savepoint_changes[i]);
+    }
+    // a savepoint that has been rolled back to remains active; nested savepoints are removed in both cases
+    savepoints.resize(rollback ? i + 1 : i);
+    savepoint_changes.resize(savepoints.size());
+    return 0;
+}
+
+void QoreSqlite3Connection::snapshotFunc(sqlite3_context* ctx, int argc, sqlite3_value** argv) {
+    QoreSqlite3Connection* conn = reinterpret_cast<QoreSqlite3Connection*>(sqlite3_user_data(ctx));
+    if (!conn->snapshot) {
+        if (sqlite3_get_autocommit(conn->m_handler)) {
+            sqlite3_result_error(ctx, "a snapshot can only be captured in a transaction", -1);
+            return;
+        }
+        std::string err;
+        conn->snapshot = QoreSqlite3Snapshot::capture(conn->m_handler, err);
+        if (!conn->snapshot) {
+            sqlite3_result_error(ctx, err.c_str(), -1);
+            return;
+        }
+    }
+    sqlite3_result_int64(ctx, conn->snapshot->getId());
+}
+
+void QoreSqlite3Connection::takeChanges(sqlite3_context* ctx, bool patchset) {
+    QoreSqlite3Connection* conn = reinterpret_cast<QoreSqlite3Connection*>(sqlite3_user_data(ctx));
+    if (!conn->session) {
+        sqlite3_result_null(ctx);
+        return;
+    }
+    int size;
+    void* data;
+    std::string err;
+    if (conn->session->take(patchset, size, data, err)) {
+        sqlite3_result_error(ctx, err.c_str(), -1);
+        return;
+    }
+    if (size) {
+        sqlite3_result_blob(ctx, data, size, sqlite3_free);
+    } else {
+        sqlite3_free(data);
+        sqlite3_result_zeroblob(ctx, 0);
+    }
+}
+
+void QoreSqlite3Connection::changesetFunc(sqlite3_context* ctx, int argc, sqlite3_value** argv) {
+    takeChanges(ctx, false);
+}
+
+void QoreSqlite3Connection::patchsetFunc(sqlite3_context* ctx, int argc, sqlite3_value** argv) {
+    takeChanges(ctx, true);
+}
+
+int QoreSqlite3Connection::registerFunctions() {
+    int rc = sqlite3_create_function_v2(m_handler, "qore_snapshot", 0, SQLITE_UTF8, this, snapshotFunc, nullptr,
+        nullptr, nullptr);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_create_function_v2(m_handler, "qore_changeset", 0, SQLITE_UTF8, this, changesetFunc, nullptr,
+            nullptr, nullptr);
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_create_function_v2(m_handler, "qore_patchset", 0, SQLITE_UTF8, this, patchsetFunc, nullptr,
+            nullptr, nullptr);
+    }
+    if (rc == SQLITE_OK) {
+        rc = QoreSqlite3Compression::registerFunctions(m_handler, &compression);
+    }
+    return rc;
+}
+
+bool QoreSqlite3Connection::isCommandOption(const char* opt) {
+    for (const char* o : command_options) {
+        if (!strcasecmp(opt, o)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int QoreSqlite3Connection::setSnapshot(const QoreValue val, ExceptionSink* xsink) {
+    if (pending_snapshot) {
+        pending_snapshot->deref();
+        pending_snapshot = nullptr;
+    }
+
+    int64 id = val.getAsBigInt();
+    if (!id) {
+        return 0;
+    }
+
+    QoreSqlite3Snapshot* s = QoreSqlite3Snapshot::find(id, xsink);
+    if (!s) {
+        return -1;
+    }
+    if (sqlite3_get_autocommit(m_handler)) {
+        pending_snapshot = s;
+        return 0;
+    }
+
+    // upgrade the read transaction that is already open
+    ON_BLOCK_EXIT_OBJ(*s, &QoreSqlite3Snapshot::deref);
+    return s->open(m_handler, xsink);
+}
+
+void QoreSqlite3Connection::clearSession() {
+    if (session) {
+        delete session;
+        session = nullptr;
+    }
+    if (conflict_handler) {
+        ExceptionSink xsink;
+        conflict_handler->deref(&xsink);
+        conflict_handler = nullptr;
+        xsink.clear();
+    }
+}
+
+int QoreSqlite3Connection::setSession(const QoreValue val, ExceptionSink* xsink) {
+    if (session) {
+        delete session;
+        session = nullptr;
+    }
+    if (val.isNullOrNothing() || (val.getType() == NT_STRING && val.get<const QoreStringNode>()->empty())) {
+        return 0;
+    }
+    // sessions use the preupdate hook
+    if (preupdate_hook) {
+        xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s' cannot be set while option '%s' is enabled",
+            SQLITE3_OPT_SESSION, SQLITE3_OPT_CHANGE_VALUES);
+        return -1;
+    }
+    session = QoreSqlite3Session::create(m_handler, val, xsink);
+    return session ? 0 : -1;
+}
+
+int QoreSqlite3Connection::setConflict(const QoreValue val, ExceptionSink* xsink) {
+    const ResolvedCallReferenceNode* handler = dynamic_cast<const ResolvedCallReferenceNode*>(
+        val.getInternalNode());
+    if (handler) {
+        if (conflict_handler) {
+            conflict_handler->deref(xsink);
+        }
+        conflict_handler = static_cast<ResolvedCallReferenceNode*>(handler->refSelf());
+        return 0;
+    }
+
+    QoreStringValueHelper str(val);
+    for (const auto& i : conflict_actions) {
+        if (!strcasecmp(str->c_str(), i.name)) {
+            if (conflict_handler) {
+                conflict_handler->deref(xsink);
+                conflict_handler = nullptr;
+            }
+            conflict_action = i.action;
+            return 0;
+        }
+    }
+    xsink->raiseException("SQLITE3-OPTION-ERROR", "invalid value '%s' for option '%s'; expecting a closure or call "
+        "reference or one of 'abort', 'omit' or 'replace'", str->c_str(), SQLITE3_OPT_CONFLICT);
+    return -1;
+}
+
+int QoreSqlite3Connection::applyChangeset(const QoreValue val, ExceptionSink* xsink) {
+    if (val.getType() != NT_BINARY) {
+        xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s' expects a binary changeset; got type '%s'",
+            SQLITE3_OPT_APPLY_CHANGESET, val.getTypeName());
+        return -1;
+    }
+    return QoreSqlite3Session::apply(m_handler, val.get<const BinaryNode>(), conflict_handler, conflict_action,
+        xsink);
+}
+
+int QoreSqlite3Connection::setWarmUpList(const char* opt, const QoreValue val, std::vector<std::string>& list,
+        ExceptionSink* xsink) {
+    std::vector<std::string> new_list;
+    switch (val.getType()) {
+        case NT_NOTHING:
+        case NT_NULL:
+            break;
+
+        case NT_STRING: {
+            QoreStringValueHelper str(val, QCS_UTF8, xsink);
+            if (*xsink) {
+                return -1;
+            }
+            new_list.push_back(str->c_str());
+            break;
+        }
+
+        case NT_LIST: {
+            ConstListIterator i(val.get<const QoreListNode>());
+            while (i.next()) {
+                if (i.getValue().getType() != NT_STRING) {
+                    xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s' expects a string or a list of "
+                        "strings; got an element of type '%s'", opt, i.getValue().getTypeName());
+                    return -1;
+                }
+                QoreStringValueHelper str(i.getValue(), QCS_UTF8, xsink);
+                if (*xsink) {
+                    return -1;
+                }
+                new_list.push_back(str->c_str());
+            }
+            break;
+        }
+
+        default:
+            xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s' expects a string or a list of strings; got "
+                "type '%s'", opt, val.getTypeName());
+            return -1;
+    }
+    list.swap(new_list);
+    // connection options are applied by warmUp() once all of them have been set
+    return opened && !list.empty() ? warmUp(xsink) : 0;
+}
+
+int QoreSqlite3Connection::warmUp(ExceptionSink* xsink) {
+    opened = true;
+    if (warmup_sql.empty() && warmup_tables.empty()) {
+        return 0;
+    }
+    return QoreSqlite3WarmUp::run(m_handler, prepare_flags, &stmt_cache, warmup_sql, warmup_tables, warmup_result,
+        xsink);
+}
+
+int QoreSqlite3Connection::setAttach(const QoreValue val, ExceptionSink* xsink) {
+    if (detachAll(xsink)) {
+        return -1;
+    }
+    if (val.isNullOrNothing()) {
+        return 0;
+    }
+    if (val.getType() != NT_HASH) {
+        xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s' expects a hash of schema names to file names or "
+            "hashes of settings; got type '%s'", SQLITE3_OPT_ATTACH, val.getTypeName());
+        return -1;
+    }
+
+    ConstHashIterator hi(val.get<const QoreHashNode>());
+    while (hi.next()) {
+        const char* schema = hi.getKey();
+        const QoreValue v = hi.get();
+        const QoreHashNode* settings = nullptr;
+        QoreValue file = v;
+        if (v.getType() == NT_HASH) {
+            settings = v.get<const QoreHashNode>();
+            file = settings->getKeyValue("file");
+        }
+        if (file.getType() != NT_STRING) {
+            xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s': expecting a file name or a hash with a "
+                "'file' key for schema '%s'", SQLITE3_OPT_ATTACH, schema);
+            return -1;
+        }
+        TempEncodingHelper fn(file.get<const QoreStringNode>(), QCS_UTF8, xsink);
+        if (*xsink || exec_attach(m_handler, "attach database ?1 as ?2", fn->c_str(), schema, xsink)) {
+            return -1;
+        }
+        attached.push_back(schema);
+
+        if (!settings) {
+            continue;
+        }
+        ConstHashIterator si(settings);
+        while (si.next()) {
+            const char* name = si.getKey();
+            if (!strcasecmp(name, "file")) {
+                continue;
+            }
+            std::string sql;
+            for (const auto& i : attach_settings) {
+                if (!strcasecmp(name, i.name)) {
+                    sql = "pragma " + qore_sqlite3_quote_identifier(schema) + "." + i.name + " = ";
+                    if (i.numeric) {
+                        sql += std::to_string(si.get().getAsBigInt());
+                    } else {
+                        QoreStringValueHelper str(si.get());
+                        // only pragma keywords are accepted, as the value is inserted in the pragma statement
+                        for (const char* p = str->c_str(); *p; ++p) {
+                            if (!isalnum(*p)) {
+                                xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s': invalid value '%s' for "
+                                    "setting '%s' of schema '%s'", SQLITE3_OPT_ATTACH, str->c_str(), name, schema);
+                                return -1;
+                            }
+                        }
+                        sql += str->c_str();
+                    }
+                    break;
+                }
+            }
+            if (sql.empty()) {
+                xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s': unknown setting '%s' for schema '%s'; "
+                    "expecting 'file', 'cache_size', 'mmap_size', 'journal_mode' or 'synchronous'",
+                    SQLITE3_OPT_ATTACH, name, schema);
+                return -1;
+            }
+            if (sqlite3_exec(m_handler, sql.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+                xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s': cannot set '%s' for schema '%s': %s",
+                    SQLITE3_OPT_ATTACH, name, schema, sqlite3_errmsg(m_handler));
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int QoreSqlite3Connection::detachAll(ExceptionSink* xsink) {
+    while (!attached.empty()) {
+        if (exec_attach(m_handler, "detach database ?1", attached.back().c_str(), nullptr, xsink)) {
+            return -1;
+        }
+        attached.pop_back();
+    }
+    return 0;
+}
+
+QoreHashNode* QoreSqlite3Connection::getAttached(ExceptionSink* xsink) {
+    ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+    for (const auto& schema : attached) {
+        const char* fn = sqlite3_db_filename(m_handler, schema.c_str());
+        h->setKeyValue(schema.c_str(), new QoreStringNode(fn ? fn : "", QCS_UTF8), xsink);
+    }
+    return h.release();
+}
+
+static int get_non_negative_option(const char* opt, const QoreValue val, int64& rv, ExceptionSink* xsink) {
+    int64 v = val.getAsBigInt();
+    if (v < 0) {
+        xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s' cannot be negative; got " QLLD, opt, v);
+        return -1;
+    }
+    rv = v;
+    return 0;
+}
+
+int QoreSqlite3Connection::setOption(const char* opt, const QoreValue val, ExceptionSink* xsink) {
+    if (!strcasecmp(opt, SQLITE3_OPT_CHECKPOINT)) {
+        QoreStringValueHelper str(val);
+        if (!strcasecmp(str->c_str(), "off")) {
+            return updateBackground(false, xsink);
+        }
+        for (const auto& i : checkpoint_modes) {
+            if (!strcasecmp(str->c_str(), i.name)) {
+                checkpoint_policy.mode = i.mode;
+                return updateBackground(true, xsink);
+            }
+        }
+        xsink->raiseException("SQLITE3-OPTION-ERROR", "invalid value '%s' for option '%s'; expecting one of "
+            "'off', 'passive', 'restart' or 'truncate'", str->c_str(), opt);
+        return -1;
+    }
+
+    if (!strcasecmp(opt, SQLITE3_OPT_SNAPSHOT)) {
+        return setSnapshot(val, xsink);
+    }
+
+    if (!strcasecmp(opt, SQLITE3_OPT_SESSION)) {
+        return setSession(val, xsink);
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_CONFLICT)) {
+        return setConflict(val, xsink);
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_APPLY_CHANGESET)) {
+        return applyChangeset(val, xsink);
+    }
+
+    if (!strcasecmp(opt, SQLITE3_OPT_LOB_THRESHOLD)) {
+        int64 v;
+        if (get_non_negative_option(opt, val, v, xsink)) {
+            return -1;
+        }
+        if (v && !QoreSqlite3LobColumns::isSupported()) {
+            xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s' requires an sqlite3 library built with "
+                "SQLITE_ENABLE_COLUMN_METADATA", opt);
+            return -1;
+        }
+        // cached results were converted with the other threshold
+        if (v != lob_threshold && result_cache) {
+            result_cache->clear(xsink);
+        }
+        lob_threshold = v;
+        return 0;
+    }
+
+    if (!strcasecmp(opt, SQLITE3_OPT_NO_VTAB)) {
+        if (val.getAsBool()) {
+            // the flag is only passed with sqlite3_prepare_v3() and only honored from SQLite 3.28
+#ifdef HAVE_SQLITE3_PREPARE_V3
+            if (sqlite3_libversion_number() < 3028000) {
+                xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s' requires SQLite 3.28 or later; the "
+                    "sqlite3 library is version %s", opt, sqlite3_libversion());
+                return -1;
+            }
+#else
+            xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s' is not supported, as the driver was built "
+                "without sqlite3_prepare_v3()", opt);
+            return -1;
+#endif
+            prepare_flags |= SQLITE_PREPARE_NO_VTAB;
+        } else {
+            prepare_flags &= ~SQLITE_PREPARE_NO_VTAB;
+        }
+        // cached statements were prepared with the other flags
+        stmt_cache.clear();
+        return 0;
+    }
+
+    if (!strcasecmp(opt, SQLITE3_OPT_NATIVE_BINDING)) {
+        native_binding = val.getAsBool();
+        return 0;
+    }
+
+    if (!strcasecmp(opt, SQLITE3_OPT_EPOCH_DATES)) {
+        bool epoch = val.getAsBool();
+        // cached results were read with dates bound in the other format
+        if (epoch != epoch_dates && result_cache) {
+            result_cache->clear(xsink);
+        }
+        epoch_dates = epoch;
+        return 0;
+    }
+
+    if (!strcasecmp(opt, SQLITE3_OPT_TYPE_MAPPING)) {
+        bool v = val.getAsBool();
+        // cached results were converted with the other setting
+        if (v != type_mapping && result_cache) {
+            result_cache->clear(xsink);
+        }
+        type_mapping = v;
+        return 0;
+    }
+
+    if (!strcasecmp(opt, SQLITE3_OPT_JSON_COLUMNS)) {
+        bool v = val.getAsBool();
+        // cached results were converted with the other setting
+        if (v != json_columns && result_cache) {
+            result_cache->clear(xsink);
+        }
+        json_columns = v;
+        return 0;
+    }
+
+    if (!strcasecmp(opt, SQLITE3_OPT_COMPRESSION)) {
+        int64 v;
+        if (get_non_negative_option(opt, val, v, xsink)) {
+            return -1;
+        }
+        // cached results of qore_compress() were computed with the other threshold
+        if (v != compression && result_cache) {
+            result_cache->clear(xsink);
+        }
+        compression = v;
+        return 0;
+    }
+
+    if (!strcasecmp(opt, SQLITE3_OPT_RESULT_CACHE)) {
+        return setResultCache(val, xsink);
+    }
+
+    if (!strcasecmp(opt, SQLITE3_OPT_STATEMENT_CACHE)) {
+        int64 v;
+        if (get_non_negative_option(opt, val, v, xsink)) {
+            return -1;
+        }
+        stmt_cache.setMaxSize((size_t)v);
+        return 0;
+    }
+
+    if (!strcasecmp(opt, SQLITE3_OPT_CHANGE_EVENTS)) {
+        return setChangeEvents(val, xsink);
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_CHANGE_VALUES)) {
+        return setChangeValues(val.getAsBool(), xsink);
+    }
+
+    if (!strcasecmp(opt, SQLITE3_OPT_SAVEPOINT)) {
+        return setSavepoint(val, xsink);
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_RELEASE_SAVEPOINT) || !strcasecmp(opt, SQLITE3_OPT_ROLLBACK_SAVEPOINT)) {
+        return endSavepoint(opt, val, !strcasecmp(opt, SQLITE3_OPT_ROLLBACK_SAVEPOINT), xsink);
+    }
+
+    if (!strcasecmp(opt, SQLITE3_OPT_ATTACH)) {
+        return setAttach(val, xsink);
+    }
+
+    if (!strcasecmp(opt, SQLITE3_OPT_MAX_ATTACHED)) {
+        int64 v;
+        if (get_non_negative_option(opt, val, v, xsink)) {
+            return -1;
+        }
+        // the limit cannot be raised above the library's compile-time maximum (SQLITE_MAX_ATTACHED)
+        sqlite3_limit(m_handler, SQLITE_LIMIT_ATTACHED, v > 0x7fffffff ? 0x7fffffff : (int)v);
+        return 0;
+    }
+
+    if (!strcasecmp(opt, SQLITE3_OPT_WARMUP_SQL)) {
+        return setWarmUpList(opt, val, warmup_sql, xsink);
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_WARMUP_TABLES)) {
+        return setWarmUpList(opt, val, warmup_tables, xsink);
+    }
+
+    int64* policy_val = nullptr;
+    if (!strcasecmp(opt, SQLITE3_OPT_CHECKPOINT_PAGES)) {
+        policy_val = &checkpoint_policy.pages;
+    } else if (!strcasecmp(opt, SQLITE3_OPT_CHECKPOINT_INTERVAL)) {
+        policy_val = &checkpoint_policy.interval_ms;
+    } else if (!strcasecmp(opt, SQLITE3_OPT_CHECKPOINT_IDLE)) {
+        policy_val = &checkpoint_policy.idle_ms;
+    } else if (!strcasecmp(opt, SQLITE3_OPT_MAINTENANCE_INTERVAL)) {
+        policy_val = &maintenance_policy.interval_ms;
+    } else if (!strcasecmp(opt, SQLITE3_OPT_MAINTENANCE_BUDGET)) {
+        policy_val = &maintenance_policy.budget_ms;
+    } else if (!strcasecmp(opt, SQLITE3_OPT_VACUUM_PAGES)) {
+        policy_val = &maintenance_policy.vacuum_pages;
+    } else if (!strcasecmp(opt, SQLITE3_OPT_ANALYSIS_LIMIT)) {
+        policy_val = &maintenance_policy.analysis_limit;
+    }
+    if (policy_val) {
+        if (get_non_negative_option(opt, val, *policy_val, xsink)) {
+            return -1;
+        }
+        return updateBackground(checkpoint, xsink);
+    }
+
+    if (!strcasecmp(opt, SQLITE3_OPT_WAL_STATS) || !strcasecmp(opt, SQLITE3_OPT_SAVEPOINT_DEPTH)
+        || !strcasecmp(opt, SQLITE3_OPT_REPREPARES) || !strcasecmp(opt, SQLITE3_OPT_RESULT_CACHE_STATS)
+        || !strcasecmp(opt, SQLITE3_OPT_DATA_VERSION) || !strcasecmp(opt, SQLITE3_OPT_WARMUP_STATS)
+        || !strcasecmp(opt, SQLITE3_OPT_STATEMENT_CACHE_STATS)) {
+        xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s' is read-only", opt);
+        return -1;
+    }
+
+    xsink->raiseException("SQLITE3-OPTION-ERROR", "unknown option '%s'", opt);
+    return -1;
+}
+
+QoreValue QoreSqlite3Connection::getOption(const char* opt, ExceptionSink* xsink) {
+    if (!strcasecmp(opt, SQLITE3_OPT_CHECKPOINT)) {
+        if (checkpoint) {
+            for (const auto& i : checkpoint_modes) {
+                if (i.mode == checkpoint_policy.mode) {
+                    return new QoreStringNode(i.name);
+                }
+            }
+        }
+        return new QoreStringNode("off");
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_CHECKPOINT_PAGES)) {
+        return checkpoint_policy.pages;
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_CHECKPOINT_INTERVAL)) {
+        return checkpoint_policy.interval_ms;
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_CHECKPOINT_IDLE)) {
+        return checkpoint_policy.idle_ms;
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_WAL_STATS)) {
+        return checkpoint ? bg->getWalStats(xsink) : QoreValue();
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_MAINTENANCE_INTERVAL)) {
+        return maintenance_policy.interval_ms;
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_MAINTENANCE_BUDGET)) {
+        return maintenance_policy.budget_ms;
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_VACUUM_PAGES)) {
+        return maintenance_policy.vacuum_pages;
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_ANALYSIS_LIMIT)) {
+        return maintenance_policy.analysis_limit;
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_SNAPSHOT)) {
+        return snapshot ? QoreValue(snapshot->getId()) : QoreValue();
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_SESSION)) {
+        return session ? session->getTables() : QoreValue();
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_LOB_THRESHOLD)) {
+        return lob_threshold;
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_ATTACH)) {
+        return getAttached(xsink);
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_WARMUP_SQL) || !strcasecmp(opt, SQLITE3_OPT_WARMUP_TABLES)) {
+        const std::vector<std::string>& list = !strcasecmp(opt, SQLITE3_OPT_WARMUP_SQL) ? warmup_sql : warmup_tables;
+        if (list.empty()) {
+            return QoreValue();
+        }
+        ReferenceHolder<QoreListNode> l(new QoreListNode(stringTypeInfo), xsink);
+        for (const std::string& str : list) {
+            l->push(new QoreStringNode(str.c_str(), QCS_UTF8), xsink);
+        }
+        return l.release();
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_WARMUP_STATS)) {
+        return opened && (!warmup_sql.empty() || !warmup_tables.empty()) ? warmup_result.getHash(xsink)
+            : QoreValue();
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_MAX_ATTACHED)) {
+        return sqlite3_limit(m_handler, SQLITE_LIMIT_ATTACHED, -1);
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_NO_VTAB)) {
+        return (bool)(prepare_flags & SQLITE_PREPARE_NO_VTAB);
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_REPREPARES)) {
+        return getReprepares();
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_NATIVE_BINDING)) {
+        return native_binding;
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_EPOCH_DATES)) {
+        return epoch_dates;
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_TYPE_MAPPING)) {
+        return type_mapping;
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_JSON_COLUMNS)) {
+        return json_columns;
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_COMPRESSION)) {
+        return compression;
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_RESULT_CACHE)) {
+        return result_cache ? result_cache->getMaxSize() : 0;
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_RESULT_CACHE_STATS)) {
+        return result_cache ? result_cache->getStats(xsink) : QoreValue();
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_STATEMENT_CACHE)) {
+        return (int64)stmt_cache.getMaxSize();
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_STATEMENT_CACHE_STATS)) {
+        return stmt_cache.getStats(xsink);
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_CHANGE_EVENTS)) {
+        return events ? events->getCallback() : QoreValue();
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_CHANGE_VALUES)) {
+        return change_values;
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_DATA_VERSION)) {
+        return getDataVersion(xsink);
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_SAVEPOINT) || !strcasecmp(opt, SQLITE3_OPT_SAVEPOINT_DEPTH)) {
+        if (sqlite3_get_autocommit(m_handler)) {
+            savepoints.clear();
+        }
+        if (!strcasecmp(opt, SQLITE3_OPT_SAVEPOINT_DEPTH)) {
+            return (int64)savepoints.size();
+        }
+        return savepoints.empty() ? QoreValue() : new QoreStringNode(savepoints.back().c_str(), QCS_UTF8);
+    }
+    if (!strcasecmp(opt, SQLITE3_OPT_CONFLICT)) {
+        if (conflict_handler) {
+            return conflict_handler->refSelf();
+        }
+        for (const auto& i : conflict_actions) {
+            if (i.action == conflict_action) {
+                return new QoreStringNode(i.name);
+            }
+        }
+    }
+    return QoreValue();
+}
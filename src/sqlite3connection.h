@@ -26,6 +26,60 @@
 #include <sqlite3.h>
 #include <qore/Qore.h>
 
+#include "sqlite3background.h"
+#include "sqlite3cache.h"
+#include "sqlite3events.h"
+#include "sqlite3module.h"
+#include "sqlite3session.h"
+#include "sqlite3snapshot.h"
+#include "sqlite3stmtcache.h"
+#include "sqlite3warmup.h"
+
+#include <string>
+#include <vector>
+
+// driver option names
+#define SQLITE3_OPT_CHECKPOINT          "checkpoint"
+#define SQLITE3_OPT_CHECKPOINT_PAGES    "checkpoint-pages"
+#define SQLITE3_OPT_CHECKPOINT_INTERVAL "checkpoint-interval"
+#define SQLITE3_OPT_CHECKPOINT_IDLE     "checkpoint-idle"
+#define SQLITE3_OPT_WAL_STATS           "wal-stats"
+#define SQLITE3_OPT_MAINTENANCE_INTERVAL "maintenance-interval"
+#define SQLITE3_OPT_MAINTENANCE_BUDGET  "maintenance-budget"
+#define SQLITE3_OPT_VACUUM_PAGES        "vacuum-pages"
+#define SQLITE3_OPT_ANALYSIS_LIMIT      "analysis-limit"
+#define SQLITE3_OPT_SNAPSHOT            "snapshot"
+#define SQLITE3_OPT_SESSION             "session"
+#define SQLITE3_OPT_APPLY_CHANGESET     "apply-changeset"
+#define SQLITE3_OPT_CONFLICT            "conflict"
+#define SQLITE3_OPT_LOB_THRESHOLD       "lob-threshold"
+#define SQLITE3_OPT_ATTACH              "attach"
+#define SQLITE3_OPT_MAX_ATTACHED        "max-attached"
+#define SQLITE3_OPT_SAVEPOINT           "savepoint"
+#define SQLITE3_OPT_RELEASE_SAVEPOINT   "release-savepoint"
+#define SQLITE3_OPT_ROLLBACK_SAVEPOINT  "rollback-savepoint"
+#define SQLITE3_OPT_SAVEPOINT_DEPTH     "savepoint-depth"
+#define SQLITE3_OPT_NO_VTAB             "no-vtab"
+#define SQLITE3_OPT_REPREPARES          "reprepares"
+#define SQLITE3_OPT_NATIVE_BINDING      "native-binding"
+#define SQLITE3_OPT_RESULT_CACHE        "result-cache"
+#define SQLITE3_OPT_RESULT_CACHE_STATS  "result-cache-stats"
+#define SQLITE3_OPT_CHANGE_EVENTS       "change-events"
+#define SQLITE3_OPT_CHANGE_VALUES       "change-values"
+#define SQLITE3_OPT_DATA_VERSION        "data-version"
+#define SQLITE3_OPT_EPOCH_DATES         "epoch-dates"
+#define SQLITE3_OPT_TYPE_MAPPING        "type-mapping"
+#define SQLITE3_OPT_JSON_COLUMNS        "json-columns"
+#define SQLITE3_OPT_WARMUP_SQL          "warmup-sql"
+#define SQLITE3_OPT_WARMUP_TABLES       "warmup-tables"
+#define SQLITE3_OPT_WARMUP_STATS        "warmup-stats"
+#define SQLITE3_OPT_COMPRESSION         "compression"
+#define SQLITE3_OPT_STATEMENT_CACHE     "statement-cache"
+#define SQLITE3_OPT_STATEMENT_CACHE_STATS "statement-cache-stats"
+
+//! The default maximum number of prepared statements cached on a connection
+#define QORE_SQLITE3_STATEMENT_CACHE_SIZE 32
+
 /*! \brief A Qore ready wrapper for Sqlite3 API.
     There is only one instance of this class in this module.
     All select/exec depending stuff is located in QoreSqlite3Executor,
@@ -42,7 +96,24 @@ public:
     */
     DLLLOCAL QoreSqlite3Connection(sqlite3* handler, const QoreEncoding* enc);
 
-    DLLLOCAL ~QoreSqlite3Connection() {};
+    /*! \brief Registers the SQL functions that operate on this connection's state.
+
+        \retval int an SQLite result code
+    */
+    DLLLOCAL int registerFunctions();
+
+    //! Returns true if the option runs an operation when set and so cannot be used as a connection option
+    DLLLOCAL static bool isCommandOption(const char* opt);
+
+    DLLLOCAL ~QoreSqlite3Connection() {
+        assert(!bg);
+        assert(!snapshot);
+        assert(!pending_snapshot);
+        assert(!session);
+        assert(!conflict_handler);
+        assert(!result_cache);
+        assert(!events);
+    };
 
     /*! \brief Public access to the DB conection handler.
 
@@ -52,6 +123,7 @@ public:
 
     /*! \brief Start a transaction.
         Error checking is left for sqlite3 engine.
+        If a snapshot has been set with the "snapshot" option, the transaction reads from it.
 
         \retval bool true for success; false for any error.
     */
@@ -92,12 +164,261 @@ public:
         return enc;
     }
 
+    //! Returns the size above which TEXT and BLOB values are returned as handles in row results; 0 = never
+    DLLLOCAL int64 getLobThreshold() const {
+        return lob_threshold;
+    }
+
+    //! Returns the SQLITE_PREPARE_* flags for statements prepared on this connection
+    DLLLOCAL unsigned getPrepareFlags() const {
+        return prepare_flags;
+    }
+
+    //! Returns true if SQL is passed to SQLite unparsed and arguments are bound to SQLite's own parameters
+    DLLLOCAL bool getNativeBinding() const {
+        return native_binding;
+    }
+
+    //! Returns true if absolute dates are bound as integer microseconds since the epoch
+    DLLLOCAL bool getEpochDates() const {
+        return epoch_dates;
+    }
+
+    //! Returns the QORE_SQLITE3_CONV_* conversions of column values by declared type enabled on the connection
+    DLLLOCAL unsigned getConversions() const {
+        return (type_mapping ? QORE_SQLITE3_CONV_TYPES : 0) | (epoch_dates ? QORE_SQLITE3_CONV_EPOCH : 0)
+            | (json_columns ? QORE_SQLITE3_CONV_JSON : 0);
+    }
+
+    //! Returns the result cache if read query results can be cached on the connection, otherwise nullptr
+    DLLLOCAL QoreSqlite3ResultCache* getResultCache() const {
+        // results are not shared with snapshot reads or rows with large value handles
+        return snapshot || pending_snapshot || lob_threshold ? nullptr : result_cache;
+    }
+
+    //! Returns the cache of prepared statements on the connection
+    DLLLOCAL QoreSqlite3StatementCache* getStatementCache() {
+        return &stmt_cache;
+    }
+
+    /*! \brief Passes the changes of a committed transaction to the "change-events" callback, if any.
+
+        Must be called after each DBI call that can end a transaction, outside of any SQLite callback.
+
+        \retval int 0 on success, -1 if the callback raised an exception
+    */
+    DLLLOCAL int deliverChanges(ExceptionSink* xsink) {
+        return events ? events->deliver(m_handler, xsink) : 0;
+    }
+
+    //! Adds the number of times a statement has been reprepared to the total before it is finalized
+    DLLLOCAL void addReprepares(sqlite3_stmt* stmt);
+
+    /*! \brief Runs the warm-up configured with the "warmup-sql" and "warmup-tables" options, if any.
+
+        Called when the connection has been opened and its connection options have been set; the options run a
+        warm-up when they are set afterwards.
+
+        \retval int 0 on success, -1 on error
+    */
+    DLLLOCAL int warmUp(ExceptionSink* xsink);
+
+    /*! \brief Sets a driver option.
+
+        \param opt the option name
+        \param val the option value
+        \param xsink exception handler
+
+        \retval int 0 on success, -1 on error
+    */
+    DLLLOCAL int setOption(const char* opt, const QoreValue val, ExceptionSink* xsink);
+
+    /*! \brief Returns the value of a driver option.
+
+        \param opt the option name
+        \param xsink exception handler
+
+        \retval QoreValue the option value
+    */
+    DLLLOCAL QoreValue getOption(const char* opt, ExceptionSink* xsink);
+
 private:
     //! The current sqlite3 connection.
     sqlite3* m_handler;
 
     //! The character encoding touse for string data
     const QoreEncoding* enc;
+
+    //! The size above which TEXT and BLOB values are returned as handles in row results; 0 = never
+    int64 lob_threshold = 0;
+
+    //! The SQLITE_PREPARE_* flags for statements prepared on this connection
+    unsigned prepare_flags = 0;
+
+    //! True if SQL is passed to SQLite unparsed and arguments are bound to SQLite's own parameters
+    bool native_binding = false;
+
+    //! True if absolute dates are bound as integer microseconds since the epoch
+    bool epoch_dates = false;
+
+    //! True if DATE, NUMBER and BOOLEAN columns are returned as dates, numbers and booleans
+    bool type_mapping = false;
+
+    //! True if JSON objects and arrays in JSON columns are returned as hashes and lists
+    bool json_columns = false;
+
+    //! The size from which qore_compress() compresses values on this connection; 0 = any size
+    int64 compression = 0;
+
+    //! Read-only SQL statements executed by a warm-up
+    std::vector<std::string> warmup_sql;
+
+    //! Tables and indexes read into the page cache by a warm-up
+    std::vector<std::string> warmup_tables;
+
+    //! The results of the last warm-up
+    QoreSqlite3WarmUpResult warmup_result;
+
+    //! True once the connection has been opened, after which setting a warm-up option runs a warm-up
+    bool opened = false;
+
+    //! Sets the list of a warm-up option from a string or a list of strings
+    DLLLOCAL int setWarmUpList(const char* opt, const QoreValue val, std::vector<std::string>& list,
+        ExceptionSink* xsink);
+
+    //! The number of times finalized SQLStatements were reprepared after schema changes
+    int64 reprepares = 0;
+
+    //! Returns the number of times SQLStatements on this connection have been reprepared
+    DLLLOCAL int64 getReprepares();
+
+    //! The cache of prepared statements; disabled if its maximum size is 0
+    QoreSqlite3StatementCache stmt_cache{QORE_SQLITE3_STATEMENT_CACHE_SIZE};
+
+    //! The cache of read query results, if enabled with the "result-cache" option
+    QoreSqlite3ResultCache* result_cache = nullptr;
+
+    //! Enables, resizes or disables the result cache
+    DLLLOCAL int setResultCache(const QoreValue val, ExceptionSink* xsink);
+
+    //! Removes the result cache and its hooks
+    DLLLOCAL void deleteResultCache(ExceptionSink* xsink);
+
+    //! The changes to be delivered to the callback set with the "change-events" option, if any
+    QoreSqlite3ChangeEvents* events = nullptr;
+
+    //! True if change events include the old and new column values
+    bool change_values = false;
+
+    //! True if the preupdate hook is installed
+    bool preupdate_hook = false;
+
+    //! The number of changes recorded before each savepoint in savepoints
+    std::vector<size_t> savepoint_changes;
+
+    //! Sets or removes the change event callback
+    DLLLOCAL int setChangeEvents(const QoreValue val, ExceptionSink* xsink);
+
+    //! Enables or disables column values in change events
+    DLLLOCAL int setChangeValues(bool val, ExceptionSink* xsink);
+
+    //! Releases the change event callback and any undelivered changes
+    DLLLOCAL void deleteChangeEvents(ExceptionSink* xsink);
+
+    //! Installs or removes the update, commit, rollback and preupdate hooks as needed by the cache and events
+    DLLLOCAL void setHooks();
+
+    //! Returns the data version of the main database
+    DLLLOCAL QoreValue getDataVersion(ExceptionSink* xsink);
+
+    DLLLOCAL static void updateHook(void* arg, int op, const char* dbname, const char* table, sqlite3_int64 rowid);
+    DLLLOCAL static int commitHook(void* arg);
+    DLLLOCAL static void rollbackHook(void* arg);
+    DLLLOCAL static void preupdateHook(void* arg, sqlite3* db, int op, const char* dbname, const char* table,
+        sqlite3_int64 old_rowid, sqlite3_int64 new_rowid);
+
+    //! The background worker for this connection's database, if background checkpoints or maintenance are enabled
+    QoreSqlite3BackgroundWorker* bg = nullptr;
+
+    //! True if WAL checkpoints have been handed over to the background worker
+    bool checkpoint = false;
+
+    //! The checkpoint policy requested with options on this connection
+    QoreSqlite3CheckpointPolicy checkpoint_policy;
+
+    //! The maintenance policy requested with options on this connection
+    QoreSqlite3MaintenancePolicy maintenance_policy;
+
+    //! Acquires, updates or releases the background worker according to the current options
+    DLLLOCAL int updateBackground(bool new_checkpoint, ExceptionSink* xsink);
+
+    //! The snapshot captured in the current transaction, released when the transaction ends
+    QoreSqlite3Snapshot* snapshot = nullptr;
+
+    //! The snapshot to open at the start of the next transaction
+    QoreSqlite3Snapshot* pending_snapshot = nullptr;
+
+    /*! \brief The qore_snapshot() SQL function: returns the handle of a snapshot of the current transaction,
+        capturing it if necessary; errors are raised as SQL errors of the calling statement
+    */
+    DLLLOCAL static void snapshotFunc(sqlite3_context* ctx, int argc, sqlite3_value** argv);
+
+    /*! \brief The qore_changeset() and qore_patchset() SQL functions: return the changes recorded by the session
+        since it was started or the changes were last taken and restart the recording; NULL if there is no session
+    */
+    DLLLOCAL static void changesetFunc(sqlite3_context* ctx, int argc, sqlite3_value** argv);
+    DLLLOCAL static void patchsetFunc(sqlite3_context* ctx, int argc, sqlite3_value** argv);
+
+    //! Returns the changes recorded by the session as the result of an SQL function
+    DLLLOCAL static void takeChanges(sqlite3_context* ctx, bool patchset);
+
+    //! Sets the snapshot for the current transaction if one is open, otherwise for the next transaction
+    DLLLOCAL int setSnapshot(const QoreValue val, ExceptionSink* xsink);
+
+    //! Releases the snapshot captured in the current transaction and forgets its savepoints
+    DLLLOCAL void endTransaction();
+
+    //! The names of the savepoints of the current transaction, innermost last
+    std::vector<std::string> savepoints;
+
+    //! Sets a savepoint with the given name, or a generated name if no name is given
+    DLLLOCAL int setSavepoint(const QoreValue val, ExceptionSink* xsink);
+
+    //! Releases or rolls back to the named savepoint, or to the innermost savepoint if no name is given
+    DLLLOCAL int endSavepoint(const char* opt, const QoreValue val, bool rollback, ExceptionSink* xsink);
+
+    //! The session recording changes on this connection, if any
+    QoreSqlite3Session* session = nullptr;
+
+    //! The conflict handler for applying changesets, if any
+    ResolvedCallReferenceNode* conflict_handler = nullptr;
+
+    //! The action for conflicts when applying changesets without a conflict handler
+    QoreSqlite3ConflictAction conflict_action = SQLITE3_CONFLICT_ABORT;
+
+    //! Starts, restarts or stops recording changes
+    DLLLOCAL int setSession(const QoreValue val, ExceptionSink* xsink);
+
+    //! Sets the conflict action or handler for applying changesets
+    DLLLOCAL int setConflict(const QoreValue val, ExceptionSink* xsink);
+
+    //! Applies a changeset or patchset to this connection
+    DLLLOCAL int applyChangeset(const QoreValue val, ExceptionSink* xsink);
+
+    //! Releases the session and the conflict handler
+    DLLLOCAL void clearSession();
+
+    //! The schema names of the databases attached with the "attach" option
+    std::vector<std::string> attached;
+
+    //! Detaches the databases attached with the "attach" option and attaches the given databases
+    DLLLOCAL int setAttach(const QoreValue val, ExceptionSink* xsink);
+
+    //! Detaches the databases attached with the "attach" option
+    DLLLOCAL int detachAll(ExceptionSink* xsink);
+
+    //! Returns the databases attached with the "attach" option as a hash of schema names to file names
+    DLLLOCAL QoreHashNode* getAttached(ExceptionSink* xsink);
 };
 
 #endif
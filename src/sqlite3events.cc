@@ -0,0 +1,227 @@
+/*
+    sqlite3events.cc
+
+    Qore Programming Language
+
+    Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "sqlite3events.h"
+#include "sqlite3module.h"
+#include "config.h"
+
+#include <string.h>
+
+#include <map>
+#include <utility>
+
+static const char* get_op_name(int op) {
+    switch (op) {
+        case SQLITE_INSERT:
+            return "insert";
+        case SQLITE_UPDATE:
+            return "update";
+        default:
+            break;
+    }
+    return "delete";
+}
+
+static QoreValue get_value(sqlite3_value* v) {
+    switch (sqlite3_value_type(v)) {
+        case SQLITE_INTEGER:
+            return sqlite3_value_int64(v);
+        case SQLITE_FLOAT:
+            return sqlite3_value_double(v);
+        case SQLITE_BLOB: {
+            BinaryNode* b = new BinaryNode;
+            int len = sqlite3_value_bytes(v);
+            if (len) {
+                b->append(sqlite3_value_blob(v), len);
+            }
+            return b;
+        }
+        case SQLITE_NULL:
+            return null();
+        default:
+            break;
+    }
+    const char* text = (const char*)sqlite3_value_text(v);
+    return new QoreStringNode(text, sqlite3_value_bytes(v), QCS_UTF8);
+}
+
+// returns the column names of a table in the order used by the preupdate hook
+static std::vector<std::string> get_column_names(sqlite3* db, const std::string& dbname, const std::string& table) {
+    std::vector<std::string> names;
+    std::string sql = "pragma " + qore_sqlite3_quote_identifier(dbname) + ".table_info("
+        + qore_sqlite3_quote_identifier(table) + ")";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            names.push_back((const char*)sqlite3_column_text(stmt, 1));
+        }
+        sqlite3_finalize(stmt);
+    }
+    return names;
+}
+
+static QoreHashNode* get_row(const std::vector<sqlite3_value*>& values, const std::vector<std::string>& names,
+        ExceptionSink* xsink) {
+    ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+    for (size_t i = 0; i < values.size(); ++i) {
+        // columns added after the change have no name
+        std::string name = i < names.size() ? names[i] : std::to_string(i);
+        h->setKeyValue(name.c_str(), get_value(values[i]), xsink);
+    }
+    return h.release();
+}
+
+QoreSqlite3ChangeEvents::~QoreSqlite3ChangeEvents() {
+    assert(!callback);
+    clearChanges(pending);
+    clearChanges(committed);
+}
+
+void QoreSqlite3ChangeEvents::release(ExceptionSink* xsink) {
+    if (callback) {
+        callback->deref(xsink);
+        callback = nullptr;
+    }
+}
+
+void QoreSqlite3ChangeEvents::setCallback(ResolvedCallReferenceNode* new_callback, ExceptionSink* xsink) {
+    release(xsink);
+    callback = new_callback;
+}
+
+void QoreSqlite3ChangeEvents::rowChanged(int op, const char* dbname, const char* table, int64 rowid) {
+    pending.push_back(Change{op, dbname, table, rowid, std::vector<sqlite3_value*>(),
+        std::vector<sqlite3_value*>()});
+}
+
+#ifdef HAVE_SQLITE3_PREUPDATE_HOOK
+void QoreSqlite3ChangeEvents::rowChanging(sqlite3* db, int op, const char* dbname, const char* table,
+        int64 old_rowid, int64 new_rowid) {
+    // internal tables such as sqlite_sequence are not reported by the update hook either
+    if (!strncmp(table, "sqlite_", 7)) {
+        return;
+    }
+    pending.push_back(Change{op, dbname, table, op == SQLITE_DELETE ? old_rowid : new_rowid,
+        std::vector<sqlite3_value*>(), std::vector<sqlite3_value*>()});
+    Change& c = pending.back();
+    int n = sqlite3_preupdate_count(db);
+    sqlite3_value* v;
+    if (op != SQLITE_INSERT) {
+        c.old_values.reserve(n);
+        for (int i = 0; i < n; ++i) {
+            c.old_values.push_back(sqlite3_preupdate_old(db, i, &v) == SQLITE_OK ? sqlite3_value_dup(v) : nullptr);
+        }
+    }
+    if (op != SQLITE_DELETE) {
+        c.new_values.reserve(n);
+        for (int i = 0; i < n; ++i) {
+            c.new_values.push_back(sqlite3_preupdate_new(db, i, &v) == SQLITE_OK ? sqlite3_value_dup(v) : nullptr);
+        }
+    }
+}
+#endif
+
+void QoreSqlite3ChangeEvents::discardPending(size_t count) {
+    if (count >= pending.size()) {
+        return;
+    }
+    std::vector<Change> discarded(pending.begin() + count, pending.end());
+    pending.resize(count);
+    clearChanges(discarded);
+}
+
+void QoreSqlite3ChangeEvents::committing() {
+    if (committed.empty()) {
+        committed.swap(pending);
+    } else {
+        committed.insert(committed.end(), pending.begin(), pending.end());
+        pending.clear();
+    }
+}
+
+void QoreSqlite3ChangeEvents::rolledBack() {
+    clearChanges(pending);
+    clearChanges(committed);
+}
+
+int QoreSqlite3ChangeEvents::deliver(sqlite3* db, ExceptionSink* xsink) {
+    if (committed.empty()) {
+        return 0;
+    }
+    // a failed commit can leave the transaction open, in which case its changes are delivered when it ends
+    if (!sqlite3_get_autocommit(db)) {
+        committed.insert(committed.end(), pending.begin(), pending.end());
+        pending.swap(committed);
+        committed.clear();
+        return 0;
+    }
+
+    ReferenceHolder<QoreListNode> args(new QoreListNode(autoTypeInfo), xsink);
+    args->push(getChanges(db, committed, xsink), xsink);
+    clearChanges(committed);
+    if (!callback) {
+        return 0;
+    }
+    ValueHolder rv(callback->execValue(*args, xsink), xsink);
+    return *xsink ? -1 : 0;
+}
+
+void QoreSqlite3ChangeEvents::clearChanges(std::vector<Change>& changes) {
+    for (Change& c : changes) {
+        for (sqlite3_value* v : c.old_values) {
+            sqlite3_value_free(v);
+        }
+        for (sqlite3_value* v : c.new_values) {
+            sqlite3_value_free(v);
+        }
+    }
+    changes.clear();
+}
+
+QoreListNode* QoreSqlite3ChangeEvents::getChanges(sqlite3* db, const std::vector<Change>& changes,
+        ExceptionSink* xsink) {
+    ReferenceHolder<QoreListNode> l(new QoreListNode(autoHashTypeInfo), xsink);
+    // column names are looked up once per table
+    std::map<std::pair<std::string, std::string>, std::vector<std::string>> columns;
+    for (const Change& c : changes) {
+        ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+        h->setKeyValue("op", new QoreStringNode(get_op_name(c.op)), xsink);
+        h->setKeyValue("database", new QoreStringNode(c.dbname.c_str(), QCS_UTF8), xsink);
+        h->setKeyValue("table", new QoreStringNode(c.table.c_str(), QCS_UTF8), xsink);
+        h->setKeyValue("rowid", c.rowid, xsink);
+        if (!c.old_values.empty() || !c.new_values.empty()) {
+            std::pair<std::string, std::string> key(c.dbname, c.table);
+            auto i = columns.find(key);
+            if (i == columns.end()) {
+                i = columns.insert(std::make_pair(key, get_column_names(db, c.dbname, c.table))).first;
+            }
+            if (!c.old_values.empty()) {
+                h->setKeyValue("old", get_row(c.old_values, i->second, xsink), xsink);
+            }
+            if (!c.new_values.empty()) {
+                h->setKeyValue("new", get_row(c.new_values, i->second, xsink), xsink);
+            }
+        }
+        l->push(h.release(), xsink);
+    }
+    return l.release();
+}
@@ -0,0 +1,114 @@
+/*
+  sqlite3events.h
+
+  Qore Programming Language
+
+  Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SQLITE3EVENTS_H
+#define SQLITE3EVENTS_H
+
+#include <sqlite3.h>
+#include <qore/Qore.h>
+
+#include <string>
+#include <vector>
+
+/*! \brief Collects the rows changed on a connection and delivers them to a Qore callback per transaction.
+
+    The update hook, or the preupdate hook if column values are requested, only records the changes in C++
+    structures; column values are copied with sqlite3_value_dup().  Changes are moved to the committed list by the
+    commit hook and discarded by the rollback hook, and are converted to Qore values and passed to the callback by
+    deliver(), which is called after the DBI call that committed them has returned, outside of any SQLite callback.
+*/
+class QoreSqlite3ChangeEvents {
+public:
+    //! Creates the object with the given callback, which must be referenced for the object
+    DLLLOCAL QoreSqlite3ChangeEvents(ResolvedCallReferenceNode* callback) : callback(callback) {
+    }
+
+    //! Frees any undelivered changes; the callback must have been released with release()
+    DLLLOCAL ~QoreSqlite3ChangeEvents();
+
+    //! Releases the callback
+    DLLLOCAL void release(ExceptionSink* xsink);
+
+    //! Returns a new reference to the callback
+    DLLLOCAL QoreValue getCallback() const {
+        return callback ? callback->refSelf() : QoreValue();
+    }
+
+    //! Replaces the callback, which must be referenced for the object
+    DLLLOCAL void setCallback(ResolvedCallReferenceNode* new_callback, ExceptionSink* xsink);
+
+    //! Called from the update hook when a row is changed
+    DLLLOCAL void rowChanged(int op, const char* dbname, const char* table, int64 rowid);
+
+    //! Called from the preupdate hook before a row is changed; records the row with its old and new values
+    DLLLOCAL void rowChanging(sqlite3* db, int op, const char* dbname, const char* table, int64 old_rowid,
+        int64 new_rowid);
+
+    //! Returns the number of changes recorded in the current transaction
+    DLLLOCAL size_t getPendingCount() const {
+        return pending.size();
+    }
+
+    //! Discards the changes recorded after the first \a count changes, when they are rolled back to a savepoint
+    DLLLOCAL void discardPending(size_t count);
+
+    //! Called from the commit hook before a transaction is committed
+    DLLLOCAL void committing();
+
+    //! Called from the rollback hook when a transaction is rolled back
+    DLLLOCAL void rolledBack();
+
+    /*! \brief Passes the changes of the committed transaction, if any, to the callback.
+
+        If the commit failed and the transaction is still open, the changes are kept for the next commit.
+
+        \retval int 0 on success, -1 if the callback raised an exception
+    */
+    DLLLOCAL int deliver(sqlite3* db, ExceptionSink* xsink);
+
+private:
+    struct Change {
+        int op;
+        std::string dbname;
+        std::string table;
+        int64 rowid;
+        //! The old and new column values, if recorded by the preupdate hook
+        std::vector<sqlite3_value*> old_values;
+        std::vector<sqlite3_value*> new_values;
+    };
+
+    ResolvedCallReferenceNode* callback;
+
+    //! The changes of the current transaction
+    std::vector<Change> pending;
+    //! The changes of the transaction being committed
+    std::vector<Change> committed;
+
+    //! Frees the values of the given changes and clears the list
+    DLLLOCAL static void clearChanges(std::vector<Change>& changes);
+
+    //! Returns the changes as a list of hashes
+    DLLLOCAL static QoreListNode* getChanges(sqlite3* db, const std::vector<Change>& changes,
+        ExceptionSink* xsink);
+};
+
+#endif
@@ -20,7 +20,20 @@
     Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
+#include "config.h"
+
 #include "sqlite3executor.h"
+#include "sqlite3compress.h"
+#include "sqlite3json.h"
+#include "sqlite3module.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <algorithm>
+#include <unordered_set>
 
 int QoreSqlite3ExecBase::parseForBind(QoreString& str, const QoreListNode* args, ExceptionSink* xsink) {
     char quote = 0;
@@ -96,83 +109,150 @@ int QoreSqlite3ExecBase::parseForBind(QoreString& str, const QoreListNode* args,
 }
 
 int QoreSqlite3ExecBase::bindParameters(sqlite3_stmt* stmt, ExceptionSink* xsink) {
-    qore_type_t argType;
-    QoreValue arg;
-
-    for (int i = 0; i < sqlite3_bind_parameter_count(stmt); ++i)     {
-        arg = m_realArgs->retrieveEntry(i);
-        argType = arg.getType();
-
-        switch (argType) {
-            case NT_NOTHING:
-            case NT_NULL:
-                if (SQLITE_OK != sqlite3_bind_null(stmt, i+1)) {
-                    xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Failed to bind NULL");
-                    return -1;
-                }
-                break;
-            case NT_INT:
-                if (SQLITE_OK != sqlite3_bind_int64(stmt, i+1, arg.getAsBigInt())) {
-                    xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Failed to bind integer");
-                    return -1;
-                }
-                break;
-            case NT_FLOAT:
-                if (SQLITE_OK != sqlite3_bind_double(stmt, i+1, arg.getAsFloat())) {
-                    xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Failed to bind double/float");
-                    return -1;
-                }
-                break;
-            case NT_STRING: {
-                const QoreStringNode* s = arg.get<const QoreStringNode>();
-                if (SQLITE_OK != sqlite3_bind_text(stmt, i+1, s->c_str(), s->strlen(), SQLITE_TRANSIENT)) {
-                    xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Failed to bind string");
-                    return -1;
-                }
-                break;
+    for (int i = 0; i < sqlite3_bind_parameter_count(stmt); ++i) {
+        if (bindValue(stmt, i + 1, m_realArgs->retrieveEntry(i), xsink, epoch_dates)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int QoreSqlite3ExecBase::bindNative(sqlite3_stmt* stmt, const QoreListNode* args, ExceptionSink* xsink,
+        bool epoch_dates) {
+    int count = sqlite3_bind_parameter_count(stmt);
+    const QoreHashNode* h = args && args->size() == 1 && args->retrieveEntry(0).getType() == NT_HASH
+        ? args->retrieveEntry(0).get<const QoreHashNode>()
+        : nullptr;
+    if (!h) {
+        // values are bound by position; ?NNN parameters take the value at position NNN
+        for (int i = 1; i <= count; ++i) {
+            if (bindValue(stmt, i, args ? args->retrieveEntry(i - 1) : QoreValue(), xsink, epoch_dates)) {
+                return -1;
             }
-            case NT_BOOLEAN:
-                if (SQLITE_OK != sqlite3_bind_int64(stmt, i+1, arg.getAsBool())) {
-                    xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Failed to bind bool");
-                    return -1;
-                }
-                break;
-            case NT_DATE: {
-                const DateTimeNode* d = arg.get<const DateTimeNode>();
-                QoreString str;
-                d->format(str, "IF");
-                if (SQLITE_OK != sqlite3_bind_text(stmt, i+1, str.c_str(), str.strlen(), SQLITE_TRANSIENT)) {
-                    xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Failed to bind date '%s' as string",
-                        str.c_str());
-                    return -1;
-                }
-                break;
+        }
+        return 0;
+    }
+
+    for (int i = 1; i <= count; ++i) {
+        const char* name = sqlite3_bind_parameter_name(stmt, i);
+        if (!name || *name == '?') {
+            xsink->raiseException("SQLITE3-BIND-EXCEPTION", "parameter %d has no name and cannot be bound from a "
+                "hash", i);
+            return -1;
+        }
+        // the key may be given with or without the ':', '@' or '$' prefix
+        bool exists;
+        QoreValue v = h->getKeyValue(name + 1, exists);
+        if (!exists) {
+            v = h->getKeyValue(name, exists);
+            if (!exists) {
+                xsink->raiseException("SQLITE3-BIND-EXCEPTION", "no value given for parameter '%s'", name);
+                return -1;
             }
-            case NT_NUMBER: {
-                const QoreNumberNode* n = arg.get<const QoreNumberNode>();
-                QoreString str;
-                n->toString(str);
-                if (SQLITE_OK != sqlite3_bind_text(stmt, i+1, str.c_str(), str.strlen(), SQLITE_TRANSIENT)) {
-                    xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Failed to bind number '%s' as string",
-                        str.c_str());
-                    return -1;
-                }
-                break;
+        }
+        if (bindValue(stmt, i, v, xsink, epoch_dates)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int QoreSqlite3ExecBase::bindValue(sqlite3_stmt* stmt, int i, const QoreValue arg, ExceptionSink* xsink,
+        bool epoch_dates) {
+    switch (arg.getType()) {
+        case NT_NOTHING:
+        case NT_NULL:
+            if (SQLITE_OK != sqlite3_bind_null(stmt, i)) {
+                xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Failed to bind NULL");
+                return -1;
+            }
+            break;
+        case NT_INT:
+            if (SQLITE_OK != sqlite3_bind_int64(stmt, i, arg.getAsBigInt())) {
+                xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Failed to bind integer");
+                return -1;
+            }
+            break;
+        case NT_FLOAT:
+            if (SQLITE_OK != sqlite3_bind_double(stmt, i, arg.getAsFloat())) {
+                xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Failed to bind double/float");
+                return -1;
+            }
+            break;
+        case NT_STRING: {
+            // strings are only converted if they are not already in UTF-8
+            TempEncodingHelper s(arg.get<const QoreStringNode>(), QCS_UTF8, xsink);
+            if (*xsink) {
+                return -1;
+            }
+            if (SQLITE_OK != sqlite3_bind_text(stmt, i, s->c_str(), s->size(), SQLITE_TRANSIENT)) {
+                xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Failed to bind string");
+                return -1;
+            }
+            break;
+        }
+        case NT_BOOLEAN:
+            if (SQLITE_OK != sqlite3_bind_int64(stmt, i, arg.getAsBool())) {
+                xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Failed to bind bool");
+                return -1;
             }
-            case NT_BINARY: {
-                const BinaryNode* b = arg.get<const BinaryNode>();
-                if (SQLITE_OK != sqlite3_bind_blob(stmt, i+1, b->getPtr(), b->size(), nullptr)) {
-                    xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Failed to bind BLOB");
+            break;
+        case NT_DATE: {
+            const DateTimeNode* d = arg.get<const DateTimeNode>();
+            if (epoch_dates && !d->isRelative()) {
+                if (SQLITE_OK != sqlite3_bind_int64(stmt, i, d->getEpochMicrosecondsUTC())) {
+                    xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Failed to bind date as integer");
                     return -1;
                 }
                 break;
             }
-            default:
-                xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Cannot bind unsupported type '%s'",
-                    arg.getTypeName());
+            QoreString str;
+            d->format(str, "IF");
+            if (SQLITE_OK != sqlite3_bind_text(stmt, i, str.c_str(), str.strlen(), SQLITE_TRANSIENT)) {
+                xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Failed to bind date '%s' as string",
+                    str.c_str());
+                return -1;
+            }
+            break;
+        }
+        case NT_NUMBER: {
+            const QoreNumberNode* n = arg.get<const QoreNumberNode>();
+            QoreString str;
+            n->toString(str);
+            if (SQLITE_OK != sqlite3_bind_text(stmt, i, str.c_str(), str.strlen(), SQLITE_TRANSIENT)) {
+                xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Failed to bind number '%s' as string",
+                    str.c_str());
                 return -1;
-        } // switch
-    } // for
+            }
+            break;
+        }
+        case NT_BINARY: {
+            const BinaryNode* b = arg.get<const BinaryNode>();
+            if (SQLITE_OK != sqlite3_bind_blob(stmt, i, b->getPtr(), b->size(), nullptr)) {
+                xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Failed to bind BLOB");
+                return -1;
+            }
+            break;
+        }
+        case NT_HASH:
+        case NT_LIST: {
+            // the JSON text is serialized into a buffer that is handed over to SQLite without being copied
+            QoreString str;
+            if (QoreSqlite3Json::serialize(str, arg, xsink)) {
+                return -1;
+            }
+            size_t len = str.size();
+            if (SQLITE_OK != sqlite3_bind_text(stmt, i, str.giveBuffer(), len, free)) {
+                xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Failed to bind %s as JSON", arg.getTypeName());
+                return -1;
+            }
+            break;
+        }
+        default:
+            xsink->raiseException("SQLITE3-BIND-EXCEPTION", "Cannot bind unsupported type '%s'",
+                arg.getTypeName());
+            return -1;
+    }
     return 0;
 }
 
@@ -181,16 +261,18 @@ QoreValue QoreSqlite3ExecBase::columnValue(sqlite3_stmt * stmt, int index) {
 
     switch (columnType) {
         case SQLITE_INTEGER:
-            return sqlite3_column_int(stmt, index);
+            return (int64)sqlite3_column_int64(stmt, index);
 
         case SQLITE_FLOAT:
             return sqlite3_column_double(stmt, index);
 
         case SQLITE_BLOB: {
+            BinaryNode* b = new BinaryNode;
             int nBlob = sqlite3_column_bytes(stmt, index);
-            unsigned char *zBlob = (unsigned char *)malloc(nBlob);
-            memcpy(zBlob, sqlite3_column_blob(stmt, index), nBlob);
-            return new BinaryNode(zBlob, nBlob);
+            if (nBlob) {
+                b->append(sqlite3_column_blob(stmt, index), nBlob);
+            }
+            return b;
         }
 
         case SQLITE_NULL:
@@ -201,7 +283,278 @@ QoreValue QoreSqlite3ExecBase::columnValue(sqlite3_stmt * stmt, int index) {
             break;
     };
 
-    return new QoreStringNode((const char*)sqlite3_column_text(stmt, index));
+    // the length is known, so the string is not rescanned and may contain embedded NULs; sqlite3 returns text in
+    // UTF-8, which is also the encoding of all connections
+    const char* text = (const char*)sqlite3_column_text(stmt, index);
+    return new QoreStringNode(text, sqlite3_column_bytes(stmt, index), QCS_UTF8);
+}
+
+qore_type_t QoreSqlite3ExecBase::getConvertedType(const char* decl, unsigned conversions) {
+    if (!decl) {
+        return 0;
+    }
+    std::string type(decl);
+    for (char& c : type) {
+        c = toupper(c);
+    }
+    // compressed values are stored as BLOBs and returned as strings or binary values; NT_BINARY marks them
+    if (type.find("COMPRESS") != std::string::npos) {
+        return NT_BINARY;
+    }
+    // JSON objects and arrays are parsed with the "json-columns" option; NT_HASH marks them
+    if (type.find("JSON") != std::string::npos) {
+        return (conversions & QORE_SQLITE3_CONV_JSON) ? NT_HASH : 0;
+    }
+    // other types are only converted with the "type-mapping" option
+    if (!(conversions & QORE_SQLITE3_CONV_TYPES)) {
+        return 0;
+    }
+    if (type.find("BOOL") != std::string::npos) {
+        return NT_BOOLEAN;
+    }
+    if (type.find("DATE") != std::string::npos || type.find("TIMESTAMP") != std::string::npos) {
+        return NT_DATE;
+    }
+    if (type.find("NUMBER") != std::string::npos || type.find("NUMERIC") != std::string::npos
+        || type.find("DECIMAL") != std::string::npos) {
+        return NT_NUMBER;
+    }
+    return 0;
+}
+
+// returns true if the text is a decimal number that QoreNumberNode can parse
+static bool is_number(const char* text) {
+    char* end;
+    strtod(text, &end);
+    return end != text && !*end;
+}
+
+// skips the given number of digits; returns false if the text has fewer digits at the current position
+static bool skip_digits(const char*& p, int n) {
+    for (int i = 0; i < n; ++i, ++p) {
+        if (!isdigit((unsigned char)*p)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// returns true if the text is a date as written by the driver or SQLite's date and time functions:
+// YYYY-MM-DD, optionally followed by HH:MM[:SS[.fraction]] and a time zone designator Z or +/-HH[:MM]
+static bool is_date(const char* text) {
+    const char* p = text;
+    if (!skip_digits(p, 4) || *p++ != '-' || !skip_digits(p, 2) || *p++ != '-' || !skip_digits(p, 2)) {
+        return false;
+    }
+    if (!*p) {
+        return true;
+    }
+    if (*p != 'T' && *p != ' ') {
+        return false;
+    }
+    ++p;
+    if (!skip_digits(p, 2) || *p++ != ':' || !skip_digits(p, 2)) {
+        return false;
+    }
+    if (*p == ':') {
+        ++p;
+        if (!skip_digits(p, 2)) {
+            return false;
+        }
+        if (*p == '.') {
+            ++p;
+            if (!skip_digits(p, 1)) {
+                return false;
+            }
+            while (isdigit((unsigned char)*p)) {
+                ++p;
+            }
+        }
+    }
+    if (*p == ' ' && (p[1] == 'Z' || p[1] == '+' || p[1] == '-')) {
+        ++p;
+    }
+    if (*p == 'Z') {
+        ++p;
+    } else if (*p == '+' || *p == '-') {
+        ++p;
+        if (!skip_digits(p, 2)) {
+            return false;
+        }
+        if (*p == ':') {
+            ++p;
+        }
+        if (*p && !skip_digits(p, 2)) {
+            return false;
+        }
+    }
+    return !*p;
+}
+
+QoreValue QoreSqlite3ExecBase::convertedColumnValue(sqlite3_stmt* stmt, int index, qore_type_t type,
+        unsigned conversions) {
+    int column_type = sqlite3_column_type(stmt, index);
+    switch (type) {
+        case NT_DATE:
+            // integers are microseconds since the epoch as bound with the "epoch-dates" option; without it, they
+            // are returned as stored
+            if (column_type == SQLITE_INTEGER && (conversions & QORE_SQLITE3_CONV_EPOCH)) {
+                int64 us = sqlite3_column_int64(stmt, index);
+                int64 secs = us / 1000000;
+                int rem = (int)(us % 1000000);
+                if (rem < 0) {
+                    --secs;
+                    rem += 1000000;
+                }
+                return DateTimeNode::makeAbsolute(currentTZ(), secs, rem);
+            }
+            if (column_type == SQLITE_TEXT) {
+                const char* text = (const char*)sqlite3_column_text(stmt, index);
+                if (is_date(text)) {
+                    return new DateTimeNode(text);
+                }
+            }
+            break;
+
+        case NT_NUMBER:
+            // the text of a float only has 15 significant digits, so the stored value is used
+            if (column_type == SQLITE_INTEGER) {
+                return new QoreNumberNode(std::to_string((long long)sqlite3_column_int64(stmt, index)).c_str());
+            }
+            if (column_type == SQLITE_FLOAT) {
+                return new QoreNumberNode(sqlite3_column_double(stmt, index));
+            }
+            if (column_type == SQLITE_TEXT) {
+                const char* text = (const char*)sqlite3_column_text(stmt, index);
+                if (is_number(text)) {
+                    return new QoreNumberNode(text);
+                }
+            }
+            break;
+
+        case NT_BOOLEAN:
+            if (column_type == SQLITE_INTEGER || column_type == SQLITE_FLOAT) {
+                return sqlite3_column_double(stmt, index) != 0;
+            }
+            if (column_type == SQLITE_TEXT) {
+                const char* text = (const char*)sqlite3_column_text(stmt, index);
+                if (!strcasecmp(text, "true")) {
+                    return true;
+                }
+                if (!strcasecmp(text, "false")) {
+                    return false;
+                }
+            }
+            break;
+
+        case NT_BINARY:
+            if (column_type == SQLITE_BLOB) {
+                QoreValue rv = QoreSqlite3Compression::decompress(sqlite3_column_blob(stmt, index),
+                    sqlite3_column_bytes(stmt, index));
+                if (!rv.isNothing()) {
+                    return rv;
+                }
+            }
+            break;
+
+        case NT_HASH:
+            // only objects and arrays are parsed, directly from SQLite's buffer, so that scalar text such as
+            // "42" or "null" keeps its type
+            if (column_type == SQLITE_TEXT) {
+                const char* text = (const char*)sqlite3_column_text(stmt, index);
+                int len = sqlite3_column_bytes(stmt, index);
+                const char* p = text;
+                const char* end = text + len;
+                while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+                    ++p;
+                }
+                QoreValue rv;
+                if (p < end && (*p == '{' || *p == '[') && QoreSqlite3Json::parse(text, len, rv)) {
+                    return rv;
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+    return columnValue(stmt, index);
+}
+
+QoreSqlite3RowLayout::QoreSqlite3RowLayout(sqlite3* db, sqlite3_stmt* stmt, unsigned conversions,
+        int64 lob_threshold) : conversions(conversions) {
+    int n = sqlite3_column_count(stmt);
+    names.reserve(n);
+    bool convert = false;
+    for (int i = 0; i < n; ++i) {
+        names.push_back(sqlite3_column_name(stmt, i));
+        qore_type_t type = QoreSqlite3ExecBase::getConvertedType(sqlite3_column_decltype(stmt, i), conversions);
+        if (type) {
+            types.resize(n);
+            types[i] = type;
+            convert = true;
+        }
+    }
+    if (!convert) {
+        types.clear();
+    }
+    if (lob_threshold) {
+        lob_cols.reset(new QoreSqlite3LobColumns(db, stmt, lob_threshold));
+    }
+
+    // the keys are in the order of the first column with each name, as if they had been inserted column by column
+    ExceptionSink xsink;
+    row_template = new QoreHashNode(autoTypeInfo);
+    for (const auto& name : names) {
+        row_template->setKeyValue(name.c_str(), QoreValue(), &xsink);
+    }
+    // a later column with the same name replaces the value of an earlier one
+    std::unordered_set<std::string> seen;
+    for (int i = n - 1; i >= 0; --i) {
+        if (seen.insert(names[i]).second) {
+            row_columns.push_back(i);
+        }
+    }
+    std::reverse(row_columns.begin(), row_columns.end());
+}
+
+QoreSqlite3RowLayout::~QoreSqlite3RowLayout() {
+    // the template has no values, so releasing it cannot raise an exception
+    ExceptionSink xsink;
+    row_template->deref(&xsink);
+}
+
+QoreHashNode* QoreSqlite3RowLayout::getRow(sqlite3_stmt* stmt, ExceptionSink* xsink) const {
+    // the copy already has all keys, so each value is assigned to an existing key
+    QoreHashNode* h = row_template->copy();
+    for (int i : row_columns) {
+        h->getKeyValueReference(names[i].c_str()) = columnValue(stmt, i, xsink);
+    }
+    return h;
+}
+
+QoreHashNode* QoreSqlite3RowLayout::getColumns(ExceptionSink* xsink) {
+    QoreHashNode* h = new QoreHashNode(autoTypeInfo);
+    lists.clear();
+    lists.reserve(names.size());
+    for (const auto& name : names) {
+        QoreListNode* l = h->getKeyValue(name.c_str()).get<QoreListNode>();
+        if (!l) {
+            l = new QoreListNode(autoTypeInfo);
+            h->setKeyValue(name.c_str(), l, xsink);
+        }
+        lists.push_back(l);
+    }
+    return h;
+}
+
+void QoreSqlite3RowLayout::appendRow(sqlite3_stmt* stmt, ExceptionSink* xsink) const {
+    // rows of a hash of lists never contain handles
+    for (int i = 0, e = (int)lists.size(); i < e; ++i) {
+        lists[i]->push(!types.empty() && types[i]
+            ? QoreSqlite3ExecBase::convertedColumnValue(stmt, i, types[i], conversions)
+            : QoreSqlite3ExecBase::columnValue(stmt, i), xsink);
+    }
 }
 
 QoreSqlite3Executor::QoreSqlite3Executor(sqlite3* handler, const QoreEncoding* enc, ExceptionSink* xsink)
@@ -264,95 +617,148 @@ QoreValue QoreSqlite3Executor::select(
     return sqlite3_changes(m_handler);
 }
 
-QoreListNode* QoreSqlite3Executor::select_rows(
-    Datasource *ds,
-    const QoreString *qstr,
-    const QoreListNode *args,
-    ExceptionSink* xsink) {
-    TempEncodingHelper qstr0(qstr, enc, xsink);
-    if (*xsink) {
-        return nullptr;
+sqlite3_stmt* QoreSqlite3Executor::prepare(const QoreString* qstr, const QoreListNode* args, bool binding,
+        const char* calltype, ExceptionSink* xsink) {
+    sqlite3_stmt* stmt;
+    int rc;
+    // the statement can be prepared directly from the caller's string if it is already in the connection's encoding
+    // and has no bind markers or placeholders to be replaced, or SQLite's own parameters are used
+    if (qstr->getEncoding() == enc && (!binding || native_binding || !strchr(qstr->c_str(), '%'))) {
+        rc = prepareStatement(qstr->c_str(), qstr->size(), true, stmt);
+    } else {
+        TempEncodingHelper qstr0(qstr, enc, xsink);
+        if (*xsink) {
+            return nullptr;
+        }
+        size_t len = qstr0->strlen();
+        QoreString statement(qstr0.giveBuffer(), len, len + 1, enc);
+        if (binding && !native_binding && parseForBind(statement, args, xsink)) {
+            xsink->raiseException(calltype, "failed to parse bind variables");
+            return nullptr;
+        }
+        // SQL that has not been processed by the driver is passed to SQLite as it is
+        rc = prepareStatement(statement.c_str(), statement.size(), !binding || native_binding, stmt);
     }
-    size_t len = qstr0->strlen();
-    QoreString statement(qstr0.giveBuffer(), len, len + 1, enc);
-    if (parseForBind(statement, args, xsink)) {
-        xsink->raiseException("SQLITE3-SELECT-ROWS", "failed to parse bind variables");
+    if (rc != SQLITE_OK) {
+        cached = false;
+        xsink->raiseException(calltype, "sqlite3 error: %s", sqlite3_errmsg(m_handler));
         return nullptr;
     }
 
-    sqlite3_stmt *stmt;
-    int rc = sqlite3_prepare_v2(m_handler, statement.c_str(), -1, &stmt, 0);
-    if (rc != SQLITE_OK) {
-        xsink->raiseException("SQLITE3-SELECT-ROWS", "sqlite3 error: %s", sqlite3_errmsg(m_handler));
+    if (binding && native_binding) {
+        if (bindNative(stmt, args, xsink, epoch_dates)) {
+            release(stmt);
+            return nullptr;
+        }
+    } else if (binding && m_realArgs && bindParameters(stmt, xsink)) {
+        release(stmt);
+        xsink->raiseException(calltype, "failed to bind variables");
         return nullptr;
     }
-    ON_BLOCK_EXIT(sqlite3_finalize, stmt);
+    return stmt;
+}
+
+int QoreSqlite3Executor::prepareStatement(const char* sql, size_t len, bool cache, sqlite3_stmt*& stmt) {
+    if (!cache || !stmt_cache) {
+        return qore_sqlite3_prepare(m_handler, sql, len + 1, prepare_flags, &stmt);
+    }
+    // the statement has no arguments or only arguments bound to SQLite's own parameters, which are bound again on
+    // each call, so it can be reused from the statement cache
+    cache_key.assign(sql, len);
+    cached = true;
+    stmt = stmt_cache->take(cache_key);
+    return stmt ? SQLITE_OK : qore_sqlite3_prepare(m_handler, sql, len + 1, prepare_flags | SQLITE_PREPARE_PERSISTENT,
+        &stmt);
+}
+
+void QoreSqlite3Executor::release(sqlite3_stmt* stmt) {
+    if (cached && stmt) {
+        stmt_cache->put(cache_key, stmt);
+    } else {
+        sqlite3_finalize(stmt);
+    }
+    cached = false;
+}
 
-    if (bindParameters(stmt, xsink)) {
-        xsink->raiseException("SQLITE3-SELECT-ROWS", "failed to bind variables");
+QoreListNode* QoreSqlite3Executor::select_rows(
+    Datasource *ds,
+    const QoreString *qstr,
+    const QoreListNode *args,
+    ExceptionSink* xsink) {
+    sqlite3_stmt* stmt = prepare(qstr, args, true, "SQLITE3-SELECT-ROWS", xsink);
+    if (!stmt) {
         return nullptr;
     }
+    StatementHolder holder(*this, stmt);
 
     ReferenceHolder<QoreListNode> res(new QoreListNode(autoTypeInfo), xsink);
 
+    QoreSqlite3RowLayout layout(m_handler, stmt, conversions, lob_threshold);
     while (sqlite3_step(stmt) == SQLITE_ROW) {
-        QoreHashNode* head = new QoreHashNode(autoTypeInfo);
-
-        for (int i = 0; i < sqlite3_column_count(stmt); ++i) {
-            head->setKeyValue(sqlite3_column_name(stmt, i), columnValue(stmt, i), xsink);
-        }
-        res->push(head, xsink);
+        res->push(layout.getRow(stmt, xsink), xsink);
     }
 
     return res.release();
 }
 
-QoreHashNode* QoreSqlite3Executor::select_internal(
-            Datasource *ds,
-            const QoreString *qstr,
-            const QoreListNode *args,
-            bool binding,
-            const char * calltype,
-            ExceptionSink* xsink) {
-    TempEncodingHelper qstr0(qstr, enc, xsink);
-    if (*xsink) {
+QoreHashNode* QoreSqlite3Executor::select_row(
+    Datasource *ds,
+    const QoreString *qstr,
+    const QoreListNode *args,
+    ExceptionSink* xsink) {
+    sqlite3_stmt* stmt = prepare(qstr, args, true, "SQLITE3-SELECT-ROW", xsink);
+    if (!stmt) {
         return nullptr;
     }
-    size_t len = qstr0->strlen();
-    QoreString statement(qstr0.giveBuffer(), len, len + 1, enc);
-    if (binding) {
-        if (parseForBind(statement, args, xsink)) {
-            xsink->raiseException(calltype, "failed to parse bind variables");
-            return nullptr;
+    StatementHolder holder(*this, stmt);
+
+    int rc = sqlite3_step(stmt);
+    if (rc != SQLITE_ROW) {
+        if (rc != SQLITE_DONE) {
+            xsink->raiseException("SQLITE3-SELECT-ROW", "sqlite3 error: %s", sqlite3_errmsg(m_handler));
         }
+        return nullptr;
     }
 
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_handler, statement.c_str(), -1, &stmt, 0);
-    if (rc != SQLITE_OK) {
-        xsink->raiseException(calltype, "sqlite3 error: %s", sqlite3_errmsg(m_handler));
+    QoreSqlite3RowLayout layout(m_handler, stmt, conversions, lob_threshold);
+    ReferenceHolder<QoreHashNode> row(layout.getRow(stmt, xsink), xsink);
+    if (*xsink) {
         return nullptr;
     }
-    ON_BLOCK_EXIT(sqlite3_finalize, stmt);
 
-    if (binding && bindParameters(stmt, xsink)) {
-        xsink->raiseException(calltype, "failed to bind variables");
+    // only one more step is needed to tell whether the result has a second row; the rest is never read
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        xsink->raiseException("DBI-SELECT-ROW-ERROR", "SQL passed to selectRow() returned more than 1 row");
         return nullptr;
     }
+    if (rc != SQLITE_DONE) {
+        xsink->raiseException("SQLITE3-SELECT-ROW", "sqlite3 error: %s", sqlite3_errmsg(m_handler));
+        return nullptr;
+    }
+    return row.release();
+}
 
-    // columns as keys
-    ReferenceHolder<QoreHashNode> hash(new QoreHashNode(autoTypeInfo), xsink);
-
-    for (int i = 0; i < sqlite3_column_count(stmt); ++i) {
-        hash->setKeyValue(sqlite3_column_name(stmt, i), new QoreListNode(autoTypeInfo), xsink);
+QoreHashNode* QoreSqlite3Executor::select_internal(
+            Datasource *ds,
+            const QoreString *qstr,
+            const QoreListNode *args,
+            bool binding,
+            const char * calltype,
+            ExceptionSink* xsink) {
+    sqlite3_stmt* stmt = prepare(qstr, args, binding, calltype, xsink);
+    if (!stmt) {
+        return nullptr;
     }
+    StatementHolder holder(*this, stmt);
+
+    // columns as keys
+    QoreSqlite3RowLayout layout(m_handler, stmt, conversions);
+    ReferenceHolder<QoreHashNode> hash(layout.getColumns(xsink), xsink);
 
     // fetch the results
     while (sqlite3_step(stmt) == SQLITE_ROW) {
-        for (int i = 0; i < sqlite3_column_count(stmt); ++i) {
-            QoreListNode* node = hash->getKeyValue(sqlite3_column_name(stmt, i)).get<QoreListNode>();
-            node->push(columnValue(stmt, i), xsink);
-        }
+        layout.appendRow(stmt, xsink);
     }
 
     return hash.release();
@@ -372,24 +778,43 @@ int QoreSqlite3PreparedStatement::prepare(const QoreString& sql, const QoreListN
         assert(parse);
     }
 
-    if (parse && parseForBind(*this->sql, args, xsink)) {
+    epoch_dates = conn->getEpochDates();
+    // with native binding, the SQL is passed to SQLite unchanged and the arguments are bound directly
+    if (conn->getNativeBinding()) {
+        native_binding = true;
+    } else if (parse && parseForBind(*this->sql, args, xsink)) {
         xsink->raiseException("SQLITE3-PREPARE-ERROR", "failed to parse bind variables");
         return -1;
     }
 
     assert(!stmt);
-    int rc = sqlite3_prepare_v2(conn->handler(), this->sql->c_str(), -1, &stmt, 0);
+    // SQLStatement objects are long-lived, so their memory is not taken from the connection's lookaside allocator
+    int rc = qore_sqlite3_prepare(conn->handler(), this->sql->c_str(), this->sql->size() + 1,
+        conn->getPrepareFlags() | SQLITE_PREPARE_PERSISTENT, &stmt);
     if (rc != SQLITE_OK) {
         xsink->raiseException("SQLITE3-PREPARE-ERROR", "%s", sqlite3_errmsg(conn->handler()));
         return -1;
     }
 
-    return 0;
+    return native_binding && args ? bindNativeArgs(*args, xsink) : 0;
+}
+
+int QoreSqlite3PreparedStatement::bindNativeArgs(const QoreListNode& l, ExceptionSink* xsink) {
+    // values are bound without copying them, so the list is kept until it is replaced or the statement is reset
+    if (bound_args) {
+        bound_args->deref(xsink);
+    }
+    bound_args = l.listRefSelf();
+    return bindNative(stmt, bound_args, xsink, epoch_dates);
 }
 
 int QoreSqlite3PreparedStatement::bind(const QoreListNode& l, ExceptionSink* xsink) {
     assert(stmt);
 
+    if (native_binding) {
+        return bindNativeArgs(l, xsink);
+    }
+
     if (m_realArgs && m_realArgs->size() && bindParameters(stmt, xsink)) {
         xsink->raiseException("SQLITE3-STATEMENT-BIND-ERROR", "failed to bind variables");
         return -1;
@@ -436,26 +861,21 @@ QoreHashNode* QoreSqlite3PreparedStatement::getOutputHash(ExceptionSink* xsink,
 
     int end = row_count + maxrows;
 
-    ReferenceHolder<QoreHashNode> rv(new QoreHashNode(autoTypeInfo), xsink);
+    ReferenceHolder<QoreHashNode> rv(xsink);
 
     // fetch the results
     while (next()) {
-        if (rv->empty()) {
-            for (int i = 0; i < sqlite3_column_count(stmt); ++i) {
-                rv->setKeyValue(sqlite3_column_name(stmt, i), new QoreListNode(autoTypeInfo), xsink);
-            }
-        }
-        for (int i = 0; i < sqlite3_column_count(stmt); ++i) {
-            QoreListNode* node = rv->getKeyValue(sqlite3_column_name(stmt, i)).get<QoreListNode>();
-            node->push(columnValue(stmt, i), xsink);
+        if (!rv) {
+            rv = getLayout().getColumns(xsink);
         }
+        layout->appendRow(stmt, xsink);
 
         if (row_count == end) {
             break;
         }
     }
 
-    return rv.release();
+    return rv ? rv.release() : new QoreHashNode(autoTypeInfo);
 }
 
 QoreListNode* QoreSqlite3PreparedStatement::getOutputList(ExceptionSink* xsink, int maxrows) {
@@ -469,12 +889,7 @@ QoreListNode* QoreSqlite3PreparedStatement::getOutputList(ExceptionSink* xsink,
 
     ReferenceHolder<QoreListNode> rv(new QoreListNode(autoHashTypeInfo), xsink);
     while (next()) {
-        ReferenceHolder<QoreHashNode> head(new QoreHashNode(autoTypeInfo), xsink);
-
-        for (int i = 0; i < sqlite3_column_count(stmt); ++i) {
-            head->setKeyValue(sqlite3_column_name(stmt, i), columnValue(stmt, i), xsink);
-        }
-        rv->push(head.release(), xsink);
+        rv->push(getLayout().getRow(stmt, xsink), xsink);
 
         if (row_count == end) {
             break;
@@ -494,13 +909,15 @@ QoreHashNode* QoreSqlite3PreparedStatement::fetchRow(ExceptionSink* xsink) {
         return nullptr;
     }
 
-    ReferenceHolder<QoreHashNode> rv(new QoreHashNode(autoTypeInfo), xsink);
+    return getLayout().getRow(stmt, xsink);
+}
 
-    for (int i = 0, e = sqlite3_column_count(stmt); i < e; ++i) {
-        rv->setKeyValue(sqlite3_column_name(stmt, i), columnValue(stmt, i), xsink);
+QoreSqlite3RowLayout& QoreSqlite3PreparedStatement::getLayout() {
+    if (!layout) {
+        layout.reset(new QoreSqlite3RowLayout(conn->handler(), stmt, conn->getConversions(),
+            conn->getLobThreshold()));
     }
-
-    return rv.release();
+    return *layout;
 }
 
 QoreListNode* QoreSqlite3PreparedStatement::fetchRows(int rows, ExceptionSink* xsink) {
@@ -541,71 +958,109 @@ int QoreSqlite3PreparedStatement::rowsAffected() {
     return sqlite3_changes(conn->handler());
 }
 
+// returns the Qore type and the affinity for a declared column type; columns without a declared type are
+// expressions of unknown type, and columns whose values are converted by declared type have the type they are
+// converted to
+static qore_type_t get_declared_type(const char* decl, unsigned conversions, int& affinity) {
+    if (!decl) {
+        affinity = 0;
+        return -1;
+    }
+    qore_type_t converted = QoreSqlite3ExecBase::getConvertedType(decl, conversions);
+    affinity = qore_sqlite3_get_affinity(decl);
+    qore_type_t qtype;
+    switch (affinity) {
+        case QORE_SQLITE3_AFF_INTEGER: qtype = NT_INT; break;
+        case QORE_SQLITE3_AFF_TEXT: qtype = NT_STRING; break;
+        case QORE_SQLITE3_AFF_BLOB: qtype = NT_BINARY; break;
+        case QORE_SQLITE3_AFF_REAL: qtype = NT_FLOAT; break;
+        default: qtype = NT_NUMBER; break;
+    }
+    // compressed columns return values of the type given by their affinity
+    return converted && converted != NT_BINARY ? converted : qtype;
+}
+
+// returns the first size given in a declared type such as VARCHAR(20) or DECIMAL(10,2), or -1 if there is none
+static int64 get_declared_size(const char* decl) {
+    const char* p = decl ? strchr(decl, '(') : nullptr;
+    if (!p) {
+        return -1;
+    }
+    while (isspace(*++p)) {
+    }
+    return isdigit(*p) ? strtoll(p, nullptr, 10) : -1;
+}
+
 QoreHashNode* QoreSqlite3PreparedStatement::describe(ExceptionSink* xsink) {
-#ifdef SQLITE_DESCRIBE
-    // set up hash for row
-    ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
-    QoreString namestr("name");
-    QoreString maxsizestr("maxsize");
-    QoreString typestr("type");
-    QoreString dbtypestr("native_type");
-    QoreString internalstr("internal_id");
+    assert(stmt);
+#ifdef SQLITE_STMTSTATUS_REPREPARE
+    // the cached description is valid until SQLite reprepares the statement after a schema change
+    int reprepares = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_REPREPARE, 0);
+    if (desc && reprepares == desc_reprepares) {
+        return desc->hashRefSelf();
+    }
+#endif
+    clearDescription(xsink);
 
+    // the description is built from the prepared statement, so no row has to be read
+    ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
     for (int i = 0, e = sqlite3_column_count(stmt); i < e; ++i) {
         const char* column_name = sqlite3_column_name(stmt, i);
-        int ctype = sqlite3_column_type(stmt, i);
+        const char* decl = sqlite3_column_decltype(stmt, i);
+        int affinity;
+        qore_type_t qtype = get_declared_type(decl, conn->getConversions(), affinity);
 
         ReferenceHolder<QoreHashNode> col(new QoreHashNode(autoTypeInfo), xsink);
-        col->setKeyValue(namestr, new QoreStringNode(column_name), xsink);
-        col->setKeyValue(internalstr, ctype, xsink);
-
-        const char* stype;
-        qore_type_t qtype;
-        switch (ctype) {
-            case SQLITE_INTEGER:
-                stype = "int";
-                qtype = NT_INT;
-                break;
-
-            case SQLITE_FLOAT:
-                stype = "float";
-                qtype = NT_FLOAT;
-                break;
-
-            case SQLITE_BLOB:
-                stype = "blob";
-                qtype = NT_BINARY;
-                break;
-
-            case SQLITE_TEXT:
-                stype = "text";
-                qtype = NT_STRING;
-                break;
-
-            default:
-                stype = "unknown";
-                qtype = -1;
-                break;
-        };
-
-        col->setKeyValue(typestr, qtype, xsink);
-        col->setKeyValue(dbtypestr, new QoreStringNode(stype), xsink);
-        col->setKeyValue(maxsizestr, -1, xsink);
+        col->setKeyValue("name", new QoreStringNode(column_name, QCS_UTF8), xsink);
+        col->setKeyValue("type", qtype, xsink);
+        col->setKeyValue("native_type", new QoreStringNode(decl ? decl : "", QCS_UTF8), xsink);
+        col->setKeyValue("internal_id", affinity, xsink);
+        col->setKeyValue("maxsize", get_declared_size(decl), xsink);
+
+        bool nullable = true;
+#ifdef HAVE_SQLITE3_COLUMN_METADATA
+        // columns read directly from a table have an origin, which gives their constraints
+        const char* table = sqlite3_column_table_name(stmt, i);
+        if (table) {
+            const char* dbname = sqlite3_column_database_name(stmt, i);
+            const char* origin = sqlite3_column_origin_name(stmt, i);
+            int notnull = 0, pk = 0;
+            sqlite3_table_column_metadata(conn->handler(), dbname, table, origin, nullptr, nullptr, &notnull, &pk,
+                nullptr);
+            nullable = !notnull && !pk;
+            col->setKeyValue("database", new QoreStringNode(dbname, QCS_UTF8), xsink);
+            col->setKeyValue("table", new QoreStringNode(table, QCS_UTF8), xsink);
+            col->setKeyValue("column", new QoreStringNode(origin, QCS_UTF8), xsink);
+            col->setKeyValue("primary_key", (bool)pk, xsink);
+        }
+#endif
+        col->setKeyValue("nullable", nullable, xsink);
 
         h->setKeyValue(column_name, col.release(), xsink);
     }
 
-    return h.release();
-#else
-    xsink->raiseException("SQLITE3-DESCRIBE-ERROR", "SQLStatement::describe() is not supported");
-    return nullptr;
+#ifdef SQLITE_STMTSTATUS_REPREPARE
+    desc = h->hashRefSelf();
+    desc_reprepares = reprepares;
 #endif
+    return h.release();
+}
+
+void QoreSqlite3PreparedStatement::clearDescription(ExceptionSink* xsink) {
+    if (desc) {
+        desc->deref(xsink);
+        desc = nullptr;
+    }
 }
 
 void QoreSqlite3PreparedStatement::reset(ExceptionSink* xsink) {
     if (stmt) {
+        conn->addReprepares(stmt);
         sqlite3_finalize(stmt);
+        stmt = nullptr;
     }
+    layout.reset();
+    clearDescription(xsink);
 
     if (sql) {
         delete sql;
@@ -617,6 +1072,11 @@ void QoreSqlite3PreparedStatement::reset(ExceptionSink* xsink) {
         m_realArgs = nullptr;
     }
 
+    if (bound_args) {
+        bound_args->deref(xsink);
+        bound_args = nullptr;
+    }
+
     if (sql_active) {
         sql_active = false;
     }
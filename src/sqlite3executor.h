@@ -27,6 +27,11 @@
 #include <qore/Qore.h>
 
 #include "sqlite3connection.h"
+#include "sqlite3lob.h"
+
+#include <memory>
+#include <string>
+#include <vector>
 
 //! Base SQL operation class
 class QoreSqlite3ExecBase {
@@ -55,6 +60,38 @@ public:
     */
     DLLLOCAL int bindParameters(sqlite3_stmt* stmt, ExceptionSink* xsink);
 
+    /*! \brief Binds arguments to SQLite's own parameters in SQL that has not been parsed with parseForBind().
+
+        If the arguments are a single hash, each named parameter (\c :name, \c \@name or \c $name) takes the
+        value of the key with its name, with or without the prefix; otherwise the arguments are bound by position.
+
+        \param stmt a prepared sqlite3 statement.
+        \param args the arguments; may be nullptr
+        \param xsink exception handler
+
+        \retval bool 0 on success, -1 on error
+    */
+    DLLLOCAL static int bindNative(sqlite3_stmt* stmt, const QoreListNode* args, ExceptionSink* xsink,
+        bool epoch_dates = false);
+
+    /*! \brief Binds a single value to the parameter with the given 1-based index.
+
+        Absolute dates are bound as ISO-8601 text, or as integer microseconds since the epoch if \a epoch_dates is
+        true; numbers are bound as text, booleans as integers, and hashes and lists as JSON text.
+    */
+    DLLLOCAL static int bindValue(sqlite3_stmt* stmt, int i, const QoreValue arg, ExceptionSink* xsink,
+        bool epoch_dates = false);
+
+    //! Sets whether absolute dates are bound as integer microseconds since the epoch
+    DLLLOCAL void setEpochDates(bool epoch) {
+        epoch_dates = epoch;
+    }
+
+    //! Sets the QORE_SQLITE3_CONV_* conversions of column values by declared type
+    DLLLOCAL void setConversions(unsigned conv) {
+        conversions = conv;
+    }
+
     /*! \brief Universal Sqlite3 to Qore nodes conversion.
         \param stmt a reference for sqlite3 SQL statement. It has to be
                     prepared and fetched already.
@@ -64,14 +101,98 @@ public:
     */
     DLLLOCAL static QoreValue columnValue(sqlite3_stmt* stmt, int index);
 
+    /*! \brief Returns the value of a column converted to the Qore type of its declared type.
+
+        \param stmt a prepared statement positioned on a row
+        \param index the index of the column
+        \param type the type returned by getConvertedType() for the declared type of the column
+        \param conversions the QORE_SQLITE3_CONV_* conversions enabled on the connection
+
+        \retval QoreValue the converted value, or the value returned by columnValue() if the stored value cannot be
+        converted
+    */
+    DLLLOCAL static QoreValue convertedColumnValue(sqlite3_stmt* stmt, int index, qore_type_t type,
+            unsigned conversions);
+
+    /*! \brief Returns the Qore type that values of a declared column type are converted to.
+
+        \param decl the declared type
+        \param conversions the QORE_SQLITE3_CONV_* conversions enabled on the connection
+
+        \retval qore_type_t with \c QORE_SQLITE3_CONV_TYPES, \c NT_DATE for \c DATE, \c DATETIME and
+        \c TIMESTAMP, \c NT_NUMBER for \c NUMBER, \c NUMERIC and \c DECIMAL and \c NT_BOOLEAN for \c BOOLEAN;
+        with \c QORE_SQLITE3_CONV_JSON, \c NT_HASH for \c JSON, whose objects and arrays are parsed into hashes and
+        lists; \c NT_BINARY for types containing \c COMPRESS, whose values are decompressed into strings or binary
+        values, or 0 if values are returned as stored
+    */
+    DLLLOCAL static qore_type_t getConvertedType(const char* decl, unsigned conversions);
+
 protected:
     //! Encoding to use
     const QoreEncoding* enc;
 
+    //! True if absolute dates are bound as integer microseconds since the epoch
+    bool epoch_dates = false;
+
+    //! The QORE_SQLITE3_CONV_* conversions of column values by declared type
+    unsigned conversions = 0;
+
     //! Really used parameters list for statement (%s etc. filtered out)
     ReferenceHolder<QoreListNode> m_realArgs;
 };
 
+/*! \brief The column layout of a result set.
+    It is built once per statement, so that column names, declared types and, for results returned as a hash of
+    lists, the list of each column are only retrieved once.  Rows returned as hashes are copied from a template
+    hash that has the keys of all columns in order, so that no key is inserted by name for each row.
+*/
+class QoreSqlite3RowLayout {
+public:
+    /*! \brief Builds the layout of a prepared statement.
+        \param db the connection
+        \param stmt the prepared statement
+        \param conversions the QORE_SQLITE3_CONV_* conversions of column values by declared type
+        \param lob_threshold the size above which TEXT and BLOB values are returned as handles; 0 = never
+    */
+    DLLLOCAL QoreSqlite3RowLayout(sqlite3* db, sqlite3_stmt* stmt, unsigned conversions, int64 lob_threshold = 0);
+
+    DLLLOCAL QoreSqlite3RowLayout(const QoreSqlite3RowLayout&) = delete;
+
+    DLLLOCAL ~QoreSqlite3RowLayout();
+
+    //! Returns the current row as a hash copied from the row template
+    DLLLOCAL QoreHashNode* getRow(sqlite3_stmt* stmt, ExceptionSink* xsink) const;
+
+    //! Returns a new hash with an empty list for each column; rows are added to it with appendRow()
+    DLLLOCAL QoreHashNode* getColumns(ExceptionSink* xsink);
+
+    //! Appends the current row to the lists of the hash last returned by getColumns()
+    DLLLOCAL void appendRow(sqlite3_stmt* stmt, ExceptionSink* xsink) const;
+
+private:
+    //! The column names
+    std::vector<std::string> names;
+    //! A hash with a key for each column name in column order and no values, which rows are copied from
+    QoreHashNode* row_template = nullptr;
+    //! The columns whose values are stored in rows; of several columns with the same name, only the last one
+    std::vector<int> row_columns;
+    //! The list of each column in the hash returned by getColumns(); columns with the same name share a list
+    std::vector<QoreListNode*> lists;
+    //! The Qore type that the values of each column are converted to by declared type; empty if there are none
+    std::vector<qore_type_t> types;
+    //! The QORE_SQLITE3_CONV_* conversions of column values
+    unsigned conversions;
+    //! Large TEXT and BLOB columns returned as handles in rows, if enabled
+    std::unique_ptr<QoreSqlite3LobColumns> lob_cols;
+
+    DLLLOCAL QoreValue columnValue(sqlite3_stmt* stmt, int index, ExceptionSink* xsink) const {
+        if (!types.empty() && types[index]) {
+            return QoreSqlite3ExecBase::convertedColumnValue(stmt, index, types[index], conversions);
+        }
+        return lob_cols ? lob_cols->columnValue(stmt, index, xsink) : QoreSqlite3ExecBase::columnValue(stmt, index);
+    }
+};
+
 /*! \brief Data operations class.
     It will be created for every request from sqlite3module functions
     to keep statement related data clean and separated from QoreSqlite3Connection.
@@ -83,6 +204,26 @@ public:
 
     DLLLOCAL ~QoreSqlite3Executor();
 
+    //! Sets the size above which TEXT and BLOB values are returned as handles by select_rows(); 0 = never
+    DLLLOCAL void setLobThreshold(int64 threshold) {
+        lob_threshold = threshold;
+    }
+
+    //! Sets the SQLITE_PREPARE_* flags for statements
+    DLLLOCAL void setPrepareFlags(unsigned flags) {
+        prepare_flags = flags;
+    }
+
+    //! Sets whether SQL is passed to SQLite unparsed and arguments are bound to SQLite's own parameters
+    DLLLOCAL void setNativeBinding(bool native) {
+        native_binding = native;
+    }
+
+    //! Sets the cache that statements prepared directly from the caller's SQL are taken from and returned to
+    DLLLOCAL void setStatementCache(QoreSqlite3StatementCache* cache) {
+        stmt_cache = cache;
+    }
+
     /*! \brief Implementation for Qore DB API exec().
         It's primarily used for DDL/INSERT/UPDATE/DELETE statemets, but
         it can handle all stuff as it's calling select() method.
@@ -139,10 +280,82 @@ public:
         const QoreListNode *args,
         ExceptionSink* xsink);
 
+    /*! \brief Implementation for Qore DB API selectRow().
+        \param ds a Datasource reference from Qore API.
+        \param qstr a SQL statement from Qore API.
+        \param args a list with bindable parameters from Qore API.
+        \param xsink exception handler.
+        \retval QoreHashNode with the first row; nullptr if there are no rows; an exception is raised if the
+        statement returns more than one row.
+    */
+    DLLLOCAL QoreHashNode * select_row(
+        Datasource *ds,
+        const QoreString *qstr,
+        const QoreListNode *args,
+        ExceptionSink* xsink);
+
 protected:
     //! Current sqlite3 connection.
     sqlite3* m_handler;
 
+    //! The size above which TEXT and BLOB values are returned as handles by select_rows(); 0 = never
+    int64 lob_threshold = 0;
+
+    //! The SQLITE_PREPARE_* flags for statements
+    unsigned prepare_flags = 0;
+
+    //! True if SQL is passed to SQLite unparsed and arguments are bound to SQLite's own parameters
+    bool native_binding = false;
+
+    //! The statement cache; nullptr if statements are not cached
+    QoreSqlite3StatementCache* stmt_cache = nullptr;
+
+    //! The SQL text that the current statement is returned to the statement cache under
+    std::string cache_key;
+
+    //! True if the current statement is returned to the statement cache by release()
+    bool cached = false;
+
+    //! Releases the statement returned by prepare() at the end of a call
+    class StatementHolder {
+    public:
+        DLLLOCAL StatementHolder(QoreSqlite3Executor& exec, sqlite3_stmt* stmt) : exec(exec), stmt(stmt) {
+        }
+
+        DLLLOCAL ~StatementHolder() {
+            exec.release(stmt);
+        }
+
+    private:
+        QoreSqlite3Executor& exec;
+        sqlite3_stmt* stmt;
+    };
+
+    /*! \brief Prepares a statement and binds its arguments.
+        \param qstr a SQL statement from Qore API.
+        \param args a list with bindable parameters from Qore API.
+        \param binding flag if it should allow variable binding (true) or not (false)
+        \param calltype the exception code for errors
+        \param xsink exception handler.
+        \retval sqlite3_stmt* the prepared statement, which the caller must pass to release(); nullptr on error
+    */
+    DLLLOCAL sqlite3_stmt* prepare(const QoreString* qstr, const QoreListNode* args, bool binding,
+            const char* calltype, ExceptionSink* xsink);
+
+    /*! \brief Prepares SQL that is passed to SQLite, taking the statement from the statement cache if possible.
+
+        \param sql the SQL text in the connection's encoding
+        \param len the length of the SQL text
+        \param cache true if the SQL can be reused with other arguments, so its statement can be cached
+        \param stmt the prepared statement is returned here
+
+        \retval int an SQLite result code
+    */
+    DLLLOCAL int prepareStatement(const char* sql, size_t len, bool cache, sqlite3_stmt*& stmt);
+
+    //! Returns a statement to the statement cache if it was prepared for it, otherwise finalizes it
+    DLLLOCAL void release(sqlite3_stmt* stmt);
+
     /*! \brief Internal implementation of select() DB API.
         \param ds a Datasource reference from Qore API.
         \param qstr a SQL statement from Qore API.
@@ -168,6 +381,8 @@ public:
 
     DLLLOCAL ~QoreSqlite3PreparedStatement() {
         assert(!sql);
+        assert(!desc);
+        assert(!bound_args);
     }
 
     // returns 0 for OK, -1 for error
@@ -198,7 +413,31 @@ protected:
     // row count
     int row_count = -1;
 
+    //! True if the SQL was prepared unparsed and arguments are bound to SQLite's own parameters
+    bool native_binding = false;
+
+    //! The arguments bound to SQLite's own parameters, which must stay valid while they are bound
+    QoreListNode* bound_args = nullptr;
+
+    //! The column layout of the result set, built when the first row is converted
+    std::unique_ptr<QoreSqlite3RowLayout> layout;
+
+    //! Returns the column layout of the result set
+    DLLLOCAL QoreSqlite3RowLayout& getLayout();
+
+    //! The description of the result columns returned by describe(), kept until the statement is reprepared
+    QoreHashNode* desc = nullptr;
+
+    //! The statement's reprepare count when desc was built
+    int desc_reprepares = 0;
+
+    //! Releases the cached description
+    DLLLOCAL void clearDescription(ExceptionSink* xsink);
+
     DLLLOCAL int prepareIntern(const QoreListNode* args, ExceptionSink* xsink);
+
+    //! Binds arguments to SQLite's own parameters and keeps a reference to them
+    DLLLOCAL int bindNativeArgs(const QoreListNode& l, ExceptionSink* xsink);
 };
 
 #endif
@@ -0,0 +1,350 @@
+/*
+    sqlite3fts.cc
+
+    Qore Programming Language
+
+    Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "sqlite3fts.h"
+#include "sqlite3module.h"
+
+#include <strings.h>
+
+#include <string>
+#include <vector>
+
+// the time in milliseconds that index changes wait for locks held by other connections
+#define QORE_SQLITE3_FTS_BUSY_TIMEOUT 5000
+
+static std::string quote_literal(const std::string& str) {
+    std::string rv = "'";
+    for (char c : str) {
+        if (c == '\'') {
+            rv += '\'';
+        }
+        rv += c;
+    }
+    rv += '\'';
+    return rv;
+}
+
+// returns the comma-separated list of the given columns, each with the given prefix
+static std::string get_column_list(const std::vector<std::string>& columns, const char* prefix = "") {
+    std::string rv;
+    for (const auto& c : columns) {
+        if (!rv.empty()) {
+            rv += ", ";
+        }
+        rv += prefix + qore_sqlite3_quote_identifier(c);
+    }
+    return rv;
+}
+
+static int get_string_option(const char* opt, const QoreValue v, std::string& str, ExceptionSink* xsink) {
+    QoreStringValueHelper s(v, QCS_UTF8, xsink);
+    if (*xsink) {
+        return -1;
+    }
+    if (s->empty()) {
+        xsink->raiseException("SQLITE3-FTS-ERROR", "option '%s' must not be empty", opt);
+        return -1;
+    }
+    str = s->c_str();
+    return 0;
+}
+
+// opens a dedicated connection for the index functions
+static sqlite3* open_file(const char* filename, int flags, ExceptionSink* xsink) {
+    sqlite3* db = nullptr;
+    int rc = sqlite3_open_v2(filename, &db, flags
+        | (qore_sqlite3_open_flags & (SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_FULLMUTEX)), nullptr);
+    if (rc != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-FTS-ERROR", "cannot open %s: %s", filename,
+            db ? sqlite3_errmsg(db) : sqlite3_errstr(rc));
+        sqlite3_close(db);
+        return nullptr;
+    }
+    sqlite3_busy_timeout(db, QORE_SQLITE3_FTS_BUSY_TIMEOUT);
+    return db;
+}
+
+static int exec_sql(sqlite3* db, const std::string& sql, ExceptionSink* xsink) {
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-FTS-ERROR", "%s", sqlite3_errmsg(db));
+        return -1;
+    }
+    return 0;
+}
+
+// runs the statements in a transaction on a dedicated connection, so that they are all applied or none are
+static int exec_atomic(const char* filename, const std::vector<std::string>& statements, ExceptionSink* xsink) {
+    sqlite3* db = open_file(filename, SQLITE_OPEN_READWRITE, xsink);
+    if (!db) {
+        return -1;
+    }
+    ON_BLOCK_EXIT(sqlite3_close, db);
+
+    if (exec_sql(db, "begin immediate", xsink)) {
+        return -1;
+    }
+    for (const auto& sql : statements) {
+        if (exec_sql(db, sql, xsink)) {
+            sqlite3_exec(db, "rollback", nullptr, nullptr, nullptr);
+            return -1;
+        }
+    }
+    if (exec_sql(db, "commit", xsink)) {
+        sqlite3_exec(db, "rollback", nullptr, nullptr, nullptr);
+        return -1;
+    }
+    return 0;
+}
+
+int QoreSqlite3Fts::createIndex(const char* filename, const QoreHashNode* opts, ExceptionSink* xsink) {
+    std::string table, name, tokenize, prefix;
+    std::vector<std::string> columns;
+    bool rebuild = true;
+
+    ConstHashIterator hi(opts);
+    while (hi.next()) {
+        const char* opt = hi.getKey();
+        const QoreValue v = hi.get();
+
+        if (!strcasecmp(opt, "table")) {
+            if (get_string_option(opt, v, table, xsink)) {
+                return -1;
+            }
+        } else if (!strcasecmp(opt, "columns")) {
+            if (v.getType() == NT_LIST) {
+                ConstListIterator i(v.get<const QoreListNode>());
+                while (i.next()) {
+                    std::string column;
+                    if (get_string_option(opt, i.getValue(), column, xsink)) {
+                        return -1;
+                    }
+                    columns.push_back(column);
+                }
+            } else {
+                std::string column;
+                if (get_string_option(opt, v, column, xsink)) {
+                    return -1;
+                }
+                columns.push_back(column);
+            }
+        } else if (!strcasecmp(opt, "name")) {
+            if (get_string_option(opt, v, name, xsink)) {
+                return -1;
+            }
+        } else if (!strcasecmp(opt, "tokenize")) {
+            if (get_string_option(opt, v, tokenize, xsink)) {
+                return -1;
+            }
+        } else if (!strcasecmp(opt, "prefix")) {
+            if (get_string_option(opt, v, prefix, xsink)) {
+                return -1;
+            }
+        } else if (!strcasecmp(opt, "rebuild")) {
+            rebuild = v.getAsBool();
+        } else {
+            xsink->raiseException("SQLITE3-FTS-ERROR", "unknown FTS index option '%s'", opt);
+            return -1;
+        }
+    }
+    if (table.empty() || columns.empty()) {
+        xsink->raiseException("SQLITE3-FTS-ERROR", "an FTS index requires the 'table' and 'columns' keys");
+        return -1;
+    }
+    if (name.empty()) {
+        name = table + "_fts";
+    }
+
+    std::string idx = qore_sqlite3_quote_identifier(name);
+    std::string tbl = qore_sqlite3_quote_identifier(table);
+    std::string cols = get_column_list(columns);
+    std::string new_cols = get_column_list(columns, "new.");
+    std::string old_cols = get_column_list(columns, "old.");
+
+    std::string create = "create virtual table " + idx + " using fts5(" + cols + ", content="
+        + quote_literal(table) + ", content_rowid='rowid'";
+    if (!tokenize.empty()) {
+        create += ", tokenize=" + quote_literal(tokenize);
+    }
+    if (!prefix.empty()) {
+        create += ", prefix=" + quote_literal(prefix);
+    }
+    create += ")";
+
+    std::string insert = "insert into " + idx + "(rowid, " + cols + ") values (new.rowid, " + new_cols + ");";
+    std::string remove = "insert into " + idx + "(" + idx + ", rowid, " + cols + ") values ('delete', old.rowid, "
+        + old_cols + ");";
+
+    std::vector<std::string> statements = {
+        create,
+        "create trigger " + qore_sqlite3_quote_identifier(name + "_ai") + " after insert on " + tbl + " begin "
+            + insert + " end",
+        "create trigger " + qore_sqlite3_quote_identifier(name + "_ad") + " after delete on " + tbl + " begin "
+            + remove + " end",
+        // updates of other columns do not change the index
+        "create trigger " + qore_sqlite3_quote_identifier(name + "_au") + " after update of " + cols + " on " + tbl
+            + " begin " + remove + " " + insert + " end",
+    };
+    if (rebuild) {
+        statements.push_back("insert into " + idx + "(" + idx + ") values ('rebuild')");
+    }
+    return exec_atomic(filename, statements, xsink);
+}
+
+int QoreSqlite3Fts::dropIndex(const char* filename, const QoreString& index, ExceptionSink* xsink) {
+    TempEncodingHelper str(index, QCS_UTF8, xsink);
+    if (*xsink) {
+        return -1;
+    }
+    if (str->empty()) {
+        xsink->raiseException("SQLITE3-FTS-ERROR", "the index name must not be empty");
+        return -1;
+    }
+    std::string name = str->c_str();
+    std::vector<std::string> statements;
+    for (const char* suffix : {"_ai", "_ad", "_au"}) {
+        statements.push_back("drop trigger if exists " + qore_sqlite3_quote_identifier(name + suffix));
+    }
+    statements.push_back("drop table " + qore_sqlite3_quote_identifier(name));
+    return exec_atomic(filename, statements, xsink);
+}
+
+QoreHashNode* QoreSqlite3Fts::getIndexes(const char* filename, ExceptionSink* xsink) {
+    sqlite3* db = open_file(filename, SQLITE_OPEN_READONLY, xsink);
+    if (!db) {
+        return nullptr;
+    }
+    ON_BLOCK_EXIT(sqlite3_close, db);
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "select name from sqlite_master where type = 'table' and sql like "
+        "'create virtual table % using fts5%' order by name", -1, &stmt, nullptr) != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-FTS-ERROR", "%s", sqlite3_errmsg(db));
+        return nullptr;
+    }
+    ON_BLOCK_EXIT(sqlite3_finalize, stmt);
+
+    ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const char* name = (const char*)sqlite3_column_text(stmt, 0);
+        std::string sql = "pragma table_info(" + qore_sqlite3_quote_identifier(name) + ")";
+        sqlite3_stmt* cstmt;
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &cstmt, nullptr) != SQLITE_OK) {
+            xsink->raiseException("SQLITE3-FTS-ERROR", "%s", sqlite3_errmsg(db));
+            return nullptr;
+        }
+        ON_BLOCK_EXIT(sqlite3_finalize, cstmt);
+        ReferenceHolder<QoreListNode> l(new QoreListNode(stringTypeInfo), xsink);
+        while (sqlite3_step(cstmt) == SQLITE_ROW) {
+            l->push(new QoreStringNode((const char*)sqlite3_column_text(cstmt, 1), QCS_UTF8), xsink);
+        }
+        h->setKeyValue(name, l.release(), xsink);
+    }
+    if (rc != SQLITE_DONE) {
+        xsink->raiseException("SQLITE3-FTS-ERROR", "%s", sqlite3_errmsg(db));
+        return nullptr;
+    }
+    return h.release();
+}
+
+QoreStringNode* QoreSqlite3Fts::getSearchSql(const QoreString& index, const QoreHashNode* opts,
+        ExceptionSink* xsink) {
+    TempEncodingHelper name(index, QCS_UTF8, xsink);
+    if (*xsink) {
+        return nullptr;
+    }
+    std::string idx = qore_sqlite3_quote_identifier(name->c_str());
+
+    std::string table, open = "<b>", close = "</b>", ellipsis = "...", weights;
+    int64 snippet = -2, highlight = -2, tokens = 16;
+    bool native = false;
+
+    if (opts) {
+        ConstHashIterator hi(opts);
+        while (hi.next()) {
+            const char* opt = hi.getKey();
+            const QoreValue v = hi.get();
+
+            if (!strcasecmp(opt, "table")) {
+                if (get_string_option(opt, v, table, xsink)) {
+                    return nullptr;
+                }
+            } else if (!strcasecmp(opt, "snippet") || !strcasecmp(opt, "highlight")) {
+                int64 col = v.getAsBigInt();
+                // snippet() chooses the best column for -1
+                if (col < (tolower(*opt) == 's' ? -1 : 0)) {
+                    xsink->raiseException("SQLITE3-FTS-ERROR", "invalid column index " QLLD " for option '%s'",
+                        col, opt);
+                    return nullptr;
+                }
+                (tolower(*opt) == 's' ? snippet : highlight) = col;
+            } else if (!strcasecmp(opt, "open") || !strcasecmp(opt, "close") || !strcasecmp(opt, "ellipsis")) {
+                QoreStringValueHelper str(v, QCS_UTF8, xsink);
+                if (*xsink) {
+                    return nullptr;
+                }
+                (!strcasecmp(opt, "open") ? open : (!strcasecmp(opt, "close") ? close : ellipsis)) = str->c_str();
+            } else if (!strcasecmp(opt, "tokens")) {
+                tokens = v.getAsBigInt();
+                if (tokens < 1 || tokens > 64) {
+                    xsink->raiseException("SQLITE3-FTS-ERROR", "option '%s' must be between 1 and 64; got " QLLD,
+                        opt, tokens);
+                    return nullptr;
+                }
+            } else if (!strcasecmp(opt, "weights")) {
+                if (v.getType() != NT_LIST) {
+                    xsink->raiseException("SQLITE3-FTS-ERROR", "option '%s' expects a list of column weights; "
+                        "got type '%s'", opt, v.getTypeName());
+                    return nullptr;
+                }
+                ConstListIterator i(v.get<const QoreListNode>());
+                while (i.next()) {
+                    weights += ", " + std::to_string(i.getValue().getAsFloat());
+                }
+            } else if (!strcasecmp(opt, "native")) {
+                native = v.getAsBool();
+            } else {
+                xsink->raiseException("SQLITE3-FTS-ERROR", "unknown FTS search option '%s'", opt);
+                return nullptr;
+            }
+        }
+    }
+
+    // the rank is computed once per row and used for sorting; lower bm25() values are better matches
+    std::string sql = "select " + (table.empty() ? idx + ".rowid as rowid, " + idx + ".*" : std::string("c.*"))
+        + ", bm25(" + idx + weights + ") as rank";
+    if (snippet >= -1) {
+        sql += ", snippet(" + idx + ", " + std::to_string(snippet) + ", " + quote_literal(open) + ", "
+            + quote_literal(close) + ", " + quote_literal(ellipsis) + ", " + std::to_string(tokens) + ") as snippet";
+    }
+    if (highlight >= 0) {
+        sql += ", highlight(" + idx + ", " + std::to_string(highlight) + ", " + quote_literal(open) + ", "
+            + quote_literal(close) + ") as highlight";
+    }
+    sql += " from " + idx;
+    if (!table.empty()) {
+        sql += " join " + qore_sqlite3_quote_identifier(table) + " c on c.rowid = " + idx + ".rowid";
+    }
+    sql += " where " + idx + (native ? " match :query order by rank limit :limit offset :offset"
+        : " match %v order by rank limit %v offset %v");
+    return new QoreStringNode(sql.c_str(), QCS_UTF8);
+}
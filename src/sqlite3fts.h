@@ -0,0 +1,70 @@
+/*
+  sqlite3fts.h
+
+  Qore Programming Language
+
+  Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SQLITE3FTS_H
+#define SQLITE3FTS_H
+
+#include <sqlite3.h>
+#include <qore/Qore.h>
+
+/*! \brief Manages FTS5 full-text indexes on existing tables and builds ranked search queries.
+
+    An index is an external-content FTS5 table that stores only the index of the given columns of a rowid table;
+    triggers on the table keep it in sync with inserts, deletes and updates of the indexed columns.
+*/
+class QoreSqlite3Fts {
+public:
+    /*! \brief Creates an index and its triggers and builds the index from the rows already in the table.
+
+        The index is created with a dedicated connection to the database file.
+
+        \param filename the database file
+        \param opts a hash with a \c table key, a \c columns key and optional \c name, \c tokenize, \c prefix and
+        \c rebuild keys
+        \param xsink exception handler
+
+        \retval int 0 on success, -1 on error
+    */
+    DLLLOCAL static int createIndex(const char* filename, const QoreHashNode* opts, ExceptionSink* xsink);
+
+    //! Drops an index created with createIndex() and its triggers with a dedicated connection to the database file
+    DLLLOCAL static int dropIndex(const char* filename, const QoreString& name, ExceptionSink* xsink);
+
+    //! Returns a hash of the FTS5 tables in the main database of the file to their indexed columns
+    DLLLOCAL static QoreHashNode* getIndexes(const char* filename, ExceptionSink* xsink);
+
+    /*! \brief Returns SQL for a ranked, paginated search of an index.
+
+        The SQL takes the search expression, the maximum number of rows and the number of rows to skip as
+        arguments.
+
+        \param index the name of the FTS5 table
+        \param opts the options as documented for Sqlite3::fts_search_sql(); may be nullptr
+        \param xsink exception handler
+
+        \retval QoreStringNode* the SQL; nullptr on error
+    */
+    DLLLOCAL static QoreStringNode* getSearchSql(const QoreString& index, const QoreHashNode* opts,
+        ExceptionSink* xsink);
+};
+
+#endif
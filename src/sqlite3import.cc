@@ -0,0 +1,434 @@
+/*
+    sqlite3import.cc
+
+    Qore Programming Language
+
+    Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "sqlite3import.h"
+#include "sqlite3module.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+// the size of the blocks read from an input file
+#define QORE_SQLITE3_IMPORT_BLOCK_SIZE (1024 * 1024)
+
+// how long the import connection waits for locks held by other connections
+#define QORE_SQLITE3_IMPORT_BUSY_TIMEOUT 5000
+
+static int get_char_option(const char* opt, const QoreValue v, bool allow_empty, char& rv, ExceptionSink* xsink) {
+    QoreStringValueHelper str(v);
+    if (str->size() > 1 || (!allow_empty && str->empty())) {
+        xsink->raiseException("SQLITE3-IMPORT-ERROR", "option '%s' expects a single character; got '%s'", opt,
+            str->c_str());
+        return -1;
+    }
+    rv = str->empty() ? '\0' : str->c_str()[0];
+    return 0;
+}
+
+QoreSqlite3Import::QoreSqlite3Import(const char* filename) : filename(filename), fields(1), quoted(1) {
+}
+
+QoreSqlite3Import::~QoreSqlite3Import() {
+    sqlite3_finalize(stmt);
+    if (db && !orig_journal_mode.empty()) {
+        std::string sql = "pragma journal_mode = " + orig_journal_mode;
+        sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+    }
+    sqlite3_close(db);
+}
+
+int QoreSqlite3Import::setOptions(const QoreHashNode* opts, ExceptionSink* xsink) {
+    if (!opts) {
+        return 0;
+    }
+
+    ConstHashIterator hi(opts);
+    while (hi.next()) {
+        const char* opt = hi.getKey();
+        const QoreValue v = hi.get();
+
+        if (!strcasecmp(opt, "separator")) {
+            if (get_char_option(opt, v, false, separator, xsink)) {
+                return -1;
+            }
+        } else if (!strcasecmp(opt, "quote")) {
+            if (get_char_option(opt, v, true, quote, xsink)) {
+                return -1;
+            }
+        } else if (!strcasecmp(opt, "header")) {
+            header = v.getAsBool();
+        } else if (!strcasecmp(opt, "columns")) {
+            if (v.getType() != NT_LIST) {
+                xsink->raiseException("SQLITE3-IMPORT-ERROR", "option '%s' expects a list; got type '%s'", opt,
+                    v.getTypeName());
+                return -1;
+            }
+            ConstListIterator i(v.get<const QoreListNode>());
+            while (i.next()) {
+                QoreStringValueHelper str(i.getValue(), QCS_UTF8, xsink);
+                if (*xsink) {
+                    return -1;
+                }
+                columns.push_back(str->c_str());
+            }
+        } else if (!strcasecmp(opt, "null")) {
+            QoreStringValueHelper str(v, QCS_UTF8, xsink);
+            if (*xsink) {
+                return -1;
+            }
+            has_null = true;
+            null_str = str->c_str();
+        } else if (!strcasecmp(opt, "batch")) {
+            batch = v.getAsBigInt();
+            if (batch < 1) {
+                xsink->raiseException("SQLITE3-IMPORT-ERROR", "option '%s' must be positive; got " QLLD, opt, batch);
+                return -1;
+            }
+        } else if (!strcasecmp(opt, "synchronous") || !strcasecmp(opt, "journal_mode")) {
+            QoreStringValueHelper str(v);
+            // only pragma keywords are accepted, as the value is inserted in the pragma statement
+            for (const char* p = str->c_str(); *p; ++p) {
+                if (!isalnum(*p)) {
+                    xsink->raiseException("SQLITE3-IMPORT-ERROR", "invalid value '%s' for option '%s'",
+                        str->c_str(), opt);
+                    return -1;
+                }
+            }
+            (tolower(*opt) == 's' ? synchronous : journal_mode) = str->c_str();
+        } else if (!strcasecmp(opt, "progress")) {
+            progress = dynamic_cast<const ResolvedCallReferenceNode*>(v.getInternalNode());
+            if (!progress) {
+                xsink->raiseException("SQLITE3-IMPORT-ERROR", "option '%s' expects a closure or call reference; "
+                    "got type '%s'", opt, v.getTypeName());
+                return -1;
+            }
+        } else {
+            xsink->raiseException("SQLITE3-IMPORT-ERROR", "unknown option '%s'", opt);
+            return -1;
+        }
+    }
+    if (separator == quote) {
+        xsink->raiseException("SQLITE3-IMPORT-ERROR", "the separator and the quote character must be different");
+        return -1;
+    }
+    return 0;
+}
+
+int QoreSqlite3Import::exec(const char* sql, ExceptionSink* xsink) {
+    char* err = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err) != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-IMPORT-ERROR", "%s", err ? err : sqlite3_errmsg(db));
+        sqlite3_free(err);
+        return -1;
+    }
+    return 0;
+}
+
+int QoreSqlite3Import::open(ExceptionSink* xsink) {
+    int rc = sqlite3_open_v2(filename.c_str(), &db, SQLITE_OPEN_READWRITE
+        | (qore_sqlite3_open_flags & (SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_FULLMUTEX)), nullptr);
+    if (rc != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-IMPORT-ERROR", "cannot open %s: %s", filename.c_str(),
+            db ? sqlite3_errmsg(db) : sqlite3_errstr(rc));
+        return -1;
+    }
+    sqlite3_busy_timeout(db, QORE_SQLITE3_IMPORT_BUSY_TIMEOUT);
+
+    // the synchronous setting only applies to this connection
+    if (!synchronous.empty() && exec(("pragma synchronous = " + synchronous).c_str(), xsink)) {
+        return -1;
+    }
+    // the journal mode applies to the database and is restored when the import is complete
+    if (!journal_mode.empty()) {
+        sqlite3_stmt* s;
+        if (sqlite3_prepare_v2(db, "pragma journal_mode", -1, &s, nullptr) != SQLITE_OK) {
+            xsink->raiseException("SQLITE3-IMPORT-ERROR", "%s", sqlite3_errmsg(db));
+            return -1;
+        }
+        if (sqlite3_step(s) == SQLITE_ROW) {
+            orig_journal_mode = (const char*)sqlite3_column_text(s, 0);
+        }
+        sqlite3_finalize(s);
+        if (exec(("pragma journal_mode = " + journal_mode).c_str(), xsink)) {
+            orig_journal_mode.clear();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int QoreSqlite3Import::prepare(ExceptionSink* xsink) {
+    std::string sql = "insert into " + table;
+    if (!columns.empty()) {
+        sql += " (";
+        for (size_t i = 0; i < columns.size(); ++i) {
+            if (i) {
+                sql += ", ";
+            }
+            sql += qore_sqlite3_quote_identifier(columns[i]);
+        }
+        sql += ")";
+    }
+    sql += " values (";
+    size_t n = columns.empty() ? nfields : columns.size();
+    for (size_t i = 0; i < n; ++i) {
+        sql += i ? ", ?" : "?";
+    }
+    sql += ")";
+
+    if (sqlite3_prepare_v2(db, sql.c_str(), sql.size() + 1, &stmt, nullptr) != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-IMPORT-ERROR", "%s", sqlite3_errmsg(db));
+        return -1;
+    }
+    return 0;
+}
+
+void QoreSqlite3Import::endField() {
+    // there is always an entry for the current field
+    if (++nfields == fields.size()) {
+        fields.emplace_back();
+        quoted.push_back(false);
+    }
+    field_started = false;
+}
+
+int QoreSqlite3Import::endRow(ExceptionSink* xsink) {
+    endField();
+    size_t n = nfields;
+    nfields = 0;
+
+    // blank lines are skipped
+    if (n == 1 && fields[0].empty() && !quoted[0]) {
+        return 0;
+    }
+
+    if (header) {
+        // the header row gives the column names unless they have been set with the "columns" option
+        header = false;
+        if (columns.empty()) {
+            columns.assign(fields.begin(), fields.begin() + n);
+        }
+        return 0;
+    }
+    if (!stmt) {
+        nfields = n;
+        int rc = prepare(xsink);
+        nfields = 0;
+        if (rc) {
+            return -1;
+        }
+    }
+
+    if ((int)n != sqlite3_bind_parameter_count(stmt)) {
+        xsink->raiseException("SQLITE3-IMPORT-ERROR", "line " QLLD ": expecting %d fields; got %d", row_line,
+            sqlite3_bind_parameter_count(stmt), (int)n);
+        return -1;
+    }
+
+    if (!batch_rows && exec("begin", xsink)) {
+        return -1;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (has_null && !quoted[i] && fields[i] == null_str) {
+            sqlite3_bind_null(stmt, i + 1);
+        } else {
+            sqlite3_bind_text(stmt, i + 1, fields[i].data(), fields[i].size(), SQLITE_STATIC);
+        }
+    }
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        xsink->raiseException("SQLITE3-IMPORT-ERROR", "line " QLLD ": %s", row_line, sqlite3_errmsg(db));
+        sqlite3_reset(stmt);
+        return -1;
+    }
+    sqlite3_reset(stmt);
+    ++rows;
+    if (++batch_rows == batch) {
+        return commit(xsink);
+    }
+    return 0;
+}
+
+void QoreSqlite3Import::clearRow() {
+    for (size_t i = 0; i < fields.size(); ++i) {
+        fields[i].clear();
+        quoted[i] = false;
+    }
+}
+
+int QoreSqlite3Import::commit(ExceptionSink* xsink) {
+    if (exec("commit", xsink)) {
+        return -1;
+    }
+    batch_rows = 0;
+
+    if (progress) {
+        ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+        h->setKeyValue("rows", rows, xsink);
+        h->setKeyValue("bytes", bytes, xsink);
+        ReferenceHolder<QoreListNode> args(new QoreListNode(autoTypeInfo), xsink);
+        args->push(h.release(), xsink);
+        ValueHolder rv(progress->execValue(*args, xsink), xsink);
+        if (*xsink) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int QoreSqlite3Import::parse(const char* data, size_t len, ExceptionSink* xsink) {
+    size_t i = 0;
+    int64 base = bytes;
+    // skip a UTF-8 byte order mark
+    if (!bom_checked) {
+        bom_checked = true;
+        if (len >= 3 && !memcmp(data, "\xef\xbb\xbf", 3)) {
+            i = 3;
+        }
+    }
+
+    for (; i < len; ++i) {
+        char c = data[i];
+        if (c == '\n') {
+            ++line;
+        }
+        std::string& field = fields[nfields];
+
+        if (in_quotes) {
+            if (c == quote) {
+                in_quotes = false;
+                after_quote = true;
+            } else {
+                field += c;
+            }
+            continue;
+        }
+        if (after_quote) {
+            after_quote = false;
+            // a doubled quote in a quoted field
+            if (c == quote) {
+                field += c;
+                in_quotes = true;
+                continue;
+            }
+        }
+        if (c == separator) {
+            endField();
+        } else if (c == '\n') {
+            bytes = base + i + 1;
+            if (endRow(xsink)) {
+                return -1;
+            }
+            clearRow();
+            row_line = line;
+        } else if (c == '\r') {
+            // carriage returns outside quoted fields are ignored
+        } else if (c == quote && quote && !field_started) {
+            in_quotes = true;
+            quoted[nfields] = true;
+            field_started = true;
+        } else {
+            field += c;
+            field_started = true;
+        }
+    }
+    bytes = base + len;
+    return 0;
+}
+
+int QoreSqlite3Import::finish(ExceptionSink* xsink) {
+    if (in_quotes) {
+        xsink->raiseException("SQLITE3-IMPORT-ERROR", "line " QLLD ": unterminated quoted field", row_line);
+        return -1;
+    }
+    // a last row without a line terminator
+    if (nfields || field_started || quoted[0]) {
+        if (endRow(xsink)) {
+            return -1;
+        }
+    }
+    return batch_rows ? commit(xsink) : 0;
+}
+
+int64 QoreSqlite3Import::run(const QoreString& tbl, const QoreValue input, ExceptionSink* xsink) {
+    qore_type_t t = input.getType();
+    if (t != NT_STRING && t != NT_BINARY) {
+        xsink->raiseException("SQLITE3-IMPORT-ERROR", "expecting a file name or binary data as input; got type '%s'",
+            input.getTypeName());
+        return -1;
+    }
+
+    TempEncodingHelper tname(tbl, QCS_UTF8, xsink);
+    if (*xsink) {
+        return -1;
+    }
+    table = qore_sqlite3_quote_identifier(tname->c_str());
+
+    if (open(xsink)) {
+        return -1;
+    }
+
+    int rc;
+    if (t == NT_BINARY) {
+        const BinaryNode* b = input.get<const BinaryNode>();
+        rc = parse((const char*)b->getPtr(), b->size(), xsink);
+    } else {
+        TempEncodingHelper path(input.get<const QoreStringNode>(), QCS_UTF8, xsink);
+        if (*xsink) {
+            return -1;
+        }
+        FILE* fp = fopen(path->c_str(), "rb");
+        if (!fp) {
+            xsink->raiseException("SQLITE3-IMPORT-ERROR", "cannot open '%s': %s", path->c_str(), strerror(errno));
+            return -1;
+        }
+        ON_BLOCK_EXIT(fclose, fp);
+
+        std::vector<char> buf(QORE_SQLITE3_IMPORT_BLOCK_SIZE);
+        rc = 0;
+        while (!rc) {
+            size_t len = fread(buf.data(), 1, buf.size(), fp);
+            if (!len) {
+                if (ferror(fp)) {
+                    xsink->raiseException("SQLITE3-IMPORT-ERROR", "cannot read '%s': %s", path->c_str(),
+                        strerror(errno));
+                    rc = -1;
+                }
+                break;
+            }
+            rc = parse(buf.data(), len, xsink);
+        }
+    }
+
+    if (!rc) {
+        rc = finish(xsink);
+    }
+    if (rc) {
+        // the current batch is rolled back; batches that have already been committed are kept
+        if (!sqlite3_get_autocommit(db)) {
+            sqlite3_exec(db, "rollback", nullptr, nullptr, nullptr);
+        }
+        return -1;
+    }
+    return rows;
+}
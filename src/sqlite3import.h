@@ -0,0 +1,132 @@
+/*
+  sqlite3import.h
+
+  Qore Programming Language
+
+  Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SQLITE3IMPORT_H
+#define SQLITE3IMPORT_H
+
+#include <sqlite3.h>
+#include <qore/Qore.h>
+
+#include <string>
+#include <vector>
+
+/*! \brief Imports delimited text into a table.
+
+    The input is parsed in C++ as described in RFC 4180, with a configurable separator and quote character, and
+    each row is bound field by field to a single prepared INSERT statement; rows are committed in batches, so that
+    the cost of a transaction is shared by many rows.
+*/
+class QoreSqlite3Import {
+public:
+    DLLLOCAL QoreSqlite3Import(const char* filename);
+
+    //! Restores the journal mode if it was changed and closes the connection
+    DLLLOCAL ~QoreSqlite3Import();
+
+    /*! \brief Sets the import options.
+
+        \param opts the options as documented for Sqlite3::import_csv(); may be nullptr
+        \param xsink exception handler
+
+        \retval int 0 on success, -1 on error
+    */
+    DLLLOCAL int setOptions(const QoreHashNode* opts, ExceptionSink* xsink);
+
+    /*! \brief Runs the import.
+
+        \param table the target table
+        \param input the name of the input file or the input data as a string or binary value
+        \param xsink exception handler
+
+        \retval int64 the number of rows imported; -1 on error
+    */
+    DLLLOCAL int64 run(const QoreString& table, const QoreValue input, ExceptionSink* xsink);
+
+private:
+    std::string filename;
+
+    // options
+    char separator = ',';
+    char quote = '"';
+    bool header = true;
+    std::vector<std::string> columns;
+    bool has_null = false;
+    std::string null_str;
+    int64 batch = 100000;
+    std::string synchronous;
+    std::string journal_mode;
+    const ResolvedCallReferenceNode* progress = nullptr;
+
+    sqlite3* db = nullptr;
+    sqlite3_stmt* stmt = nullptr;
+    //! The original journal mode if it has been changed
+    std::string orig_journal_mode;
+    std::string table;
+
+    // parser state
+    //! the fields of the current row; strings are reused between rows
+    std::vector<std::string> fields;
+    //! true for fields that were quoted
+    std::vector<bool> quoted;
+    size_t nfields = 0;
+    bool in_quotes = false;
+    bool after_quote = false;
+    bool field_started = false;
+    bool bom_checked = false;
+    //! the current line and the line of the current row
+    int64 line = 1;
+    int64 row_line = 1;
+
+    // import state
+    int64 rows = 0;
+    int64 batch_rows = 0;
+    int64 bytes = 0;
+
+    //! Opens the connection and applies the connection options
+    DLLLOCAL int open(ExceptionSink* xsink);
+
+    //! Parses a chunk of input, importing all complete rows
+    DLLLOCAL int parse(const char* data, size_t len, ExceptionSink* xsink);
+
+    //! Imports any incomplete row at the end of the input and commits the last batch
+    DLLLOCAL int finish(ExceptionSink* xsink);
+
+    //! Ends the current field
+    DLLLOCAL void endField();
+
+    //! Ends the current row and imports it
+    DLLLOCAL int endRow(ExceptionSink* xsink);
+
+    //! Clears the fields for the next row
+    DLLLOCAL void clearRow();
+
+    //! Prepares the insert statement for the given columns or number of columns
+    DLLLOCAL int prepare(ExceptionSink* xsink);
+
+    //! Commits the current batch and reports progress
+    DLLLOCAL int commit(ExceptionSink* xsink);
+
+    //! Runs SQL on the import connection
+    DLLLOCAL int exec(const char* sql, ExceptionSink* xsink);
+};
+
+#endif
@@ -0,0 +1,516 @@
+/*
+    sqlite3json.cc
+
+    Qore Programming Language
+
+    Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "sqlite3json.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+// the maximum nesting depth of arrays and objects, so that malformed text cannot exhaust the stack
+#define QORE_SQLITE3_JSON_MAX_DEPTH 512
+
+//! Recursive descent parser for JSON text that builds Qore values
+class QoreSqlite3JsonParser {
+public:
+    DLLLOCAL QoreSqlite3JsonParser(const char* p, const char* end, ExceptionSink* xsink)
+            : p(p), end(end), xsink(xsink) {
+    }
+
+    //! Parses a value; \a rv is only set if true is returned
+    DLLLOCAL bool parseValue(QoreValue& rv, int depth) {
+        skipSpace();
+        if (p == end) {
+            return false;
+        }
+        switch (*p) {
+            case '{':
+                return parseObject(rv, depth);
+            case '[':
+                return parseArray(rv, depth);
+            case '"': {
+                const char* str;
+                size_t len;
+                if (!parseString(str, len)) {
+                    return false;
+                }
+                rv = new QoreStringNode(str, len, QCS_UTF8);
+                return true;
+            }
+            case 't':
+                if (!parseLiteral("true", 4)) {
+                    return false;
+                }
+                rv = true;
+                return true;
+            case 'f':
+                if (!parseLiteral("false", 5)) {
+                    return false;
+                }
+                rv = false;
+                return true;
+            case 'n':
+                if (!parseLiteral("null", 4)) {
+                    return false;
+                }
+                rv = QoreValue();
+                return true;
+            default:
+                break;
+        }
+        return parseNumber(rv);
+    }
+
+    //! Returns true if only whitespace is left
+    DLLLOCAL bool atEnd() {
+        skipSpace();
+        return p == end;
+    }
+
+private:
+    const char* p;
+    const char* end;
+    ExceptionSink* xsink;
+    //! Holds strings with escape sequences once they are decoded
+    std::string buf;
+
+    DLLLOCAL void skipSpace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+            ++p;
+        }
+    }
+
+    DLLLOCAL bool parseLiteral(const char* literal, size_t len) {
+        if ((size_t)(end - p) < len || strncmp(p, literal, len)) {
+            return false;
+        }
+        p += len;
+        return true;
+    }
+
+    DLLLOCAL bool parseObject(QoreValue& rv, int depth) {
+        if (depth == QORE_SQLITE3_JSON_MAX_DEPTH) {
+            return false;
+        }
+        ++p;
+        ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+        skipSpace();
+        if (p < end && *p == '}') {
+            ++p;
+            rv = h.release();
+            return true;
+        }
+        while (true) {
+            skipSpace();
+            const char* str;
+            size_t len;
+            if (p == end || *p != '"' || !parseString(str, len)) {
+                return false;
+            }
+            std::string key(str, len);
+            skipSpace();
+            if (p == end || *p != ':') {
+                return false;
+            }
+            ++p;
+            QoreValue v;
+            if (!parseValue(v, depth + 1)) {
+                return false;
+            }
+            h->setKeyValue(key.c_str(), v, xsink);
+            skipSpace();
+            if (p == end) {
+                return false;
+            }
+            if (*p == '}') {
+                ++p;
+                rv = h.release();
+                return true;
+            }
+            if (*p != ',') {
+                return false;
+            }
+            ++p;
+        }
+    }
+
+    DLLLOCAL bool parseArray(QoreValue& rv, int depth) {
+        if (depth == QORE_SQLITE3_JSON_MAX_DEPTH) {
+            return false;
+        }
+        ++p;
+        ReferenceHolder<QoreListNode> l(new QoreListNode(autoTypeInfo), xsink);
+        skipSpace();
+        if (p < end && *p == ']') {
+            ++p;
+            rv = l.release();
+            return true;
+        }
+        while (true) {
+            QoreValue v;
+            if (!parseValue(v, depth + 1)) {
+                return false;
+            }
+            l->push(v, xsink);
+            skipSpace();
+            if (p == end) {
+                return false;
+            }
+            if (*p == ']') {
+                ++p;
+                rv = l.release();
+                return true;
+            }
+            if (*p != ',') {
+                return false;
+            }
+            ++p;
+        }
+    }
+
+    //! Returns the 4 hex digits of a \\u escape sequence, or -1 if they are invalid
+    DLLLOCAL int parseHex() {
+        if (end - p < 4) {
+            return -1;
+        }
+        int rv = 0;
+        for (int i = 0; i < 4; ++i, ++p) {
+            char c = *p;
+            rv <<= 4;
+            if (c >= '0' && c <= '9') {
+                rv |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                rv |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                rv |= c - 'A' + 10;
+            } else {
+                return -1;
+            }
+        }
+        return rv;
+    }
+
+    DLLLOCAL void appendUtf8(unsigned cp) {
+        if (cp < 0x80) {
+            buf += (char)cp;
+        } else if (cp < 0x800) {
+            buf += (char)(0xc0 | (cp >> 6));
+            buf += (char)(0x80 | (cp & 0x3f));
+        } else if (cp < 0x10000) {
+            buf += (char)(0xe0 | (cp >> 12));
+            buf += (char)(0x80 | ((cp >> 6) & 0x3f));
+            buf += (char)(0x80 | (cp & 0x3f));
+        } else {
+            buf += (char)(0xf0 | (cp >> 18));
+            buf += (char)(0x80 | ((cp >> 12) & 0x3f));
+            buf += (char)(0x80 | ((cp >> 6) & 0x3f));
+            buf += (char)(0x80 | (cp & 0x3f));
+        }
+    }
+
+    /*! Parses a string; \a str points into the text if it has no escape sequences, otherwise into the decoded
+        buffer, which is only valid until the next string is parsed
+    */
+    DLLLOCAL bool parseString(const char*& str, size_t& len) {
+        const char* start = ++p;
+        while (p < end && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20) {
+            ++p;
+        }
+        if (p == end || (unsigned char)*p < 0x20) {
+            return false;
+        }
+        if (*p == '"') {
+            str = start;
+            len = p - start;
+            ++p;
+            return true;
+        }
+
+        buf.assign(start, p - start);
+        while (true) {
+            if (p == end || (unsigned char)*p < 0x20) {
+                return false;
+            }
+            char c = *p++;
+            if (c == '"') {
+                break;
+            }
+            if (c != '\\') {
+                buf += c;
+                continue;
+            }
+            if (p == end) {
+                return false;
+            }
+            switch (*p++) {
+                case '"': buf += '"'; break;
+                case '\\': buf += '\\'; break;
+                case '/': buf += '/'; break;
+                case 'b': buf += '\b'; break;
+                case 'f': buf += '\f'; break;
+                case 'n': buf += '\n'; break;
+                case 'r': buf += '\r'; break;
+                case 't': buf += '\t'; break;
+                case 'u': {
+                    int cp = parseHex();
+                    if (cp < 0 || (cp >= 0xdc00 && cp <= 0xdfff)) {
+                        return false;
+                    }
+                    // characters outside the BMP are encoded as surrogate pairs
+                    if (cp >= 0xd800 && cp <= 0xdbff) {
+                        if (end - p < 2 || p[0] != '\\' || p[1] != 'u') {
+                            return false;
+                        }
+                        p += 2;
+                        int low = parseHex();
+                        if (low < 0xdc00 || low > 0xdfff) {
+                            return false;
+                        }
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    appendUtf8(cp);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        str = buf.data();
+        len = buf.size();
+        return true;
+    }
+
+    DLLLOCAL bool skipDigits() {
+        if (p == end || !isdigit((unsigned char)*p)) {
+            return false;
+        }
+        while (p < end && isdigit((unsigned char)*p)) {
+            ++p;
+        }
+        return true;
+    }
+
+    DLLLOCAL bool parseNumber(QoreValue& rv) {
+        const char* start = p;
+        if (*p == '-') {
+            ++p;
+        }
+        if (p < end && *p == '0') {
+            ++p;
+        } else if (!skipDigits()) {
+            return false;
+        }
+        bool integer = true;
+        if (p < end && *p == '.') {
+            ++p;
+            if (!skipDigits()) {
+                return false;
+            }
+            integer = false;
+        }
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            ++p;
+            if (p < end && (*p == '+' || *p == '-')) {
+                ++p;
+            }
+            if (!skipDigits()) {
+                return false;
+            }
+            integer = false;
+        }
+        // the text is not necessarily terminated after the number
+        std::string num(start, p - start);
+        if (integer) {
+            errno = 0;
+            long long i = strtoll(num.c_str(), nullptr, 10);
+            if (errno == ERANGE) {
+                rv = new QoreNumberNode(num.c_str());
+            } else {
+                rv = (int64)i;
+            }
+            return true;
+        }
+        rv = strtod(num.c_str(), nullptr);
+        return true;
+    }
+};
+
+bool QoreSqlite3Json::parse(const char* text, size_t len, QoreValue& rv) {
+    // the values of invalid text are freed here; freeing hashes and lists of plain values cannot raise exceptions
+    ExceptionSink xsink;
+    QoreSqlite3JsonParser parser(text, text + len, &xsink);
+    ValueHolder v(&xsink);
+    if (!parser.parseValue(*v, 0) || !parser.atEnd()) {
+        return false;
+    }
+    rv = v.release();
+    return true;
+}
+
+static void append_string(QoreString& str, const char* p, size_t len) {
+    str.concat('"');
+    const char* start = p;
+    for (const char* e = p + len; p < e; ++p) {
+        unsigned char c = *p;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        str.concat(start, p - start);
+        switch (c) {
+            case '"': str.concat("\\\""); break;
+            case '\\': str.concat("\\\\"); break;
+            case '\b': str.concat("\\b"); break;
+            case '\f': str.concat("\\f"); break;
+            case '\n': str.concat("\\n"); break;
+            case '\r': str.concat("\\r"); break;
+            case '\t': str.concat("\\t"); break;
+            default: str.sprintf("\\u%04x", c); break;
+        }
+        start = p + 1;
+    }
+    str.concat(start, p - start);
+    str.concat('"');
+}
+
+static void append_base64(QoreString& str, const unsigned char* p, size_t len) {
+    static const char chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    str.concat('"');
+    size_t i = 0;
+    for (; i + 2 < len; i += 3) {
+        unsigned v = (p[i] << 16) | (p[i + 1] << 8) | p[i + 2];
+        str.concat(chars[v >> 18]);
+        str.concat(chars[(v >> 12) & 0x3f]);
+        str.concat(chars[(v >> 6) & 0x3f]);
+        str.concat(chars[v & 0x3f]);
+    }
+    if (i < len) {
+        unsigned v = p[i] << 16;
+        if (i + 1 < len) {
+            v |= p[i + 1] << 8;
+        }
+        str.concat(chars[v >> 18]);
+        str.concat(chars[(v >> 12) & 0x3f]);
+        str.concat(i + 1 < len ? chars[(v >> 6) & 0x3f] : '=');
+        str.concat('=');
+    }
+    str.concat('"');
+}
+
+int QoreSqlite3Json::serialize(QoreString& str, const QoreValue v, ExceptionSink* xsink) {
+    switch (v.getType()) {
+        case NT_NOTHING:
+        case NT_NULL:
+            str.concat("null");
+            return 0;
+        case NT_BOOLEAN:
+            str.concat(v.getAsBool() ? "true" : "false");
+            return 0;
+        case NT_INT:
+            str.sprintf("%lld", (long long)v.getAsBigInt());
+            return 0;
+        case NT_FLOAT: {
+            double f = v.getAsFloat();
+            if (!isfinite(f)) {
+                str.concat("null");
+                return 0;
+            }
+            // the shortest representation that reads back as the same value
+            char buf[32];
+            snprintf(buf, sizeof buf, "%.15g", f);
+            if (strtod(buf, nullptr) != f) {
+                snprintf(buf, sizeof buf, "%.17g", f);
+            }
+            str.concat(buf);
+            // keeps the value a float when it is parsed again
+            if (!strpbrk(buf, ".e")) {
+                str.concat(".0");
+            }
+            return 0;
+        }
+        case NT_NUMBER: {
+            v.get<const QoreNumberNode>()->toString(str);
+            return 0;
+        }
+        case NT_STRING: {
+            TempEncodingHelper s(v.get<const QoreStringNode>(), QCS_UTF8, xsink);
+            if (*xsink) {
+                return -1;
+            }
+            append_string(str, s->c_str(), s->size());
+            return 0;
+        }
+        case NT_DATE: {
+            QoreString date;
+            v.get<const DateTimeNode>()->format(date, "IF");
+            append_string(str, date.c_str(), date.size());
+            return 0;
+        }
+        case NT_BINARY: {
+            const BinaryNode* b = v.get<const BinaryNode>();
+            append_base64(str, (const unsigned char*)b->getPtr(), b->size());
+            return 0;
+        }
+        case NT_HASH: {
+            str.concat('{');
+            ConstHashIterator hi(v.get<const QoreHashNode>());
+            bool first = true;
+            while (hi.next()) {
+                if (first) {
+                    first = false;
+                } else {
+                    str.concat(',');
+                }
+                const char* key = hi.getKey();
+                append_string(str, key, strlen(key));
+                str.concat(':');
+                if (serialize(str, hi.get(), xsink)) {
+                    return -1;
+                }
+            }
+            str.concat('}');
+            return 0;
+        }
+        case NT_LIST: {
+            str.concat('[');
+            ConstListIterator li(v.get<const QoreListNode>());
+            while (li.next()) {
+                if (li.index()) {
+                    str.concat(',');
+                }
+                if (serialize(str, li.getValue(), xsink)) {
+                    return -1;
+                }
+            }
+            str.concat(']');
+            return 0;
+        }
+        default:
+            break;
+    }
+    xsink->raiseException("SQLITE3-JSON-ERROR", "cannot serialize type '%s' as JSON", v.getTypeName());
+    return -1;
+}
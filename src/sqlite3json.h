@@ -0,0 +1,62 @@
+/*
+  sqlite3json.h
+
+  Qore Programming Language
+
+  Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SQLITE3JSON_H
+#define SQLITE3JSON_H
+
+#include <qore/Qore.h>
+
+/*! \brief Converts JSON text to and from Qore values for columns declared as \c JSON.
+
+    Text is parsed in place from the buffer returned by SQLite and values are serialized directly into the buffer
+    that is bound, so no intermediate Qore strings are created in either direction.
+*/
+class QoreSqlite3Json {
+public:
+    /*! \brief Parses JSON text.
+
+        Objects are returned as hashes, arrays as lists, integers as \c int (or \c number if they do not fit in 64
+        bits), other numbers as \c float and \c null as \c NOTHING.
+
+        \param text the UTF-8 text to parse
+        \param len the length of the text in bytes
+        \param rv the parsed value on success
+
+        \retval bool true if the text is a single valid JSON value, false if not, in which case \a rv is not set
+    */
+    DLLLOCAL static bool parse(const char* text, size_t len, QoreValue& rv);
+
+    /*! \brief Appends the JSON representation of a value to a string.
+
+        Strings are converted to UTF-8, dates are serialized as ISO-8601 strings, binary values as base64 strings
+        and non-finite floats as \c null.
+
+        \param str the string to append to
+        \param v the value to serialize
+        \param xsink exception handler
+
+        \retval int 0 on success, -1 if the value contains a type that cannot be serialized
+    */
+    DLLLOCAL static int serialize(QoreString& str, const QoreValue v, ExceptionSink* xsink);
+};
+
+#endif
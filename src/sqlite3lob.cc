@@ -0,0 +1,198 @@
+/*
+    sqlite3lob.cc
+
+    Qore Programming Language
+
+    Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "sqlite3lob.h"
+#include "sqlite3executor.h"
+#include "config.h"
+
+#include <strings.h>
+
+// qore_lob_read(db, table, column, rowid [, offset [, length]])
+static void qore_lob_read(sqlite3_context* ctx, int argc, sqlite3_value** argv) {
+    for (int i = 0; i < 4; ++i) {
+        if (sqlite3_value_type(argv[i]) == SQLITE_NULL) {
+            sqlite3_result_null(ctx);
+            return;
+        }
+    }
+    sqlite3* db = sqlite3_context_db_handle(ctx);
+    sqlite3_int64 offset = argc > 4 ? sqlite3_value_int64(argv[4]) : 0;
+    sqlite3_int64 length = argc > 5 && sqlite3_value_type(argv[5]) != SQLITE_NULL
+        ? sqlite3_value_int64(argv[5]) : -1;
+
+    sqlite3_blob* blob;
+    int rc = sqlite3_blob_open(db, (const char*)sqlite3_value_text(argv[0]), (const char*)sqlite3_value_text(argv[1]),
+        (const char*)sqlite3_value_text(argv[2]), sqlite3_value_int64(argv[3]), 0, &blob);
+    if (rc != SQLITE_OK) {
+        sqlite3_result_error(ctx, sqlite3_errmsg(db), -1);
+        return;
+    }
+    ON_BLOCK_EXIT(sqlite3_blob_close, blob);
+
+    sqlite3_int64 size = sqlite3_blob_bytes(blob);
+    if (offset < 0 || offset > size) {
+        sqlite3_result_error(ctx, SQLITE3_LOB_READ_FUNC "(): offset out of range", -1);
+        return;
+    }
+    if (length < 0 || length > size - offset) {
+        length = size - offset;
+    }
+
+    void* buf = sqlite3_malloc64(length ? length : 1);
+    if (!buf) {
+        sqlite3_result_error_nomem(ctx);
+        return;
+    }
+    rc = sqlite3_blob_read(blob, buf, (int)length, (int)offset);
+    if (rc != SQLITE_OK) {
+        sqlite3_free(buf);
+        sqlite3_result_error_code(ctx, rc);
+        return;
+    }
+    sqlite3_result_blob(ctx, buf, (int)length, sqlite3_free);
+}
+
+int QoreSqlite3LobColumns::registerFunctions(sqlite3* db) {
+    int flags = SQLITE_UTF8 | SQLITE_DIRECTONLY;
+    for (int n = 4; n <= 6; ++n) {
+        int rc = sqlite3_create_function_v2(db, SQLITE3_LOB_READ_FUNC, n, flags, nullptr, qore_lob_read, nullptr,
+            nullptr, nullptr);
+        if (rc != SQLITE_OK) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+#ifdef HAVE_SQLITE3_COLUMN_METADATA
+bool QoreSqlite3LobColumns::isSupported() {
+    return true;
+}
+
+static bool is_rowid_name(const char* name) {
+    return !strcasecmp(name, "rowid") || !strcasecmp(name, "oid") || !strcasecmp(name, "_rowid_");
+}
+
+// returns the name of the INTEGER PRIMARY KEY column of a rowid table, an empty string if it has none, or -1 if the
+// table has no rowid and its values cannot be read incrementally
+static int get_rowid_alias(sqlite3* db, const char* dbname, const char* table, std::string& alias) {
+    // fails for WITHOUT ROWID tables
+    const char* type;
+    if (sqlite3_table_column_metadata(db, dbname, table, "rowid", &type, nullptr, nullptr, nullptr, nullptr)
+        != SQLITE_OK) {
+        return -1;
+    }
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "select name, type from pragma_table_info(?1, ?2) where pk > 0", -1, &stmt, nullptr)
+        != SQLITE_OK) {
+        return -1;
+    }
+    ON_BLOCK_EXIT(sqlite3_finalize, stmt);
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, dbname, -1, SQLITE_STATIC);
+
+    int pks = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        if (!pks++ && !strcasecmp((const char*)sqlite3_column_text(stmt, 1), "integer")) {
+            alias = (const char*)sqlite3_column_text(stmt, 0);
+        }
+    }
+    // a composite primary key is not a rowid alias
+    if (pks != 1) {
+        alias.clear();
+    }
+    return 0;
+}
+
+QoreSqlite3LobColumns::QoreSqlite3LobColumns(sqlite3* db, sqlite3_stmt* stmt, int64 threshold)
+        : threshold(threshold) {
+    int n = sqlite3_column_count(stmt);
+    cols.resize(n);
+    for (int i = 0; i < n; ++i) {
+        const char* dbname = sqlite3_column_database_name(stmt, i);
+        const char* table = sqlite3_column_table_name(stmt, i);
+        const char* column = sqlite3_column_origin_name(stmt, i);
+        // expressions have no origin
+        if (dbname && table && column) {
+            cols[i].db = dbname;
+            cols[i].table = table;
+            cols[i].column = column;
+        }
+    }
+
+    // find the rowid column of each origin table in the result
+    for (int i = 0; i < n; ++i) {
+        Column& c = cols[i];
+        if (c.table.empty() || c.rowid_index != -1) {
+            continue;
+        }
+        // columns of tables without a rowid in the result are marked with -2 so that they are not checked again
+        int rowid_index = -2;
+        std::string alias;
+        if (!get_rowid_alias(db, c.db.c_str(), c.table.c_str(), alias)) {
+            for (int j = 0; j < n; ++j) {
+                const Column& r = cols[j];
+                if (r.table == c.table && r.db == c.db && (is_rowid_name(r.column.c_str())
+                    || (!alias.empty() && !strcasecmp(r.column.c_str(), alias.c_str())))) {
+                    rowid_index = j;
+                    break;
+                }
+            }
+        }
+        for (int j = i; j < n; ++j) {
+            if (cols[j].table == c.table && cols[j].db == c.db) {
+                cols[j].rowid_index = rowid_index;
+            }
+        }
+    }
+}
+#else
+bool QoreSqlite3LobColumns::isSupported() {
+    return false;
+}
+
+QoreSqlite3LobColumns::QoreSqlite3LobColumns(sqlite3* db, sqlite3_stmt* stmt, int64 threshold)
+        : cols(sqlite3_column_count(stmt)), threshold(threshold) {
+}
+#endif
+
+QoreValue QoreSqlite3LobColumns::columnValue(sqlite3_stmt* stmt, int index, ExceptionSink* xsink) const {
+    const Column& c = cols[index];
+    if (c.rowid_index >= 0) {
+        int type = sqlite3_column_type(stmt, index);
+        if (type == SQLITE_TEXT || type == SQLITE_BLOB) {
+            int64 size = sqlite3_column_bytes(stmt, index);
+            if (size > threshold) {
+                QoreHashNode* h = new QoreHashNode(autoTypeInfo);
+                h->setKeyValue("lob", new QoreStringNode(type == SQLITE_TEXT ? "text" : "blob"), xsink);
+                h->setKeyValue("size", size, xsink);
+                h->setKeyValue("db", new QoreStringNode(c.db.c_str(), QCS_UTF8), xsink);
+                h->setKeyValue("table", new QoreStringNode(c.table.c_str(), QCS_UTF8), xsink);
+                h->setKeyValue("column", new QoreStringNode(c.column.c_str(), QCS_UTF8), xsink);
+                h->setKeyValue("rowid", (int64)sqlite3_column_int64(stmt, c.rowid_index), xsink);
+                return h;
+            }
+        }
+    }
+    return QoreSqlite3ExecBase::columnValue(stmt, index);
+}
@@ -0,0 +1,77 @@
+/*
+  sqlite3lob.h
+
+  Qore Programming Language
+
+  Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SQLITE3LOB_H
+#define SQLITE3LOB_H
+
+#include <sqlite3.h>
+#include <qore/Qore.h>
+
+#include <string>
+#include <vector>
+
+//! The name of the SQL function that reads TEXT and BLOB values incrementally
+#define SQLITE3_LOB_READ_FUNC "qore_lob_read"
+
+/*! \brief Returns large TEXT and BLOB column values as handles instead of copying them.
+
+    A column value is returned as a handle if it is larger than the threshold, its origin table and column are known
+    from the column metadata, and the rowid of its row is also in the result set, either as \c rowid or as the
+    table's \c INTEGER \c PRIMARY \c KEY column.  Other values are returned as usual.
+
+    Handles are hashes with the keys \c lob (\c "text" or \c "blob"), \c size, \c db, \c table, \c column and
+    \c rowid; the value is read with the \c qore_lob_read() SQL function, which uses incremental BLOB I/O.
+*/
+class QoreSqlite3LobColumns {
+public:
+    /*! \brief Sets up the columns of a prepared statement.
+
+        \param db the connection
+        \param stmt the prepared statement
+        \param threshold the size in bytes above which TEXT and BLOB values are returned as handles
+    */
+    DLLLOCAL QoreSqlite3LobColumns(sqlite3* db, sqlite3_stmt* stmt, int64 threshold);
+
+    //! Returns the value of a column of the current row, or a handle if it is a large TEXT or BLOB value
+    DLLLOCAL QoreValue columnValue(sqlite3_stmt* stmt, int index, ExceptionSink* xsink) const;
+
+    //! Returns true if the sqlite3 library provides the column metadata needed for handles
+    DLLLOCAL static bool isSupported();
+
+    //! Registers the qore_lob_read() SQL function on a connection
+    DLLLOCAL static int registerFunctions(sqlite3* db);
+
+private:
+    //! The origin of a result column
+    struct Column {
+        std::string db;
+        std::string table;
+        std::string column;
+        //! the index of the result column holding the rowid of the origin row; negative if none
+        int rowid_index = -1;
+    };
+
+    std::vector<Column> cols;
+    int64 threshold;
+};
+
+#endif
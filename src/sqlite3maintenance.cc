@@ -0,0 +1,246 @@
+/*
+    sqlite3maintenance.cc
+
+    Qore Programming Language
+
+    Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "sqlite3maintenance.h"
+#include "sqlite3background.h"
+#include "sqlite3module.h"
+
+typedef QoreSqlite3MaintenanceResult::clock maintenance_clock;
+
+// runs a statement returning a single integer value
+static int get_int(sqlite3* db, const char* sql, int64& v) {
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, 0);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    ON_BLOCK_EXIT(sqlite3_finalize, stmt);
+
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        v = sqlite3_column_int64(stmt, 0);
+        return SQLITE_OK;
+    }
+    v = 0;
+    return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+static int64 age_ms(maintenance_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(maintenance_clock::now() - t).count();
+}
+
+QoreHashNode* QoreSqlite3MaintenanceResult::getHash(ExceptionSink* xsink) const {
+    ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+    h->setKeyValue("runs", runs, xsink);
+    h->setKeyValue("busy", busy, xsink);
+    h->setKeyValue("errors", errors, xsink);
+    h->setKeyValue("vacuumed_pages", vacuumed_pages, xsink);
+    h->setKeyValue("vacuum_steps", vacuum_steps, xsink);
+    h->setKeyValue("duration_us", duration_us, xsink);
+    if (runs) {
+        h->setKeyValue("last_run_age_ms", age_ms(last_run), xsink);
+    }
+    if (optimized) {
+        h->setKeyValue("last_optimize_age_ms", age_ms(last_optimize), xsink);
+    }
+    if (!last_error.empty()) {
+        h->setKeyValue("last_error", new QoreStringNode(last_error.c_str()), xsink);
+    }
+    return h.release();
+}
+
+int QoreSqlite3Maintenance::run(sqlite3* db, const QoreSqlite3MaintenancePolicy& policy, int64 budget_ms,
+        QoreSqlite3MaintenanceResult& result) {
+    maintenance_clock::time_point start = maintenance_clock::now();
+    maintenance_clock::time_point deadline = start + std::chrono::milliseconds(budget_ms);
+
+    ++result.runs;
+    result.vacuumed_pages = 0;
+    result.vacuum_steps = 0;
+
+    int rc = SQLITE_OK;
+    {
+        // PRAGMA optimize is bounded by the analysis limit rather than by the time budget; the connection's own
+        // analysis limit is restored afterwards
+        int64 old_limit;
+        rc = get_int(db, "pragma analysis_limit", old_limit);
+        if (rc == SQLITE_OK) {
+            QoreString sql;
+            sql.sprintf("pragma analysis_limit = " QLLD "; pragma optimize; pragma analysis_limit = " QLLD,
+                policy.analysis_limit, old_limit);
+            rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+            if (rc == SQLITE_OK) {
+                result.optimized = true;
+                result.last_optimize = maintenance_clock::now();
+            }
+        }
+    }
+
+    if (rc == SQLITE_OK) {
+        int64 auto_vacuum;
+        rc = get_int(db, "pragma auto_vacuum", auto_vacuum);
+        // incremental_vacuum only works with auto_vacuum = incremental (2)
+        if (rc == SQLITE_OK && auto_vacuum == 2) {
+            QoreString sql;
+            sql.sprintf("pragma incremental_vacuum(" QLLD ")", policy.vacuum_pages);
+            int64 free_pages;
+            rc = get_int(db, "pragma freelist_count", free_pages);
+            while (rc == SQLITE_OK && free_pages > 0 && maintenance_clock::now() < deadline) {
+                rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+                if (rc != SQLITE_OK) {
+                    break;
+                }
+                ++result.vacuum_steps;
+                int64 new_free_pages;
+                rc = get_int(db, "pragma freelist_count", new_free_pages);
+                if (rc != SQLITE_OK || new_free_pages >= free_pages) {
+                    break;
+                }
+                result.vacuumed_pages += free_pages - new_free_pages;
+                free_pages = new_free_pages;
+            }
+        }
+    }
+
+    result.last_run = maintenance_clock::now();
+    result.duration_us = std::chrono::duration_cast<std::chrono::microseconds>(result.last_run - start).count();
+
+    switch (rc) {
+        case SQLITE_OK:
+            return 0;
+        case SQLITE_BUSY:
+        case SQLITE_LOCKED:
+            // another connection holds a lock; the next run will continue
+            ++result.busy;
+            return 0;
+        default:
+            ++result.errors;
+            result.last_error = sqlite3_errmsg(db);
+            return -1;
+    }
+}
+
+QoreHashNode* QoreSqlite3Maintenance::getState(sqlite3* db, ExceptionSink* xsink) {
+    static const char* auto_vacuum_modes[] = {"none", "full", "incremental"};
+
+    int64 page_count, free_pages, page_size, auto_vacuum, tables, analyzed_tables = 0, has_stat1;
+    if (get_int(db, "pragma page_count", page_count)
+        || get_int(db, "pragma freelist_count", free_pages)
+        || get_int(db, "pragma page_size", page_size)
+        || get_int(db, "pragma auto_vacuum", auto_vacuum)
+        || get_int(db, "select count(*) from sqlite_master where type = 'table' and name not like 'sqlite_%'",
+            tables)
+        || get_int(db, "select count(*) from sqlite_master where type = 'table' and name = 'sqlite_stat1'",
+            has_stat1)
+        || (has_stat1 && get_int(db, "select count(distinct tbl) from sqlite_stat1", analyzed_tables))) {
+        xsink->raiseException("SQLITE3-MAINTENANCE-ERROR", "failed to read the database state: %s",
+            sqlite3_errmsg(db));
+        return nullptr;
+    }
+
+    ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+    h->setKeyValue("page_count", page_count, xsink);
+    h->setKeyValue("free_pages", free_pages, xsink);
+    h->setKeyValue("page_size", page_size, xsink);
+    h->setKeyValue("auto_vacuum", new QoreStringNode(auto_vacuum >= 0 && auto_vacuum <= 2
+        ? auto_vacuum_modes[auto_vacuum] : "unknown"), xsink);
+    h->setKeyValue("tables", tables, xsink);
+    h->setKeyValue("analyzed_tables", analyzed_tables, xsink);
+    return h.release();
+}
+
+// opens a dedicated connection for Sqlite3::maintenance() and Sqlite3::maintenance_stats()
+static sqlite3* open_file(const char* filename, int flags, ExceptionSink* xsink) {
+    sqlite3* db = nullptr;
+    int rc = sqlite3_open_v2(filename, &db, flags
+        | (qore_sqlite3_open_flags & (SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_FULLMUTEX)), nullptr);
+    if (rc != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-MAINTENANCE-ERROR", "cannot open %s: %s", filename,
+            db ? sqlite3_errmsg(db) : sqlite3_errstr(rc));
+        sqlite3_close(db);
+        return nullptr;
+    }
+    return db;
+}
+
+QoreHashNode* QoreSqlite3Maintenance::runFile(const char* filename, const QoreHashNode* opts,
+        ExceptionSink* xsink) {
+    QoreSqlite3MaintenancePolicy policy;
+    if (opts) {
+        ConstHashIterator hi(opts);
+        while (hi.next()) {
+            const char* opt = hi.getKey();
+            int64* val;
+            if (!strcasecmp(opt, "budget")) {
+                val = &policy.budget_ms;
+            } else if (!strcasecmp(opt, "vacuum_pages")) {
+                val = &policy.vacuum_pages;
+            } else if (!strcasecmp(opt, "analysis_limit")) {
+                val = &policy.analysis_limit;
+            } else {
+                xsink->raiseException("SQLITE3-MAINTENANCE-ERROR", "unknown maintenance option '%s'", opt);
+                return nullptr;
+            }
+            *val = hi.get().getAsBigInt();
+            if (*val < 1) {
+                xsink->raiseException("SQLITE3-MAINTENANCE-ERROR", "option '%s' must be positive; got " QLLD, opt,
+                    *val);
+                return nullptr;
+            }
+        }
+    }
+
+    sqlite3* db = open_file(filename, SQLITE_OPEN_READWRITE, xsink);
+    if (!db) {
+        return nullptr;
+    }
+    ON_BLOCK_EXIT(sqlite3_close, db);
+
+    QoreSqlite3MaintenanceResult result;
+    if (run(db, policy, policy.budget_ms, result)) {
+        xsink->raiseException("SQLITE3-MAINTENANCE-ERROR", "maintenance failed: %s", result.last_error.c_str());
+        return nullptr;
+    }
+    return result.getHash(xsink);
+}
+
+QoreHashNode* QoreSqlite3Maintenance::getFileStats(const char* filename, ExceptionSink* xsink) {
+    sqlite3* db = open_file(filename, SQLITE_OPEN_READONLY, xsink);
+    if (!db) {
+        return nullptr;
+    }
+    ON_BLOCK_EXIT(sqlite3_close, db);
+
+    ReferenceHolder<QoreHashNode> h(getState(db, xsink), xsink);
+    if (!h) {
+        return nullptr;
+    }
+    QoreSqlite3BackgroundWorker* bg = QoreSqlite3BackgroundWorker::find(db);
+    if (bg) {
+        ON_BLOCK_EXIT_OBJ(*bg, &QoreSqlite3BackgroundWorker::deref);
+        QoreHashNode* stats = bg->getMaintenanceStats(xsink);
+        if (stats) {
+            h->setKeyValue("background", stats, xsink);
+        }
+    }
+    return h.release();
+}
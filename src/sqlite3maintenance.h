@@ -0,0 +1,112 @@
+/*
+  sqlite3maintenance.h
+
+  Qore Programming Language
+
+  Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SQLITE3MAINTENANCE_H
+#define SQLITE3MAINTENANCE_H
+
+#include <sqlite3.h>
+#include <qore/Qore.h>
+
+#include <chrono>
+#include <string>
+
+//! Database maintenance policy
+struct QoreSqlite3MaintenancePolicy {
+    //! run maintenance in the background this often (0 = no background maintenance)
+    int64 interval_ms = 0;
+    //! the time budget for a single maintenance run
+    int64 budget_ms = 100;
+    //! the number of pages freed by each incremental_vacuum step
+    int64 vacuum_pages = 100;
+    //! the analysis_limit used for PRAGMA optimize
+    int64 analysis_limit = 400;
+};
+
+//! Results of maintenance runs
+struct QoreSqlite3MaintenanceResult {
+    typedef std::chrono::steady_clock clock;
+
+    //! the number of runs
+    int64 runs = 0;
+    //! the number of runs that stopped because the database was locked
+    int64 busy = 0;
+    //! the number of runs that failed
+    int64 errors = 0;
+    //! the pages freed and vacuum steps taken by the last run
+    int64 vacuumed_pages = 0;
+    int64 vacuum_steps = 0;
+    //! the duration of the last run in microseconds
+    int64 duration_us = 0;
+    //! the end of the last run and of the last PRAGMA optimize
+    clock::time_point last_run;
+    clock::time_point last_optimize;
+    bool optimized = false;
+    //! the message of the last error
+    std::string last_error;
+
+    //! Returns the results as a hash
+    DLLLOCAL QoreHashNode* getHash(ExceptionSink* xsink) const;
+};
+
+/*! \brief Time-boxed database maintenance.
+
+    A run first executes PRAGMA optimize with the configured analysis_limit, so query plan statistics are kept
+    current, and then frees pages with PRAGMA incremental_vacuum(N) steps until the free list is empty or the time
+    budget is used up.  Each step is a short transaction of its own when run in autocommit mode, so other
+    connections are only ever blocked for one step.
+*/
+class QoreSqlite3Maintenance {
+public:
+    /*! \brief Runs a single maintenance pass.
+
+        \param db the connection to use
+        \param policy the maintenance policy
+        \param budget_ms the time budget in milliseconds
+        \param result updated with the results of the run
+
+        \retval int 0 on success, -1 on error (the error is stored in \a result)
+    */
+    DLLLOCAL static int run(sqlite3* db, const QoreSqlite3MaintenancePolicy& policy, int64 budget_ms,
+            QoreSqlite3MaintenanceResult& result);
+
+    /*! \brief Returns the current maintenance state of the main database.
+        Includes page and free page counts, the auto_vacuum mode and how many tables have optimizer statistics.
+    */
+    DLLLOCAL static QoreHashNode* getState(sqlite3* db, ExceptionSink* xsink);
+
+    /*! \brief Runs a single maintenance pass on a database file with a dedicated connection.
+
+        Implements Sqlite3::maintenance(); \a opts may contain \c budget, \c vacuum_pages and \c analysis_limit.
+
+        \retval QoreHashNode* the results of the pass; nullptr if an exception was raised
+    */
+    DLLLOCAL static QoreHashNode* runFile(const char* filename, const QoreHashNode* opts, ExceptionSink* xsink);
+
+    /*! \brief Returns the maintenance state of a database file.
+
+        Implements Sqlite3::maintenance_stats(); the results of background passes are included if background
+        maintenance is enabled for the file in this process.
+    */
+    DLLLOCAL static QoreHashNode* getFileStats(const char* filename, ExceptionSink* xsink);
+};
+
+#endif
@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <errno.h>
 #include <strings.h>
 
 #include <qore/Qore.h>
@@ -31,6 +32,12 @@
 #include "sqlite3module.h"
 #include "sqlite3connection.h"
 #include "sqlite3executor.h"
+#include "sqlite3parallel.h"
+#include "sqlite3arrow.h"
+#include "sqlite3async.h"
+#include "sqlite3import.h"
+#include "sqlite3fts.h"
+#include "sqlite3maintenance.h"
 #include "config.h"
 
 #ifndef QORE_MONOLITHIC
@@ -50,17 +57,59 @@ DLLEXPORT char qore_module_license_str[] = "MIT";
 
 DBIDriver* DBID_SQLITE3 = nullptr;
 
-// this is the thread key that will tell us if the current thread has been initialized for sqlite threading
-static pthread_key_t ptk_sqlite3;
+//! The Sqlite3 namespace with the module's functions; copied into each Program
+static QoreNamespace* Sqlite3NS = nullptr;
 
-static inline void checkInit() {
-    if (!pthread_getspecific(ptk_sqlite3)) {
-        pthread_setspecific(ptk_sqlite3, (void*)1);
+int qore_sqlite3_open_flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+
+//! True if the library keeps memory usage statistics, as determined when the module is initialized
+static bool qore_sqlite3_memstatus = true;
+
+int qore_sqlite3_prepare(sqlite3* db, const char* sql, int len, unsigned flags, sqlite3_stmt** stmt,
+        const char** tail) {
+#ifdef HAVE_SQLITE3_PREPARE_V3
+    return sqlite3_prepare_v3(db, sql, len, flags, stmt, tail);
+#else
+    return sqlite3_prepare_v2(db, sql, len, stmt, tail);
+#endif
+}
+
+std::string qore_sqlite3_quote_identifier(const std::string& name) {
+    std::string rv = "\"";
+    for (char c : name) {
+        if (c == '"') {
+            rv += '"';
+        }
+        rv += c;
     }
+    rv += '"';
+    return rv;
 }
 
-static void sqlite3_thread_cleanup(void *unused) {
-//     if (pthread_getspecific(ptk_sqlite3))
+// follows the rules in section 3.1 of https://www.sqlite.org/datatype3.html
+int qore_sqlite3_get_affinity(const char* decl) {
+    if (!decl || !*decl) {
+        return QORE_SQLITE3_AFF_BLOB;
+    }
+    std::string type(decl);
+    for (char& c : type) {
+        c = toupper(c);
+    }
+    if (type.find("INT") != std::string::npos) {
+        return QORE_SQLITE3_AFF_INTEGER;
+    }
+    if (type.find("CHAR") != std::string::npos || type.find("CLOB") != std::string::npos
+        || type.find("TEXT") != std::string::npos) {
+        return QORE_SQLITE3_AFF_TEXT;
+    }
+    if (type.find("BLOB") != std::string::npos) {
+        return QORE_SQLITE3_AFF_BLOB;
+    }
+    if (type.find("REAL") != std::string::npos || type.find("FLOA") != std::string::npos
+        || type.find("DOUB") != std::string::npos) {
+        return QORE_SQLITE3_AFF_REAL;
+    }
+    return QORE_SQLITE3_AFF_NUMERIC;
 }
 
 static sqlite3* qore_sqlite3_init(Datasource* ds, ExceptionSink* xsink) {
@@ -74,73 +123,164 @@ static sqlite3* qore_sqlite3_init(Datasource* ds, ExceptionSink* xsink) {
     ds->setQoreEncoding("utf8");
 
     sqlite3 *db;
-    int ret = sqlite3_open(ds->getDBName(), &db);
-    if (ret != SQLITE_OK) {
-        xsink->raiseException("SQLITE3-CONNECT-ERROR", "cannot open %s", ds->getDBName());
+    int ret = sqlite3_open_v2(ds->getDBName(), &db, qore_sqlite3_open_flags, nullptr);
+    if (!db) {
+        xsink->outOfMemory();
         return nullptr;
     }
 
-    if (!db) {
-        xsink->outOfMemory();
+    if (ret != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-CONNECT-ERROR", "cannot open %s: %s", ds->getDBName(), sqlite3_errmsg(db));
+        sqlite3_close(db);
         return nullptr;
     }
 
     return db;
 }
 
+// passes committed changes to the "change-events" callback after a call that may have committed a transaction
+static QoreValue deliver_changes(QoreSqlite3Connection* d, QoreValue rv, ExceptionSink* xsink) {
+    if (!*xsink && d->deliverChanges(xsink)) {
+        rv.discard(xsink);
+        return QoreValue();
+    }
+    return rv;
+}
+
 static int qore_sqlite3_commit(Datasource* ds, ExceptionSink* xsink) {
-    checkInit();
     QoreSqlite3Connection* d =(QoreSqlite3Connection*)ds->getPrivateData();
-    return d->commit(xsink) ? 0 : -1;
+    if (!d->commit(xsink)) {
+        return -1;
+    }
+    return d->deliverChanges(xsink);
 }
 
 static int qore_sqlite3_rollback(Datasource* ds, ExceptionSink* xsink) {
-    checkInit();
     QoreSqlite3Connection* d =(QoreSqlite3Connection*)ds->getPrivateData();
     return d->rollback(xsink) ? 0 : -1;
 }
 
 static QoreValue qore_sqlite3_select_rows(Datasource* ds, const QoreString* qstr, const QoreListNode *args,
         ExceptionSink* xsink) {
-    checkInit();
     QoreSqlite3Connection* d = (QoreSqlite3Connection*)ds->getPrivateData();
+    QoreSqlite3CachedQuery cq(d->getResultCache(), 'r', qstr, args, d->getNativeBinding(), xsink);
+    if (cq.hit()) {
+        return cq.getResult();
+    }
     QoreSqlite3Executor exec(d->handler(), d->getEncoding(), xsink);
-    return exec.select_rows(ds, qstr, args, xsink);
+    exec.setPrepareFlags(d->getPrepareFlags());
+    exec.setNativeBinding(d->getNativeBinding());
+    // the tables read by the query are captured when it is prepared
+    exec.setStatementCache(cq.capturing() ? nullptr : d->getStatementCache());
+    exec.setEpochDates(d->getEpochDates());
+    exec.setConversions(d->getConversions());
+    exec.setLobThreshold(d->getLobThreshold());
+    return deliver_changes(d, cq.store(exec.select_rows(ds, qstr, args, xsink), xsink), xsink);
+}
+
+static QoreHashNode* qore_sqlite3_select_row(Datasource* ds, const QoreString* qstr, const QoreListNode *args,
+        ExceptionSink* xsink) {
+    QoreSqlite3Connection* d = (QoreSqlite3Connection*)ds->getPrivateData();
+    QoreSqlite3CachedQuery cq(d->getResultCache(), '1', qstr, args, d->getNativeBinding(), xsink);
+    if (cq.hit()) {
+        return cq.getResult().get<QoreHashNode>();
+    }
+    QoreSqlite3Executor exec(d->handler(), d->getEncoding(), xsink);
+    exec.setPrepareFlags(d->getPrepareFlags());
+    exec.setNativeBinding(d->getNativeBinding());
+    exec.setStatementCache(cq.capturing() ? nullptr : d->getStatementCache());
+    exec.setEpochDates(d->getEpochDates());
+    exec.setConversions(d->getConversions());
+    exec.setLobThreshold(d->getLobThreshold());
+    return deliver_changes(d, cq.store(exec.select_row(ds, qstr, args, xsink), xsink), xsink).get<QoreHashNode>();
 }
 
 static QoreValue qore_sqlite3_select(Datasource* ds, const QoreString* qstr, const QoreListNode* args,
     ExceptionSink* xsink) {
-    checkInit();
     QoreSqlite3Connection* d = (QoreSqlite3Connection*)ds->getPrivateData();
+    QoreSqlite3CachedQuery cq(d->getResultCache(), 's', qstr, args, d->getNativeBinding(), xsink);
+    if (cq.hit()) {
+        return cq.getResult();
+    }
     QoreSqlite3Executor exec(d->handler(), d->getEncoding(), xsink);
-    return exec.select(ds, qstr, args, xsink);
+    exec.setPrepareFlags(d->getPrepareFlags());
+    exec.setNativeBinding(d->getNativeBinding());
+    exec.setStatementCache(cq.capturing() ? nullptr : d->getStatementCache());
+    exec.setEpochDates(d->getEpochDates());
+    exec.setConversions(d->getConversions());
+    return deliver_changes(d, cq.store(exec.select(ds, qstr, args, xsink), xsink), xsink);
 }
 
 static QoreValue qore_sqlite3_exec(Datasource* ds, const QoreString* qstr, const QoreListNode *args,
         ExceptionSink* xsink) {
-    checkInit();
     QoreSqlite3Connection* d = (QoreSqlite3Connection*)ds->getPrivateData();
     QoreSqlite3Executor exec(d->handler(), d->getEncoding(), xsink);
-    return exec.exec(ds, qstr, args, xsink);
+    exec.setPrepareFlags(d->getPrepareFlags());
+    exec.setNativeBinding(d->getNativeBinding());
+    exec.setStatementCache(d->getStatementCache());
+    exec.setEpochDates(d->getEpochDates());
+    exec.setConversions(d->getConversions());
+    return deliver_changes(d, exec.exec(ds, qstr, args, xsink), xsink);
 }
 
 static QoreValue qore_sqlite3_exec_raw(Datasource* ds, const QoreString* qstr, ExceptionSink* xsink) {
-    checkInit();
     QoreSqlite3Connection* d = (QoreSqlite3Connection*)ds->getPrivateData();
     QoreSqlite3Executor exec(d->handler(), d->getEncoding(), xsink);
-    return exec.execRaw(ds, qstr, xsink);
+    exec.setPrepareFlags(d->getPrepareFlags());
+    exec.setNativeBinding(d->getNativeBinding());
+    exec.setStatementCache(d->getStatementCache());
+    exec.setEpochDates(d->getEpochDates());
+    exec.setConversions(d->getConversions());
+    return deliver_changes(d, exec.execRaw(ds, qstr, xsink), xsink);
 }
 
 static int qore_sqlite3_open_datasource(Datasource* ds, ExceptionSink* xsink) {
-// 	printf("open datasource\n");
-    checkInit();
-
     sqlite3* db = qore_sqlite3_init(ds, xsink);
     if (!db) {
         return -1;
     }
 
+    if (QoreSqlite3LobColumns::registerFunctions(db)) {
+        xsink->raiseException("SQLITE3-CONNECT-ERROR", "cannot register SQL functions: %s", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return -1;
+    }
+
     QoreSqlite3Connection* d_sqlite3 = new QoreSqlite3Connection(db, QEM.findCreate(ds->getOSEncoding()));
+    if (d_sqlite3->registerFunctions() != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-CONNECT-ERROR", "cannot register SQL functions: %s", sqlite3_errmsg(db));
+        d_sqlite3->close();
+        delete d_sqlite3;
+        return -1;
+    }
+
+    // process connection options
+    const QoreHashNode* opts = ds->getConnectOptions();
+    if (opts) {
+        ConstHashIterator hi(opts);
+        while (hi.next()) {
+            if (QoreSqlite3Connection::isCommandOption(hi.getKey())) {
+                xsink->raiseException("SQLITE3-OPTION-ERROR", "option '%s' runs an operation when set and cannot be "
+                    "used as a connection option", hi.getKey());
+                d_sqlite3->close();
+                delete d_sqlite3;
+                return -1;
+            }
+            if (d_sqlite3->setOption(hi.getKey(), hi.get(), xsink)) {
+                d_sqlite3->close();
+                delete d_sqlite3;
+                return -1;
+            }
+        }
+    }
+
+    // the warm-up runs after all options, so that it can read attached databases
+    if (d_sqlite3->warmUp(xsink)) {
+        d_sqlite3->close();
+        delete d_sqlite3;
+        return -1;
+    }
+
     ds->setPrivateData((void*)d_sqlite3);
 
     return 0;
@@ -149,7 +289,6 @@ static int qore_sqlite3_open_datasource(Datasource* ds, ExceptionSink* xsink) {
 static int qore_sqlite3_close_datasource(Datasource* ds) {
     QORE_TRACE("qore_sqlite3_close_datasource()");
 
-    checkInit();
     QoreSqlite3Connection* d = (QoreSqlite3Connection*)ds->getPrivateData();
 
     if (!d->close())
@@ -162,23 +301,38 @@ static int qore_sqlite3_close_datasource(Datasource* ds) {
 }
 
 static QoreValue qore_sqlite3_get_server_version(Datasource* ds, ExceptionSink* xsink) {
-    checkInit();
     QoreSqlite3Connection* d = (QoreSqlite3Connection*)ds->getPrivateData();
     return new QoreStringNode(d->getServerVersion());
 }
 
 static QoreValue qore_sqlite3_get_client_version(const Datasource* ds, ExceptionSink* xsink) {
-    checkInit();
     QoreSqlite3Connection* d = (QoreSqlite3Connection*)ds->getPrivateData();
     return new QoreStringNode(d->getServerVersion());
 }
 
 static int qore_sqlite3_begin_transaction(Datasource* ds, ExceptionSink* xsink) {
-    checkInit();
     QoreSqlite3Connection* d =(QoreSqlite3Connection*)ds->getPrivateData();
     return d->begin(xsink) ? 0 : -1;
 }
 
+static int qore_sqlite3_opt_set(Datasource* ds, const char* opt, const QoreValue val, ExceptionSink* xsink) {
+    QoreSqlite3Connection* d = (QoreSqlite3Connection*)ds->getPrivateData();
+    return d->setOption(opt, val, xsink);
+}
+
+static QoreValue qore_sqlite3_opt_get(const Datasource* ds, const char* opt) {
+    QoreSqlite3Connection* d = (QoreSqlite3Connection*)ds->getPrivateData();
+    // errors cannot be reported from this method, so getters must not have side effects or run operations that can
+    // fail in normal use; such operations are provided as functions in the Sqlite3 namespace instead
+    ExceptionSink xsink;
+    ValueHolder rv(d->getOption(opt, &xsink), &xsink);
+    if (xsink) {
+        xsink.clear();
+        return QoreValue();
+    }
+    return rv.release();
+}
+
 static int qore_sqlite3_stmt_prepare(SQLStatement* stmt, const QoreString& str, const QoreListNode* args,
         ExceptionSink* xsink) {
     assert(!stmt->getPrivateData());
@@ -280,9 +434,347 @@ static int qore_sqlite3_stmt_close(SQLStatement* stmt, ExceptionSink* xsink) {
     return *xsink ? -1 : 0;
 }
 
+// Sqlite3::parallel_select(string file, string table, *hash<auto> opts)
+static QoreValue f_sqlite3_parallel_select(const QoreListNode* args, q_rt_flags_t flags, ExceptionSink* xsink) {
+    const QoreStringNode* file = HARD_QORE_VALUE_STRING(args, 0);
+    const QoreStringNode* table = HARD_QORE_VALUE_STRING(args, 1);
+    const QoreHashNode* opts = get_param_value(args, 2).get<const QoreHashNode>();
+
+    TempEncodingHelper fn(file, QCS_UTF8, xsink);
+    if (*xsink) {
+        return QoreValue();
+    }
+    QoreSqlite3ParallelScan scan(fn->c_str());
+    if (scan.setOptions(opts, xsink)) {
+        return QoreValue();
+    }
+    return scan.run(*table, xsink);
+}
+
+//! Arrow type names for the "types" option of Sqlite3::export_arrow()
+static const struct {
+    const char* name;
+    QoreSqlite3ArrowType type;
+} arrow_types[] = {
+    {"int", SQLITE3_ARROW_INT64},
+    {"float", SQLITE3_ARROW_FLOAT64},
+    {"string", SQLITE3_ARROW_UTF8},
+    {"binary", SQLITE3_ARROW_BINARY},
+};
+
+// Sqlite3::export_arrow(string file, string sql, *hash<auto> opts)
+static QoreValue f_sqlite3_export_arrow(const QoreListNode* args, q_rt_flags_t flags, ExceptionSink* xsink) {
+    const QoreStringNode* file = HARD_QORE_VALUE_STRING(args, 0);
+    const QoreStringNode* sql = HARD_QORE_VALUE_STRING(args, 1);
+    const QoreHashNode* opts = get_param_value(args, 2).get<const QoreHashNode>();
+
+    const QoreListNode* bind_args = nullptr;
+    const QoreHashNode* types = nullptr;
+    const QoreStringNode* output = nullptr;
+    int64 batch = 65536;
+    if (opts) {
+        ConstHashIterator hi(opts);
+        while (hi.next()) {
+            const char* opt = hi.getKey();
+            const QoreValue v = hi.get();
+            qore_type_t expected;
+            if (!strcasecmp(opt, "args")) {
+                expected = NT_LIST;
+                bind_args = v.get<const QoreListNode>();
+            } else if (!strcasecmp(opt, "types")) {
+                expected = NT_HASH;
+                types = v.get<const QoreHashNode>();
+            } else if (!strcasecmp(opt, "output")) {
+                expected = NT_STRING;
+                output = v.get<const QoreStringNode>();
+            } else if (!strcasecmp(opt, "batch")) {
+                expected = NT_INT;
+                batch = v.getAsBigInt();
+                if (batch < 1) {
+                    xsink->raiseException("SQLITE3-EXPORT-ERROR", "option 'batch' must be positive; got " QLLD,
+                        batch);
+                    return QoreValue();
+                }
+            } else {
+                xsink->raiseException("SQLITE3-EXPORT-ERROR", "unknown option '%s'", opt);
+                return QoreValue();
+            }
+            if (v.getType() != expected) {
+                xsink->raiseException("SQLITE3-EXPORT-ERROR", "option '%s' got unexpected type '%s'", opt,
+                    v.getTypeName());
+                return QoreValue();
+            }
+        }
+    }
+
+    TempEncodingHelper fn(file, QCS_UTF8, xsink);
+    if (*xsink) {
+        return QoreValue();
+    }
+    sqlite3* db = nullptr;
+    int rc = sqlite3_open_v2(fn->c_str(), &db, SQLITE_OPEN_READONLY
+        | (qore_sqlite3_open_flags & (SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_FULLMUTEX)), nullptr);
+    ON_BLOCK_EXIT(sqlite3_close, db);
+    if (rc != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-EXPORT-ERROR", "cannot open %s: %s", fn->c_str(),
+            db ? sqlite3_errmsg(db) : sqlite3_errstr(rc));
+        return QoreValue();
+    }
+
+    TempEncodingHelper sql_utf8(sql, QCS_UTF8, xsink);
+    if (*xsink) {
+        return QoreValue();
+    }
+    QoreString statement(sql_utf8->c_str(), sql_utf8->size(), QCS_UTF8);
+    QoreSqlite3ExecBase binder(QCS_UTF8, new QoreListNode(autoTypeInfo));
+    if (binder.parseForBind(statement, bind_args, xsink)) {
+        return QoreValue();
+    }
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, statement.c_str(), statement.size() + 1, &stmt, nullptr) != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-EXPORT-ERROR", "%s", sqlite3_errmsg(db));
+        return QoreValue();
+    }
+    ON_BLOCK_EXIT(sqlite3_finalize, stmt);
+    if (binder.bindParameters(stmt, xsink)) {
+        return QoreValue();
+    }
+
+    // the stream is written to a file or returned as a binary value
+    FILE* fp = nullptr;
+    ReferenceHolder<BinaryNode> buf(xsink);
+    QoreSqlite3ArrowWriter writer(stmt, (size_t)batch, [&fp, &buf] (const void* data, size_t len) {
+        if (fp) {
+            return fwrite(data, 1, len, fp) == len ? 0 : -1;
+        }
+        buf->append(data, len);
+        return 0;
+    });
+
+    if (types) {
+        ConstHashIterator hi(types);
+        while (hi.next()) {
+            QoreStringValueHelper type(hi.get());
+            QoreSqlite3ArrowType t = SQLITE3_ARROW_AUTO;
+            for (const auto& i : arrow_types) {
+                if (!strcasecmp(type->c_str(), i.name)) {
+                    t = i.type;
+                    break;
+                }
+            }
+            if (t == SQLITE3_ARROW_AUTO) {
+                xsink->raiseException("SQLITE3-EXPORT-ERROR", "invalid type '%s' for column '%s'; expecting 'int', "
+                    "'float', 'string' or 'binary'", type->c_str(), hi.getKey());
+                return QoreValue();
+            }
+            if (writer.setType(hi.getKey(), t)) {
+                xsink->raiseException("SQLITE3-EXPORT-ERROR", "the result has no column '%s'", hi.getKey());
+                return QoreValue();
+            }
+        }
+    }
+
+    if (output) {
+        TempEncodingHelper path(output, QCS_UTF8, xsink);
+        if (*xsink) {
+            return QoreValue();
+        }
+        fp = fopen(path->c_str(), "wb");
+        if (!fp) {
+            xsink->raiseException("SQLITE3-EXPORT-ERROR", "cannot open '%s' for writing: %s", path->c_str(),
+                strerror(errno));
+            return QoreValue();
+        }
+    } else {
+        buf = new BinaryNode;
+    }
+
+    std::string err;
+    rc = writer.run(err);
+    if (fp && fclose(fp) && !rc) {
+        err = "cannot write the output";
+        rc = -1;
+    }
+    if (rc) {
+        xsink->raiseException("SQLITE3-EXPORT-ERROR", "%s", err.c_str());
+        return QoreValue();
+    }
+    if (fp) {
+        return writer.getRows();
+    }
+    return buf.release();
+}
+
+// Sqlite3::import_csv(string file, string table, data input, *hash<auto> opts)
+static QoreValue f_sqlite3_import_csv(const QoreListNode* args, q_rt_flags_t flags, ExceptionSink* xsink) {
+    const QoreStringNode* file = HARD_QORE_VALUE_STRING(args, 0);
+    const QoreStringNode* table = HARD_QORE_VALUE_STRING(args, 1);
+    QoreValue input = get_param_value(args, 2);
+    const QoreHashNode* opts = get_param_value(args, 3).get<const QoreHashNode>();
+
+    TempEncodingHelper path(file, QCS_UTF8, xsink);
+    if (*xsink) {
+        return QoreValue();
+    }
+
+    QoreSqlite3Import import(path->c_str());
+    if (import.setOptions(opts, xsink)) {
+        return QoreValue();
+    }
+    int64 rows = import.run(*table, input, xsink);
+    return *xsink ? QoreValue() : QoreValue(rows);
+}
+
+// Sqlite3::async_select(string file, string sql, *hash<auto> opts)
+static QoreValue f_sqlite3_async_select(const QoreListNode* args, q_rt_flags_t flags, ExceptionSink* xsink) {
+    const QoreStringNode* file = HARD_QORE_VALUE_STRING(args, 0);
+    const QoreStringNode* sql = HARD_QORE_VALUE_STRING(args, 1);
+    const QoreHashNode* opts = get_param_value(args, 2).get<const QoreHashNode>();
+
+    TempEncodingHelper path(file, QCS_UTF8, xsink);
+    if (*xsink) {
+        return QoreValue();
+    }
+    int64 id = QoreSqlite3AsyncQuery::start(path->c_str(), *sql, opts, xsink);
+    return *xsink ? QoreValue() : QoreValue(id);
+}
+
+// Sqlite3::async_poll(int id)
+static QoreValue f_sqlite3_async_poll(const QoreListNode* args, q_rt_flags_t flags, ExceptionSink* xsink) {
+    QoreSqlite3AsyncQuery* q = QoreSqlite3AsyncQuery::find(HARD_QORE_VALUE_INT(args, 0), xsink);
+    if (!q) {
+        return QoreValue();
+    }
+    ON_BLOCK_EXIT_OBJ(*q, &QoreSqlite3AsyncQuery::deref);
+    return q->poll(xsink);
+}
+
+// Sqlite3::async_wait(int id, *int timeout_ms)
+static QoreValue f_sqlite3_async_wait(const QoreListNode* args, q_rt_flags_t flags, ExceptionSink* xsink) {
+    QoreSqlite3AsyncQuery* q = QoreSqlite3AsyncQuery::find(HARD_QORE_VALUE_INT(args, 0), xsink);
+    if (!q) {
+        return QoreValue();
+    }
+    ON_BLOCK_EXIT_OBJ(*q, &QoreSqlite3AsyncQuery::deref);
+    QoreValue timeout = get_param_value(args, 1);
+    return q->wait(timeout.isNothing() ? -1 : timeout.getAsBigInt());
+}
+
+// Sqlite3::async_fetch(int id)
+static QoreValue f_sqlite3_async_fetch(const QoreListNode* args, q_rt_flags_t flags, ExceptionSink* xsink) {
+    QoreSqlite3AsyncQuery* q = QoreSqlite3AsyncQuery::find(HARD_QORE_VALUE_INT(args, 0), xsink);
+    if (!q) {
+        return QoreValue();
+    }
+    ON_BLOCK_EXIT_OBJ(*q, &QoreSqlite3AsyncQuery::deref);
+    return q->fetch(xsink);
+}
+
+// Sqlite3::async_cancel(int id)
+static QoreValue f_sqlite3_async_cancel(const QoreListNode* args, q_rt_flags_t flags, ExceptionSink* xsink) {
+    QoreSqlite3AsyncQuery* q = QoreSqlite3AsyncQuery::find(HARD_QORE_VALUE_INT(args, 0), xsink);
+    if (q) {
+        q->cancel();
+        q->deref();
+    }
+    return QoreValue();
+}
+
+// Sqlite3::async_close(int id)
+static QoreValue f_sqlite3_async_close(const QoreListNode* args, q_rt_flags_t flags, ExceptionSink* xsink) {
+    QoreSqlite3AsyncQuery::close(HARD_QORE_VALUE_INT(args, 0), xsink);
+    return QoreValue();
+}
+
+// Sqlite3::library_config()
+static QoreValue f_sqlite3_library_config(const QoreListNode* args, q_rt_flags_t flags, ExceptionSink* xsink) {
+    ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+    h->setKeyValue("version", new QoreStringNode(sqlite3_libversion()), xsink);
+    h->setKeyValue("threadsafe", sqlite3_threadsafe(), xsink);
+    h->setKeyValue("fullmutex", (bool)(qore_sqlite3_open_flags & SQLITE_OPEN_FULLMUTEX), xsink);
+    h->setKeyValue("memstatus", qore_sqlite3_memstatus, xsink);
+    return h.release();
+}
+
+// Sqlite3::maintenance(string file, *hash<auto> opts)
+static QoreValue f_sqlite3_maintenance(const QoreListNode* args, q_rt_flags_t flags, ExceptionSink* xsink) {
+    const QoreStringNode* file = HARD_QORE_VALUE_STRING(args, 0);
+    const QoreHashNode* opts = get_param_value(args, 1).get<const QoreHashNode>();
+
+    TempEncodingHelper path(file, QCS_UTF8, xsink);
+    if (*xsink) {
+        return QoreValue();
+    }
+    return QoreSqlite3Maintenance::runFile(path->c_str(), opts, xsink);
+}
+
+// Sqlite3::maintenance_stats(string file)
+static QoreValue f_sqlite3_maintenance_stats(const QoreListNode* args, q_rt_flags_t flags, ExceptionSink* xsink) {
+    TempEncodingHelper path(HARD_QORE_VALUE_STRING(args, 0), QCS_UTF8, xsink);
+    if (*xsink) {
+        return QoreValue();
+    }
+    return QoreSqlite3Maintenance::getFileStats(path->c_str(), xsink);
+}
+
+// Sqlite3::fts_create_index(string file, hash<auto> opts)
+static QoreValue f_sqlite3_fts_create_index(const QoreListNode* args, q_rt_flags_t flags, ExceptionSink* xsink) {
+    TempEncodingHelper path(HARD_QORE_VALUE_STRING(args, 0), QCS_UTF8, xsink);
+    if (*xsink) {
+        return QoreValue();
+    }
+    QoreSqlite3Fts::createIndex(path->c_str(), HARD_QORE_VALUE_HASH(args, 1), xsink);
+    return QoreValue();
+}
+
+// Sqlite3::fts_drop_index(string file, string name)
+static QoreValue f_sqlite3_fts_drop_index(const QoreListNode* args, q_rt_flags_t flags, ExceptionSink* xsink) {
+    TempEncodingHelper path(HARD_QORE_VALUE_STRING(args, 0), QCS_UTF8, xsink);
+    if (*xsink) {
+        return QoreValue();
+    }
+    QoreSqlite3Fts::dropIndex(path->c_str(), *HARD_QORE_VALUE_STRING(args, 1), xsink);
+    return QoreValue();
+}
+
+// Sqlite3::fts_indexes(string file)
+static QoreValue f_sqlite3_fts_indexes(const QoreListNode* args, q_rt_flags_t flags, ExceptionSink* xsink) {
+    TempEncodingHelper path(HARD_QORE_VALUE_STRING(args, 0), QCS_UTF8, xsink);
+    if (*xsink) {
+        return QoreValue();
+    }
+    return QoreSqlite3Fts::getIndexes(path->c_str(), xsink);
+}
+
+// Sqlite3::fts_search_sql(string index, *hash<auto> opts)
+static QoreValue f_sqlite3_fts_search_sql(const QoreListNode* args, q_rt_flags_t flags, ExceptionSink* xsink) {
+    const QoreStringNode* index = HARD_QORE_VALUE_STRING(args, 0);
+    const QoreHashNode* opts = get_param_value(args, 1).get<const QoreHashNode>();
+    return QoreSqlite3Fts::getSearchSql(*index, opts, xsink);
+}
+
 QoreStringNode* qore_sqlite3_module_init() {
-    pthread_key_create(&ptk_sqlite3, NULL);
-    tclist.push(sqlite3_thread_cleanup, NULL);
+    if (!sqlite3_threadsafe()) {
+        return new QoreStringNode("the sqlite3 library was built without thread support (SQLITE_THREADSAFE=0) and "
+            "cannot be used by the sqlite3 driver");
+    }
+
+    // the DBI layer guarantees that a connection is only used by one thread at a time, so by default the driver's
+    // connections are opened without the library's per-connection mutex; the library's global threading mode is
+    // left unchanged, as it applies to all users of the library in the process
+#ifdef SQLITE3_SERIALIZED
+    qore_sqlite3_open_flags |= SQLITE_OPEN_FULLMUTEX;
+#else
+    qore_sqlite3_open_flags |= SQLITE_OPEN_NOMUTEX;
+#endif
+    qore_sqlite3_memstatus = !sqlite3_compileoption_used("DEFAULT_MEMSTATUS=0");
+#ifndef SQLITE3_MEMSTATUS
+    // memory statistics take a global mutex on every allocation; sqlite3_config() fails with SQLITE_MISUSE if the
+    // library has already been initialized in this process, in which case the statistics stay as they are
+    if (sqlite3_config(SQLITE_CONFIG_MEMSTATUS, 0) == SQLITE_OK) {
+        qore_sqlite3_memstatus = false;
+    }
+#endif
 
     // populate the method list structure with the method pointers
     qore_dbi_method_list methods;
@@ -290,6 +782,7 @@ QoreStringNode* qore_sqlite3_module_init() {
     methods.add(QDBI_METHOD_CLOSE,                  qore_sqlite3_close_datasource);
     methods.add(QDBI_METHOD_SELECT,                 qore_sqlite3_select);
     methods.add(QDBI_METHOD_SELECT_ROWS,            qore_sqlite3_select_rows);
+    methods.add(QDBI_METHOD_SELECT_ROW,             qore_sqlite3_select_row);
     methods.add(QDBI_METHOD_EXEC,                   qore_sqlite3_exec);
 #ifdef _QORE_HAS_DBI_EXECRAW
     methods.add(QDBI_METHOD_EXECRAW,                qore_sqlite3_exec_raw);
@@ -299,6 +792,8 @@ QoreStringNode* qore_sqlite3_module_init() {
     methods.add(QDBI_METHOD_GET_SERVER_VERSION,     qore_sqlite3_get_server_version);
     methods.add(QDBI_METHOD_GET_CLIENT_VERSION,     qore_sqlite3_get_client_version);
     methods.add(QDBI_METHOD_BEGIN_TRANSACTION,      qore_sqlite3_begin_transaction);
+    methods.add(QDBI_METHOD_OPT_SET,                qore_sqlite3_opt_set);
+    methods.add(QDBI_METHOD_OPT_GET,                qore_sqlite3_opt_get);
 
     methods.add(QDBI_METHOD_STMT_PREPARE,           qore_sqlite3_stmt_prepare);
     methods.add(QDBI_METHOD_STMT_PREPARE_RAW,       qore_sqlite3_stmt_prepare_raw);
@@ -317,29 +812,162 @@ QoreStringNode* qore_sqlite3_module_init() {
     methods.add(QDBI_METHOD_STMT_GET_OUTPUT,        qore_sqlite3_stmt_get_output);
     methods.add(QDBI_METHOD_STMT_GET_OUTPUT_ROWS,   qore_sqlite3_stmt_get_output_rows);
 
+    methods.registerOption(SQLITE3_OPT_CHECKPOINT, "set to 'passive', 'restart' or 'truncate' to run WAL "
+        "checkpoints with the given mode in a background thread with a dedicated connection instead of "
+        "automatically on the committing connection; 'off' (the default) restores SQLite's automatic checkpoints",
+        stringTypeInfo);
+    methods.registerOption(SQLITE3_OPT_CHECKPOINT_PAGES, "the number of WAL frames that triggers a background "
+        "checkpoint; 0 = no size-based checkpoints (default: 1000)", softBigIntTypeInfo);
+    methods.registerOption(SQLITE3_OPT_CHECKPOINT_INTERVAL, "the maximum time in milliseconds between background "
+        "checkpoints while the WAL is not empty; 0 = no time-based checkpoints (default: 10000)", softBigIntTypeInfo);
+    methods.registerOption(SQLITE3_OPT_CHECKPOINT_IDLE, "run a background checkpoint when no transaction has been "
+        "committed for this many milliseconds; 0 = no idle checkpoints (default: 1000)", softBigIntTypeInfo);
+    methods.registerOption(SQLITE3_OPT_WAL_STATS, "read-only: returns a hash of WAL size and background checkpoint "
+        "statistics if background checkpoints are enabled");
+    methods.registerOption(SQLITE3_OPT_MAINTENANCE_INTERVAL, "run a maintenance pass in a background thread with a "
+        "dedicated connection this often in milliseconds; 0 = no background maintenance (the default)",
+        softBigIntTypeInfo);
+    methods.registerOption(SQLITE3_OPT_MAINTENANCE_BUDGET, "the time budget in milliseconds for a single maintenance "
+        "pass (default: 100)", softBigIntTypeInfo);
+    methods.registerOption(SQLITE3_OPT_VACUUM_PAGES, "the number of free pages released by each incremental_vacuum "
+        "step of a maintenance pass (default: 100)", softBigIntTypeInfo);
+    methods.registerOption(SQLITE3_OPT_ANALYSIS_LIMIT, "the analysis_limit used for PRAGMA optimize in a maintenance "
+        "pass (default: 400)", softBigIntTypeInfo);
+    methods.registerOption(SQLITE3_OPT_SNAPSHOT, "reading returns the handle of the WAL snapshot captured in the "
+        "current transaction with qore_snapshot(), if any; setting a handle makes the current or next transaction "
+        "read from that snapshot (0 clears a pending snapshot)", softBigIntTypeInfo);
+    methods.registerOption(SQLITE3_OPT_SESSION, "a table name, a list of table names or '*' for all tables to start "
+        "recording changes with the session extension; NOTHING stops recording");
+    methods.registerOption(SQLITE3_OPT_APPLY_CHANGESET, "setting a binary changeset or patchset applies it to the "
+        "database", binaryTypeInfo);
+    methods.registerOption(SQLITE3_OPT_CONFLICT, "the action for conflicts when applying changesets: 'abort' (the "
+        "default), 'omit' or 'replace', or a closure or call reference that is called with a hash describing each "
+        "conflict and returns the action");
+    methods.registerOption(SQLITE3_OPT_LOB_THRESHOLD, "the size in bytes above which TEXT and BLOB values are "
+        "returned as handles to be read with qore_lob_read() by selectRows() and SQLStatement::fetchRow() and "
+        "fetchRows(); 0 (the default) returns all values", softBigIntTypeInfo);
+    methods.registerOption(SQLITE3_OPT_ATTACH, "a hash of schema names to database file names or to hashes with "
+        "a 'file' key and optional 'cache_size', 'mmap_size', 'journal_mode' and 'synchronous' settings to attach "
+        "to the connection; databases attached with a previous value are detached first");
+    methods.registerOption(SQLITE3_OPT_MAX_ATTACHED, "the maximum number of attached databases on the connection "
+        "(SQLITE_LIMIT_ATTACHED); it cannot be raised above the library's compile-time limit", softBigIntTypeInfo);
+    methods.registerOption(SQLITE3_OPT_NO_VTAB, "if True, statements that use virtual tables cannot be prepared on "
+        "the connection (SQLITE_PREPARE_NO_VTAB); requires sqlite3 3.28 or later", softBoolTypeInfo);
+    methods.registerOption(SQLITE3_OPT_REPREPARES, "read-only: returns the number of times SQLStatements on the "
+        "connection have been prepared again automatically after schema changes");
+    methods.registerOption(SQLITE3_OPT_NATIVE_BINDING, "if True, SQL is passed to SQLite without processing '%v', "
+        "'%s' and '%d' and arguments are bound to SQLite's own '?NNN', ':name', '@name' and '$name' parameters, by "
+        "name from a single hash argument or otherwise by position", softBoolTypeInfo);
+    methods.registerOption(SQLITE3_OPT_EPOCH_DATES, "if True, absolute date/time values are bound as integer "
+        "microseconds since the epoch instead of ISO-8601 text, and with type-mapping, integers in columns declared "
+        "as DATE, DATETIME or TIMESTAMP are returned as dates", softBoolTypeInfo);
+    methods.registerOption(SQLITE3_OPT_TYPE_MAPPING, "if True, values of columns declared as DATE, DATETIME, "
+        "TIMESTAMP, NUMBER, NUMERIC, DECIMAL or BOOLEAN are returned as dates, numbers and booleans; False (the "
+        "default) returns them as stored", softBoolTypeInfo);
+    methods.registerOption(SQLITE3_OPT_JSON_COLUMNS, "if True, JSON objects and arrays in columns declared as "
+        "JSON are returned as hashes and lists; other values, including JSON scalars, are returned as stored; False "
+        "(the default) returns all values as stored", softBoolTypeInfo);
+    methods.registerOption(SQLITE3_OPT_COMPRESSION, "the size in bytes from which the qore_compress() SQL function "
+        "compresses strings and binary values, if that saves space; values of columns with a declared type "
+        "containing COMPRESS are decompressed when read; 0 (the default) compresses values of any size",
+        softBigIntTypeInfo);
+    methods.registerOption(SQLITE3_OPT_WARMUP_SQL, "a string or list of strings of read-only SQL statements that "
+        "are executed, with their rows discarded, when the connection is opened, so that the schema is loaded and the "
+        "pages they read are cached before the first request");
+    methods.registerOption(SQLITE3_OPT_WARMUP_TABLES, "a string or list of strings of table and index names, "
+        "optionally qualified with a schema name, whose pages are read into the page cache when the connection is "
+        "opened; '*' or 'schema.*' reads all tables and indexes of a database");
+    methods.registerOption(SQLITE3_OPT_WARMUP_STATS, "read-only: returns a hash with the number of statements, "
+        "tables and indexes and pages read by the last warm-up and its duration in microseconds");
+    methods.registerOption(SQLITE3_OPT_RESULT_CACHE, "the maximum total size in bytes of the results of read queries "
+        "cached on the connection; 0 (the default) disables the cache", softBigIntTypeInfo);
+    methods.registerOption(SQLITE3_OPT_RESULT_CACHE_STATS, "read-only: returns a hash with the size of the result "
+        "cache and its hit, miss and invalidation counters, or NOTHING if the cache is disabled");
+    methods.registerOption(SQLITE3_OPT_STATEMENT_CACHE, "the maximum number of prepared statements kept on the "
+        "connection for SQL that is run again, including warm-up statements; 0 disables the cache (default: 32)",
+        softBigIntTypeInfo);
+    methods.registerOption(SQLITE3_OPT_STATEMENT_CACHE_STATS, "read-only: returns a hash with the number of "
+        "statements in the statement cache and its hit and miss counters");
+    methods.registerOption(SQLITE3_OPT_CHANGE_EVENTS, "a closure or call reference that is called with a list of "
+        "hashes describing the rows changed by each transaction committed on the connection, or NOTHING to stop "
+        "delivering changes");
+    methods.registerOption(SQLITE3_OPT_CHANGE_VALUES, "if True, change events include the old and new column "
+        "values of each row; requires an sqlite3 library built with SQLITE_ENABLE_PREUPDATE_HOOK and cannot be "
+        "combined with the 'session' option", softBoolTypeInfo);
+    methods.registerOption(SQLITE3_OPT_DATA_VERSION, "read-only: returns the value of PRAGMA data_version, which "
+        "changes when another connection commits changes to the database");
+    methods.registerOption(SQLITE3_OPT_SAVEPOINT, "setting a name (or NOTHING for a generated name) sets a savepoint "
+        "in the current transaction; reading returns the name of the innermost savepoint");
+    methods.registerOption(SQLITE3_OPT_RELEASE_SAVEPOINT, "setting a savepoint name (or NOTHING for the innermost "
+        "savepoint) releases the savepoint and all savepoints set after it");
+    methods.registerOption(SQLITE3_OPT_ROLLBACK_SAVEPOINT, "setting a savepoint name (or NOTHING for the innermost "
+        "savepoint) rolls back the changes made since the savepoint was set; the savepoint remains active");
+    methods.registerOption(SQLITE3_OPT_SAVEPOINT_DEPTH, "read-only: returns the number of active savepoints in the "
+        "current transaction");
+
     // register database functions with DBI subsystem
     DBID_SQLITE3 = DBI.registerDriver("sqlite3", methods,
         DBI_CAP_LOB_SUPPORT
         | DBI_CAP_TRANSACTION_MANAGEMENT
         | DBI_CAP_BIND_BY_VALUE
         | DBI_CAP_HAS_EXECRAW
+        | DBI_CAP_HAS_SELECT_ROW
+        | DBI_CAP_HAS_DESCRIBE
         | DBI_CAP_CHARSET_SUPPORT
         | DBI_CAP_HAS_NUMBER_SUPPORT
+        | DBI_CAP_HAS_OPTION_SUPPORT
     );
 
+    Sqlite3NS = new QoreNamespace("Sqlite3");
+    Sqlite3NS->addBuiltinVariant("parallel_select", f_sqlite3_parallel_select, QCF_NO_FLAGS, QDOM_DATABASE,
+        autoTypeInfo, 3, stringTypeInfo, QORE_PARAM_NO_ARG, "file", stringTypeInfo, QORE_PARAM_NO_ARG, "table",
+        hashOrNothingTypeInfo, QORE_PARAM_NO_ARG, "opts");
+    Sqlite3NS->addBuiltinVariant("export_arrow", f_sqlite3_export_arrow, QCF_NO_FLAGS,
+        QDOM_DATABASE | QDOM_FILESYSTEM, autoTypeInfo, 3, stringTypeInfo, QORE_PARAM_NO_ARG, "file", stringTypeInfo,
+        QORE_PARAM_NO_ARG, "sql", hashOrNothingTypeInfo, QORE_PARAM_NO_ARG, "opts");
+    Sqlite3NS->addBuiltinVariant("async_select", f_sqlite3_async_select, QCF_NO_FLAGS, QDOM_DATABASE, autoTypeInfo,
+        3, stringTypeInfo, QORE_PARAM_NO_ARG, "file", stringTypeInfo, QORE_PARAM_NO_ARG, "sql",
+        hashOrNothingTypeInfo, QORE_PARAM_NO_ARG, "opts");
+    Sqlite3NS->addBuiltinVariant("async_poll", f_sqlite3_async_poll, QCF_NO_FLAGS, QDOM_DATABASE, autoTypeInfo, 1,
+        bigIntTypeInfo, QORE_PARAM_NO_ARG, "id");
+    Sqlite3NS->addBuiltinVariant("async_wait", f_sqlite3_async_wait, QCF_NO_FLAGS, QDOM_DATABASE, autoTypeInfo, 2,
+        bigIntTypeInfo, QORE_PARAM_NO_ARG, "id", bigIntOrNothingTypeInfo, QORE_PARAM_NO_ARG, "timeout_ms");
+    Sqlite3NS->addBuiltinVariant("async_fetch", f_sqlite3_async_fetch, QCF_NO_FLAGS, QDOM_DATABASE, autoTypeInfo, 1,
+        bigIntTypeInfo, QORE_PARAM_NO_ARG, "id");
+    Sqlite3NS->addBuiltinVariant("async_cancel", f_sqlite3_async_cancel, QCF_NO_FLAGS, QDOM_DATABASE, autoTypeInfo,
+        1, bigIntTypeInfo, QORE_PARAM_NO_ARG, "id");
+    Sqlite3NS->addBuiltinVariant("async_close", f_sqlite3_async_close, QCF_NO_FLAGS, QDOM_DATABASE, autoTypeInfo,
+        1, bigIntTypeInfo, QORE_PARAM_NO_ARG, "id");
+    Sqlite3NS->addBuiltinVariant("import_csv", f_sqlite3_import_csv, QCF_NO_FLAGS,
+        QDOM_DATABASE | QDOM_FILESYSTEM, autoTypeInfo, 4, stringTypeInfo, QORE_PARAM_NO_ARG, "file",
+        stringTypeInfo, QORE_PARAM_NO_ARG, "table", dataTypeInfo, QORE_PARAM_NO_ARG, "input", hashOrNothingTypeInfo,
+        QORE_PARAM_NO_ARG, "opts");
+    Sqlite3NS->addBuiltinVariant("library_config", f_sqlite3_library_config, QCF_RET_VALUE_ONLY, QDOM_DEFAULT,
+        hashTypeInfo);
+    Sqlite3NS->addBuiltinVariant("maintenance", f_sqlite3_maintenance, QCF_NO_FLAGS, QDOM_DATABASE,
+        hashTypeInfo, 2, stringTypeInfo, QORE_PARAM_NO_ARG, "file", hashOrNothingTypeInfo, QORE_PARAM_NO_ARG, "opts");
+    Sqlite3NS->addBuiltinVariant("maintenance_stats", f_sqlite3_maintenance_stats, QCF_NO_FLAGS, QDOM_DATABASE,
+        hashTypeInfo, 1, stringTypeInfo, QORE_PARAM_NO_ARG, "file");
+    Sqlite3NS->addBuiltinVariant("fts_create_index", f_sqlite3_fts_create_index, QCF_NO_FLAGS, QDOM_DATABASE,
+        autoTypeInfo, 2, stringTypeInfo, QORE_PARAM_NO_ARG, "file", hashTypeInfo, QORE_PARAM_NO_ARG, "opts");
+    Sqlite3NS->addBuiltinVariant("fts_drop_index", f_sqlite3_fts_drop_index, QCF_NO_FLAGS, QDOM_DATABASE,
+        autoTypeInfo, 2, stringTypeInfo, QORE_PARAM_NO_ARG, "file", stringTypeInfo, QORE_PARAM_NO_ARG, "name");
+    Sqlite3NS->addBuiltinVariant("fts_indexes", f_sqlite3_fts_indexes, QCF_NO_FLAGS, QDOM_DATABASE,
+        hashTypeInfo, 1, stringTypeInfo, QORE_PARAM_NO_ARG, "file");
+    Sqlite3NS->addBuiltinVariant("fts_search_sql", f_sqlite3_fts_search_sql, QCF_NO_FLAGS, QDOM_DEFAULT,
+        stringTypeInfo, 2, stringTypeInfo, QORE_PARAM_NO_ARG, "index", hashOrNothingTypeInfo, QORE_PARAM_NO_ARG,
+        "opts");
+
     return 0;
 }
 
 void qore_sqlite3_module_ns_init(QoreNamespace* rns, QoreNamespace* qns) {
     QORE_TRACE("qore_sqlite3_module_ns_init()");
-    // nothing to do at the moment
+    qns->addNamespace(Sqlite3NS->copy());
 }
 
 void qore_sqlite3_module_delete() {
     QORE_TRACE("qore_sqlite3_module_delete()");
-
-    // cleanup any thread data
-    tclist.pop(1);
-    // delete thread key
-    pthread_key_delete(ptk_sqlite3);
+    QoreSqlite3AsyncQuery::closeAll();
+    delete Sqlite3NS;
 }
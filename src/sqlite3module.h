@@ -23,6 +23,46 @@
 #ifndef SQLITE3MODULE_H
 #define SQLITE3MODULE_H
 
+#include <sqlite3.h>
+
+#include <string>
+
+// column affinities as defined by SQLite; used as the internal_id of columns in descriptions
+#define QORE_SQLITE3_AFF_BLOB    'A'
+#define QORE_SQLITE3_AFF_TEXT    'B'
+#define QORE_SQLITE3_AFF_NUMERIC 'C'
+#define QORE_SQLITE3_AFF_INTEGER 'D'
+#define QORE_SQLITE3_AFF_REAL    'E'
+
+// conversions of column values by declared type enabled on a connection
+//! DATE, NUMBER and BOOLEAN columns are converted; set with the "type-mapping" option
+#define QORE_SQLITE3_CONV_TYPES 0x01
+//! integers in DATE columns are microseconds since the epoch; set with the "epoch-dates" option
+#define QORE_SQLITE3_CONV_EPOCH 0x02
+//! JSON objects and arrays in JSON columns are parsed; set with the "json-columns" option
+#define QORE_SQLITE3_CONV_JSON  0x04
+
+// prepare flags; they are ignored if the sqlite3 library does not support sqlite3_prepare_v3()
+#ifndef SQLITE_PREPARE_PERSISTENT
+#define SQLITE_PREPARE_PERSISTENT 0x01
+#endif
+#ifndef SQLITE_PREPARE_NO_VTAB
+#define SQLITE_PREPARE_NO_VTAB 0x04
+#endif
+
+//! flags used to open all connections; set according to the threading mode when the module is initialized
+DLLLOCAL extern int qore_sqlite3_open_flags;
+
+//! Prepares a statement with sqlite3_prepare_v3() and the given SQLITE_PREPARE_* flags if available
+DLLLOCAL int qore_sqlite3_prepare(sqlite3* db, const char* sql, int len, unsigned flags, sqlite3_stmt** stmt,
+        const char** tail = nullptr);
+
+//! Returns the name in double quotes with embedded double quotes doubled, for use as an SQL identifier
+DLLLOCAL std::string qore_sqlite3_quote_identifier(const std::string& name);
+
+//! Returns the QORE_SQLITE3_AFF_* affinity of a declared column type; an empty or missing type has BLOB affinity
+DLLLOCAL int qore_sqlite3_get_affinity(const char* decl);
+
 QoreStringNode *qore_sqlite3_module_init();
 void qore_sqlite3_module_ns_init(QoreNamespace *rns, QoreNamespace *qns);
 void qore_sqlite3_module_delete(void);
@@ -0,0 +1,552 @@
+/*
+    sqlite3parallel.cc
+
+    Qore Programming Language
+
+    Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "sqlite3parallel.h"
+#include "sqlite3module.h"
+
+#include <strings.h>
+
+// the maximum number of scan threads
+#define QORE_SQLITE3_SCAN_MAX_THREADS 256
+
+// the number of ranges per thread if not set explicitly
+#define QORE_SQLITE3_SCAN_RANGES_PER_THREAD 4
+
+// how long a scan connection waits for a lock held by a writer in rollback journal mode
+#define QORE_SQLITE3_SCAN_BUSY_TIMEOUT 5000
+
+// starts a transaction and its read transaction; the pragma makes a new connection recognize a WAL database before
+// a snapshot is opened
+#define QORE_SQLITE3_SCAN_BEGIN "pragma application_id; begin"
+
+static int get_string_option(const char* opt, const QoreValue v, std::string& rv, ExceptionSink* xsink) {
+    if (v.getType() != NT_STRING) {
+        xsink->raiseException("SQLITE3-PARALLEL-ERROR", "option '%s' expects a string; got type '%s'", opt,
+            v.getTypeName());
+        return -1;
+    }
+    TempEncodingHelper str(v.get<const QoreStringNode>(), QCS_UTF8, xsink);
+    if (*xsink) {
+        return -1;
+    }
+    rv = str->c_str();
+    return 0;
+}
+
+static int get_int_option(const char* opt, const QoreValue v, int64 min, int64 max, int64& rv,
+        ExceptionSink* xsink) {
+    int64 i = v.getAsBigInt();
+    if (i < min || i > max) {
+        xsink->raiseException("SQLITE3-PARALLEL-ERROR", "option '%s' must be between " QLLD " and " QLLD "; got "
+            QLLD, opt, min, max, i);
+        return -1;
+    }
+    rv = i;
+    return 0;
+}
+
+void QoreSqlite3RowBuffer::appendRow(sqlite3_stmt* stmt, int ncols) {
+    for (int i = 0; i < ncols; ++i) {
+        QoreSqlite3ScanCell c;
+        c.type = sqlite3_column_type(stmt, i);
+        c.len = 0;
+        switch (c.type) {
+            case SQLITE_INTEGER:
+                c.i = sqlite3_column_int64(stmt, i);
+                break;
+
+            case SQLITE_FLOAT:
+                c.d = sqlite3_column_double(stmt, i);
+                break;
+
+            case SQLITE_TEXT:
+            case SQLITE_BLOB: {
+                const void* p = c.type == SQLITE_TEXT
+                    ? (const void*)sqlite3_column_text(stmt, i)
+                    : sqlite3_column_blob(stmt, i);
+                c.len = sqlite3_column_bytes(stmt, i);
+                c.offset = data.size();
+                if (c.len) {
+                    data.append((const char*)p, c.len);
+                }
+                break;
+            }
+
+            default:
+                c.i = 0;
+                break;
+        }
+        cells.push_back(c);
+    }
+    ++rows;
+}
+
+QoreValue QoreSqlite3RowBuffer::getValue(const QoreSqlite3ScanCell& c) const {
+    switch (c.type) {
+        case SQLITE_INTEGER:
+            return c.i;
+
+        case SQLITE_FLOAT:
+            return c.d;
+
+        case SQLITE_TEXT:
+            return new QoreStringNode(data.data() + c.offset, c.len, QCS_UTF8);
+
+        case SQLITE_BLOB: {
+            BinaryNode* b = new BinaryNode;
+            b->append(data.data() + c.offset, c.len);
+            return b;
+        }
+
+        default:
+            break;
+    }
+    return null();
+}
+
+void QoreSqlite3RowBuffer::appendTo(QoreValue& rv, const std::vector<std::string>& names, bool rows_format,
+        ExceptionSink* xsink) const {
+    const QoreSqlite3ScanCell* c = cells.data();
+    size_t ncols = names.size();
+
+    if (rows_format) {
+        QoreListNode* l = rv.get<QoreListNode>();
+        for (size_t i = 0; i < rows; ++i) {
+            QoreHashNode* h = new QoreHashNode(autoTypeInfo);
+            for (size_t j = 0; j < ncols; ++j, ++c) {
+                h->setKeyValue(names[j].c_str(), getValue(*c), xsink);
+            }
+            l->push(h, xsink);
+        }
+        return;
+    }
+
+    QoreHashNode* h = rv.get<QoreHashNode>();
+    std::vector<QoreListNode*> cols(ncols);
+    for (size_t j = 0; j < ncols; ++j) {
+        cols[j] = h->getKeyValue(names[j].c_str()).get<QoreListNode>();
+    }
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < ncols; ++j, ++c) {
+            cols[j]->push(getValue(*c), xsink);
+        }
+    }
+}
+
+QoreValue QoreSqlite3RowBuffer::newResult(const std::vector<std::string>& names, bool rows_format) {
+    if (rows_format) {
+        return new QoreListNode(autoHashTypeInfo);
+    }
+    QoreHashNode* h = new QoreHashNode(autoTypeInfo);
+    for (const auto& name : names) {
+        h->setKeyValue(name.c_str(), new QoreListNode(autoTypeInfo), nullptr);
+    }
+    return h;
+}
+
+QoreSqlite3ParallelScan::QoreSqlite3ParallelScan(const char* filename)
+        : filename(filename), threads(std::thread::hardware_concurrency()),
+          binder(QCS_UTF8, new QoreListNode(autoTypeInfo)) {
+    if (threads < 1) {
+        threads = 1;
+    } else if (threads > QORE_SQLITE3_SCAN_MAX_THREADS) {
+        threads = QORE_SQLITE3_SCAN_MAX_THREADS;
+    }
+}
+
+QoreSqlite3ParallelScan::~QoreSqlite3ParallelScan() {
+    stopWorkers();
+    for (auto& w : workers) {
+        sqlite3_finalize(w.stmt);
+        sqlite3_close(w.db);
+    }
+    // closing the coordinating connection rolls back its transaction
+    sqlite3_close(db);
+    if (snapshot) {
+        snapshot->deref();
+    }
+}
+
+int QoreSqlite3ParallelScan::setOptions(const QoreHashNode* opts, ExceptionSink* xsink) {
+    if (!opts) {
+        return 0;
+    }
+
+    ConstHashIterator hi(opts);
+    while (hi.next()) {
+        const char* opt = hi.getKey();
+        const QoreValue v = hi.get();
+
+        if (!strcasecmp(opt, "columns")) {
+            if (get_string_option(opt, v, columns, xsink)) {
+                return -1;
+            }
+        } else if (!strcasecmp(opt, "key")) {
+            if (get_string_option(opt, v, key, xsink)) {
+                return -1;
+            }
+        } else if (!strcasecmp(opt, "where")) {
+            if (get_string_option(opt, v, where, xsink)) {
+                return -1;
+            }
+        } else if (!strcasecmp(opt, "args")) {
+            if (v.getType() != NT_LIST) {
+                xsink->raiseException("SQLITE3-PARALLEL-ERROR", "option '%s' expects a list; got type '%s'", opt,
+                    v.getTypeName());
+                return -1;
+            }
+            args = v.get<const QoreListNode>();
+        } else if (!strcasecmp(opt, "callback")) {
+            callback = dynamic_cast<const ResolvedCallReferenceNode*>(v.getInternalNode());
+            if (!callback) {
+                xsink->raiseException("SQLITE3-PARALLEL-ERROR", "option '%s' expects a closure or call reference; "
+                    "got type '%s'", opt, v.getTypeName());
+                return -1;
+            }
+        } else if (!strcasecmp(opt, "snapshot")) {
+            snapshot_id = v.getAsBigInt();
+        } else if (!strcasecmp(opt, "threads")) {
+            if (get_int_option(opt, v, 1, QORE_SQLITE3_SCAN_MAX_THREADS, threads, xsink)) {
+                return -1;
+            }
+        } else if (!strcasecmp(opt, "ranges")) {
+            if (get_int_option(opt, v, 1, 0x7fffffff, nranges, xsink)) {
+                return -1;
+            }
+        } else if (!strcasecmp(opt, "ordered")) {
+            ordered = v.getAsBool();
+        } else if (!strcasecmp(opt, "rows")) {
+            rows_format = v.getAsBool();
+        } else if (!strcasecmp(opt, "consistent")) {
+            consistent = v.getAsBool();
+        } else {
+            xsink->raiseException("SQLITE3-PARALLEL-ERROR", "unknown option '%s'", opt);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+sqlite3* QoreSqlite3ParallelScan::open(ExceptionSink* xsink) {
+    sqlite3* h = nullptr;
+    int rc = sqlite3_open_v2(filename.c_str(), &h, SQLITE_OPEN_READONLY
+        | (qore_sqlite3_open_flags & (SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_FULLMUTEX)), nullptr);
+    if (rc != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-PARALLEL-ERROR", "cannot open %s: %s", filename.c_str(),
+            h ? sqlite3_errmsg(h) : sqlite3_errstr(rc));
+        sqlite3_close(h);
+        return nullptr;
+    }
+    sqlite3_busy_timeout(h, QORE_SQLITE3_SCAN_BUSY_TIMEOUT);
+    return h;
+}
+
+int QoreSqlite3ParallelScan::setup(const std::string& table, ExceptionSink* xsink) {
+    db = open(xsink);
+    if (!db) {
+        return -1;
+    }
+
+    // the transaction is held until the scan is complete
+    if (sqlite3_exec(db, QORE_SQLITE3_SCAN_BEGIN, nullptr, nullptr, nullptr) != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-PARALLEL-ERROR", "cannot start a transaction: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+    if (snapshot_id) {
+        snapshot = QoreSqlite3Snapshot::find(snapshot_id, xsink);
+        if (!snapshot || snapshot->open(db, xsink)) {
+            return -1;
+        }
+    }
+
+    std::string sql = "select min(" + key + "), max(" + key + ") from " + table;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-PARALLEL-ERROR", "cannot read the key range: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+    ON_BLOCK_EXIT(sqlite3_finalize, stmt);
+
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        xsink->raiseException("SQLITE3-PARALLEL-ERROR", "cannot read the key range: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+    // an empty table
+    if (sqlite3_column_type(stmt, 0) == SQLITE_NULL) {
+        return 0;
+    }
+    if (sqlite3_column_type(stmt, 0) != SQLITE_INTEGER || sqlite3_column_type(stmt, 1) != SQLITE_INTEGER) {
+        xsink->raiseException("SQLITE3-PARALLEL-ERROR", "the scan key '%s' must have integer values",
+            key.c_str());
+        return -1;
+    }
+    int64 lo = sqlite3_column_int64(stmt, 0);
+    int64 hi = sqlite3_column_int64(stmt, 1);
+
+    // the read transaction is now open, so the snapshot is the one seen by the key range query
+    if (!snapshot) {
+        const char* journal_mode = nullptr;
+        sqlite3_stmt* jstmt;
+        bool wal = false;
+        if (sqlite3_prepare_v2(db, "pragma journal_mode", -1, &jstmt, nullptr) == SQLITE_OK) {
+            if (sqlite3_step(jstmt) == SQLITE_ROW) {
+                journal_mode = (const char*)sqlite3_column_text(jstmt, 0);
+            }
+            wal = journal_mode && !strcasecmp(journal_mode, "wal");
+            sqlite3_finalize(jstmt);
+        }
+        if (wal) {
+            if (QoreSqlite3Snapshot::isSupported()) {
+                snapshot = QoreSqlite3Snapshot::capture(db, xsink);
+                if (!snapshot) {
+                    return -1;
+                }
+            } else if (consistent) {
+                // in WAL mode readers do not block writers, so each connection would see the database version
+                // current when its own read transaction starts
+                xsink->raiseException("SQLITE3-PARALLEL-ERROR", "a consistent parallel scan of a WAL database "
+                    "requires an sqlite3 library built with SQLITE_ENABLE_SNAPSHOT; set the 'consistent' option to "
+                    "False to allow ranges to be read from different database versions");
+                return -1;
+            }
+        }
+    }
+
+    // split the key range into ranges of equal width; the width is calculated with unsigned arithmetic so that the
+    // full int64 range can be split without overflow
+    uint64_t span = (uint64_t)hi - (uint64_t)lo;
+    uint64_t n = nranges ? nranges : threads * QORE_SQLITE3_SCAN_RANGES_PER_THREAD;
+    uint64_t width = span / n + 1;
+    for (uint64_t off = 0; ; off += width) {
+        uint64_t end = span - off < width ? span : off + width - 1;
+        ranges.emplace_back();
+        ranges.back().lo = (int64)((uint64_t)lo + off);
+        ranges.back().hi = (int64)((uint64_t)lo + end);
+        if (end == span) {
+            break;
+        }
+    }
+    return 0;
+}
+
+int QoreSqlite3ParallelScan::prepareWorkers(const std::string& table, ExceptionSink* xsink) {
+    std::string sql = "select " + columns + " from " + table + " where ";
+    if (!where.empty()) {
+        QoreString w(where.c_str(), QCS_UTF8);
+        if (binder.parseForBind(w, args, xsink)) {
+            return -1;
+        }
+        // the range bounds are named parameters so that they are numbered after the where clause arguments
+        sql += "(";
+        sql += w.c_str();
+        sql += ") and ";
+    }
+    sql += key + " between :qore_lo and :qore_hi order by " + key;
+
+    size_t nthreads = ranges.size() < (size_t)threads ? ranges.size() : (size_t)threads;
+    if (!nthreads) {
+        // prepare a statement anyway to validate the query and get the column names
+        nthreads = 1;
+    }
+    workers.resize(nthreads);
+    for (auto& w : workers) {
+        w.db = open(xsink);
+        if (!w.db) {
+            return -1;
+        }
+        // without a snapshot, a read transaction is started right away; in rollback journal mode the coordinating
+        // connection blocks writers meanwhile, so all connections read the same database version, while in WAL mode
+        // (only allowed if the 'consistent' option is False) each connection reads the version current at this point
+        if (sqlite3_exec(w.db, QORE_SQLITE3_SCAN_BEGIN, nullptr, nullptr, nullptr) != SQLITE_OK
+            || (!snapshot && sqlite3_exec(w.db, "select count(*) from sqlite_master", nullptr, nullptr, nullptr)
+                != SQLITE_OK)) {
+            xsink->raiseException("SQLITE3-PARALLEL-ERROR", "cannot start a transaction: %s",
+                sqlite3_errmsg(w.db));
+            return -1;
+        }
+        if (snapshot && snapshot->open(w.db, xsink)) {
+            return -1;
+        }
+
+        // the statement is reset and run again for each range
+        if (qore_sqlite3_prepare(w.db, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &w.stmt) != SQLITE_OK) {
+            xsink->raiseException("SQLITE3-PARALLEL-ERROR", "sqlite3 error: %s", sqlite3_errmsg(w.db));
+            return -1;
+        }
+        if (binder.bindParameters(w.stmt, xsink)) {
+            xsink->raiseException("SQLITE3-PARALLEL-ERROR", "failed to bind variables");
+            return -1;
+        }
+    }
+
+    sqlite3_stmt* stmt = workers[0].stmt;
+    lo_index = sqlite3_bind_parameter_index(stmt, ":qore_lo");
+    hi_index = sqlite3_bind_parameter_index(stmt, ":qore_hi");
+    ncols = sqlite3_column_count(stmt);
+    for (int i = 0; i < ncols; ++i) {
+        names.push_back(sqlite3_column_name(stmt, i));
+    }
+    return 0;
+}
+
+QoreValue QoreSqlite3ParallelScan::run(const QoreString& table, ExceptionSink* xsink) {
+    std::string tbl;
+    {
+        TempEncodingHelper str(table, QCS_UTF8, xsink);
+        if (*xsink) {
+            return QoreValue();
+        }
+        tbl = str->c_str();
+    }
+
+    if (setup(tbl, xsink) || prepareWorkers(tbl, xsink)) {
+        return QoreValue();
+    }
+
+    ValueHolder rv(callback ? QoreValue() : QoreSqlite3RowBuffer::newResult(names, rows_format), xsink);
+    if (ranges.empty()) {
+        return callback ? QoreValue((int64)0) : rv.release();
+    }
+
+    window = 2 * workers.size();
+    for (auto& w : workers) {
+        w.thread = std::thread(&QoreSqlite3ParallelScan::scan, this, std::ref(w));
+    }
+
+    int64 total = 0;
+    for (size_t n = 0; n < ranges.size(); ++n) {
+        QoreSqlite3ScanRange r;
+        {
+            std::unique_lock<std::mutex> l(m);
+            size_t k = n;
+            if (ordered) {
+                while (!ranges[k].done && error.empty()) {
+                    consumer_cond.wait(l);
+                }
+            } else {
+                while (completed.empty() && error.empty()) {
+                    consumer_cond.wait(l);
+                }
+            }
+            if (!error.empty()) {
+                xsink->raiseException("SQLITE3-PARALLEL-ERROR", "scan failed: %s", error.c_str());
+                return QoreValue();
+            }
+            if (!ordered) {
+                k = completed.front();
+                completed.pop_front();
+            }
+            r.rows = ranges[k].rows;
+            r.cells.swap(ranges[k].cells);
+            r.data.swap(ranges[k].data);
+        }
+
+        total += r.rows;
+        if (callback) {
+            ValueHolder block(QoreSqlite3RowBuffer::newResult(names, rows_format), xsink);
+            r.appendTo(*block, names, rows_format, xsink);
+            ReferenceHolder<QoreListNode> cargs(new QoreListNode(autoTypeInfo), xsink);
+            cargs->push(block.release(), xsink);
+            ValueHolder crv(callback->execValue(*cargs, xsink), xsink);
+            if (*xsink) {
+                return QoreValue();
+            }
+        } else {
+            r.appendTo(*rv, names, rows_format, xsink);
+        }
+
+        {
+            std::lock_guard<std::mutex> l(m);
+            ++consumed;
+        }
+        worker_cond.notify_all();
+    }
+
+    return callback ? QoreValue(total) : rv.release();
+}
+
+void QoreSqlite3ParallelScan::scan(Worker& w) {
+    while (true) {
+        size_t k;
+        {
+            std::unique_lock<std::mutex> l(m);
+            // do not buffer more than the window of ranges ahead of the consumer
+            while (!stop && next < ranges.size() && next >= consumed + window) {
+                worker_cond.wait(l);
+            }
+            if (stop || next >= ranges.size()) {
+                return;
+            }
+            k = next++;
+        }
+
+        // the range is only accessed by this thread until it is marked as done
+        std::string err;
+        int rc = scanRange(w, ranges[k], err);
+        {
+            std::lock_guard<std::mutex> l(m);
+            if (rc) {
+                if (error.empty()) {
+                    error = err;
+                }
+                stop = true;
+            } else {
+                ranges[k].done = true;
+                completed.push_back(k);
+            }
+        }
+        consumer_cond.notify_one();
+        if (rc) {
+            worker_cond.notify_all();
+            return;
+        }
+    }
+}
+
+int QoreSqlite3ParallelScan::scanRange(Worker& w, QoreSqlite3ScanRange& r, std::string& err) {
+    sqlite3_bind_int64(w.stmt, lo_index, r.lo);
+    sqlite3_bind_int64(w.stmt, hi_index, r.hi);
+
+    int rc;
+    while ((rc = sqlite3_step(w.stmt)) == SQLITE_ROW) {
+        r.appendRow(w.stmt, ncols);
+    }
+
+    if (rc != SQLITE_DONE) {
+        err = sqlite3_errmsg(w.db);
+    }
+    sqlite3_reset(w.stmt);
+    return rc == SQLITE_DONE ? 0 : -1;
+}
+
+void QoreSqlite3ParallelScan::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> l(m);
+        stop = true;
+    }
+    worker_cond.notify_all();
+    for (auto& w : workers) {
+        if (w.thread.joinable()) {
+            w.thread.join();
+        }
+    }
+}
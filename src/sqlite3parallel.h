@@ -0,0 +1,197 @@
+/*
+  sqlite3parallel.h
+
+  Qore Programming Language
+
+  Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SQLITE3PARALLEL_H
+#define SQLITE3PARALLEL_H
+
+#include <sqlite3.h>
+#include <qore/Qore.h>
+
+#include "sqlite3executor.h"
+#include "sqlite3snapshot.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//! A column value read by a scan thread
+struct QoreSqlite3ScanCell {
+    //! the sqlite3 storage class
+    int type;
+    union {
+        int64 i;
+        double d;
+        //! the offset of text and BLOB values in the range's data buffer
+        size_t offset;
+    };
+    //! the size of text and BLOB values
+    size_t len;
+};
+
+//! Rows read by a thread that does not create Qore values
+struct QoreSqlite3RowBuffer {
+    //! the number of rows read
+    size_t rows = 0;
+    //! the column values of all rows, row by row
+    std::vector<QoreSqlite3ScanCell> cells;
+    //! text and BLOB data
+    std::string data;
+
+    //! Appends the current row of a statement
+    DLLLOCAL void appendRow(sqlite3_stmt* stmt, int ncols);
+
+    //! Converts a cell to a Qore value
+    DLLLOCAL QoreValue getValue(const QoreSqlite3ScanCell& c) const;
+
+    //! Appends the rows to a result returned by newResult()
+    DLLLOCAL void appendTo(QoreValue& rv, const std::vector<std::string>& names, bool rows_format,
+        ExceptionSink* xsink) const;
+
+    //! Returns an empty result with the given columns as a hash of lists or, if \a rows_format is true, a list of
+    //! hashes
+    DLLLOCAL static QoreValue newResult(const std::vector<std::string>& names, bool rows_format);
+};
+
+//! A key range of a parallel scan
+struct QoreSqlite3ScanRange : public QoreSqlite3RowBuffer {
+    //! the inclusive key bounds
+    int64 lo, hi;
+    //! true once a scan thread has read the range
+    bool done = false;
+};
+
+/*! \brief Scans a table with several read-only connections in parallel.
+
+    The key range of the table is split into ranges that are read by a pool of threads, each with its own connection
+    and prepared statement.  All connections read from the same database version: in WAL mode a snapshot is shared
+    between them, and in rollback journal mode the read transaction of the coordinating connection keeps writers from
+    committing until the scan is complete.  In WAL mode without snapshot support in the sqlite3 library, a scan is
+    only run if the \c consistent option is \c False, and then each connection reads the database version that is
+    current when its transaction starts.
+
+    Scan threads only use the sqlite3 API; rows are buffered per range and converted to Qore values by the calling
+    thread, which consumes ranges in key order or in the order they are completed while the threads continue with
+    the following ranges.
+*/
+class QoreSqlite3ParallelScan {
+public:
+    DLLLOCAL QoreSqlite3ParallelScan(const char* filename);
+
+    //! Stops and joins the scan threads and closes all connections
+    DLLLOCAL ~QoreSqlite3ParallelScan();
+
+    /*! \brief Sets the scan options.
+
+        \param opts the options as documented for Sqlite3::parallel_select(); may be nullptr
+        \param xsink exception handler
+
+        \retval int 0 on success, -1 on error
+    */
+    DLLLOCAL int setOptions(const QoreHashNode* opts, ExceptionSink* xsink);
+
+    /*! \brief Runs the scan.
+
+        \param table the table to scan
+        \param xsink exception handler
+
+        \retval QoreValue the result as a hash of lists or a list of hashes, or the number of rows if a callback was
+        given
+    */
+    DLLLOCAL QoreValue run(const QoreString& table, ExceptionSink* xsink);
+
+private:
+    //! A scan thread with its connection
+    struct Worker {
+        sqlite3* db = nullptr;
+        sqlite3_stmt* stmt = nullptr;
+        std::thread thread;
+    };
+
+    std::string filename;
+
+    // options
+    std::string columns = "*";
+    std::string key = "rowid";
+    std::string where;
+    const QoreListNode* args = nullptr;
+    const ResolvedCallReferenceNode* callback = nullptr;
+    int64 snapshot_id = 0;
+    int64 threads;
+    int64 nranges = 0;
+    bool ordered = true;
+    bool rows_format = false;
+    bool consistent = true;
+
+    //! Converts the bind markers in the where clause and binds its arguments
+    QoreSqlite3ExecBase binder;
+
+    //! The coordinating connection
+    sqlite3* db = nullptr;
+    //! The snapshot shared by all connections, if any
+    QoreSqlite3Snapshot* snapshot = nullptr;
+    std::vector<Worker> workers;
+
+    //! The number of result columns and their names
+    int ncols = 0;
+    std::vector<std::string> names;
+    //! The parameter indexes of the range bounds
+    int lo_index = 0, hi_index = 0;
+
+    std::mutex m;
+    //! Signaled when a range has been completed or an error occurred
+    std::condition_variable consumer_cond;
+    //! Signaled when a range has been consumed or the scan is stopped
+    std::condition_variable worker_cond;
+    std::vector<QoreSqlite3ScanRange> ranges;
+    //! Completed ranges in the order they were completed
+    std::deque<size_t> completed;
+    //! The next range to scan and the number of ranges consumed
+    size_t next = 0;
+    size_t consumed = 0;
+    //! The maximum number of ranges that may be completed but not consumed yet
+    size_t window;
+    bool stop = false;
+    std::string error;
+
+    //! Opens a read-only connection
+    DLLLOCAL sqlite3* open(ExceptionSink* xsink);
+
+    //! Opens the coordinating transaction, shares a snapshot with it and computes the key ranges
+    DLLLOCAL int setup(const std::string& table, ExceptionSink* xsink);
+
+    //! Opens the scan connections and prepares their statements
+    DLLLOCAL int prepareWorkers(const std::string& table, ExceptionSink* xsink);
+
+    //! Scan thread main loop
+    DLLLOCAL void scan(Worker& w);
+
+    //! Reads a single range; returns 0 on success or -1 with the error message in \a err
+    DLLLOCAL int scanRange(Worker& w, QoreSqlite3ScanRange& r, std::string& err);
+
+    //! Stops the scan threads
+    DLLLOCAL void stopWorkers();
+};
+
+#endif
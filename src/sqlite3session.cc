@@ -0,0 +1,303 @@
+/*
+    sqlite3session.cc
+
+    Qore Programming Language
+
+    Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "sqlite3session.h"
+#include "config.h"
+
+#include <memory>
+
+QoreListNode* QoreSqlite3Session::getTables() const {
+    QoreListNode* l = new QoreListNode(stringTypeInfo);
+    if (tables.empty()) {
+        l->push(new QoreStringNode("*"), nullptr);
+    }
+    for (const auto& t : tables) {
+        l->push(new QoreStringNode(t.c_str(), QCS_UTF8), nullptr);
+    }
+    return l;
+}
+
+#ifdef HAVE_SQLITE3_SESSION
+//! State for the conflict handler of sqlite3changeset_apply()
+struct QoreSqlite3ApplyContext {
+    const ResolvedCallReferenceNode* handler;
+    QoreSqlite3ConflictAction action;
+    ExceptionSink* xsink;
+};
+
+static const char* conflict_types[] = {
+    nullptr,
+    "data",         // SQLITE_CHANGESET_DATA
+    "notfound",     // SQLITE_CHANGESET_NOTFOUND
+    "conflict",     // SQLITE_CHANGESET_CONFLICT
+    "constraint",   // SQLITE_CHANGESET_CONSTRAINT
+    "foreign_key",  // SQLITE_CHANGESET_FOREIGN_KEY
+};
+
+static QoreValue get_value(sqlite3_value* v) {
+    if (!v) {
+        return QoreValue();
+    }
+    switch (sqlite3_value_type(v)) {
+        case SQLITE_INTEGER:
+            return (int64)sqlite3_value_int64(v);
+
+        case SQLITE_FLOAT:
+            return sqlite3_value_double(v);
+
+        case SQLITE_TEXT:
+            return new QoreStringNode((const char*)sqlite3_value_text(v), sqlite3_value_bytes(v), QCS_UTF8);
+
+        case SQLITE_BLOB: {
+            BinaryNode* b = new BinaryNode;
+            b->append(sqlite3_value_blob(v), sqlite3_value_bytes(v));
+            return b;
+        }
+
+        default:
+            break;
+    }
+    return null();
+}
+
+// returns the old, new or conflicting values of a change
+static QoreListNode* get_values(sqlite3_changeset_iter* iter, int ncol,
+        int (*f)(sqlite3_changeset_iter*, int, sqlite3_value**)) {
+    QoreListNode* l = new QoreListNode(autoTypeInfo);
+    for (int i = 0; i < ncol; ++i) {
+        sqlite3_value* v = nullptr;
+        f(iter, i, &v);
+        l->push(get_value(v), nullptr);
+    }
+    return l;
+}
+
+static int conflict_handler(void* arg, int type, sqlite3_changeset_iter* iter) {
+    QoreSqlite3ApplyContext* ctx = reinterpret_cast<QoreSqlite3ApplyContext*>(arg);
+    // replace is only valid for data and conflict conflicts
+    bool can_replace = type == SQLITE_CHANGESET_DATA || type == SQLITE_CHANGESET_CONFLICT;
+
+    QoreSqlite3ConflictAction action = ctx->action;
+    if (ctx->handler) {
+        const char* table;
+        int ncol, op, indirect;
+        sqlite3changeset_op(iter, &table, &ncol, &op, &indirect);
+
+        ExceptionSink* xsink = ctx->xsink;
+        ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+        h->setKeyValue("type", new QoreStringNode(type >= SQLITE_CHANGESET_DATA
+            && type <= SQLITE_CHANGESET_FOREIGN_KEY ? conflict_types[type] : "unknown"), xsink);
+        if (type != SQLITE_CHANGESET_FOREIGN_KEY) {
+            h->setKeyValue("table", new QoreStringNode(table, QCS_UTF8), xsink);
+            h->setKeyValue("op", new QoreStringNode(op == SQLITE_INSERT ? "insert"
+                : (op == SQLITE_UPDATE ? "update" : "delete")), xsink);
+            if (op != SQLITE_INSERT) {
+                h->setKeyValue("old", get_values(iter, ncol, sqlite3changeset_old), xsink);
+            }
+            if (op != SQLITE_DELETE) {
+                h->setKeyValue("new", get_values(iter, ncol, sqlite3changeset_new), xsink);
+            }
+            if (can_replace) {
+                h->setKeyValue("conflicting", get_values(iter, ncol, sqlite3changeset_conflict), xsink);
+            }
+        }
+
+        ReferenceHolder<QoreListNode> args(new QoreListNode(autoTypeInfo), xsink);
+        args->push(h.release(), xsink);
+        ValueHolder rv(ctx->handler->execValue(*args, xsink), xsink);
+        if (*xsink) {
+            return SQLITE_CHANGESET_ABORT;
+        }
+
+        if (rv->getType() == NT_STRING) {
+            const QoreStringNode* str = rv->get<const QoreStringNode>();
+            if (str->equal("omit")) {
+                action = SQLITE3_CONFLICT_OMIT;
+            } else if (str->equal("replace")) {
+                action = SQLITE3_CONFLICT_REPLACE;
+            } else if (str->equal("abort")) {
+                action = SQLITE3_CONFLICT_ABORT;
+            } else {
+                xsink->raiseException("SQLITE3-SESSION-ERROR", "the conflict handler returned '%s'; expecting "
+                    "'omit', 'replace' or 'abort'", str->c_str());
+                return SQLITE_CHANGESET_ABORT;
+            }
+        } else if (!rv->isNothing()) {
+            xsink->raiseException("SQLITE3-SESSION-ERROR", "the conflict handler returned type '%s'; expecting a "
+                "string or NOTHING", rv->getTypeName());
+            return SQLITE_CHANGESET_ABORT;
+        }
+    }
+
+    switch (action) {
+        case SQLITE3_CONFLICT_OMIT:
+            return SQLITE_CHANGESET_OMIT;
+        case SQLITE3_CONFLICT_REPLACE:
+            // other conflicts cannot be resolved by replacing a row; the change is skipped instead
+            return can_replace ? SQLITE_CHANGESET_REPLACE : SQLITE_CHANGESET_OMIT;
+        default:
+            break;
+    }
+    return SQLITE_CHANGESET_ABORT;
+}
+
+QoreSqlite3Session* QoreSqlite3Session::create(sqlite3* db, const QoreValue tables, ExceptionSink* xsink) {
+    std::unique_ptr<QoreSqlite3Session> s(new QoreSqlite3Session(db));
+
+    switch (tables.getType()) {
+        case NT_STRING: {
+            QoreStringValueHelper str(tables, QCS_UTF8, xsink);
+            if (*xsink) {
+                return nullptr;
+            }
+            if (!str->equal("*")) {
+                s->tables.push_back(str->c_str());
+            }
+            break;
+        }
+
+        case NT_LIST: {
+            ConstListIterator i(tables.get<const QoreListNode>());
+            while (i.next()) {
+                QoreStringValueHelper str(i.getValue(), QCS_UTF8, xsink);
+                if (*xsink) {
+                    return nullptr;
+                }
+                s->tables.push_back(str->c_str());
+            }
+            break;
+        }
+
+        default:
+            xsink->raiseException("SQLITE3-SESSION-ERROR", "expecting a table name, a list of table names or '*'; "
+                "got type '%s'", tables.getTypeName());
+            return nullptr;
+    }
+
+    std::string err;
+    if (s->start(err)) {
+        xsink->raiseException("SQLITE3-SESSION-ERROR", "%s", err.c_str());
+        return nullptr;
+    }
+    return s.release();
+}
+
+QoreSqlite3Session::~QoreSqlite3Session() {
+    if (session) {
+        sqlite3session_delete(session);
+    }
+}
+
+int QoreSqlite3Session::start(std::string& err) {
+    int rc = sqlite3session_create(db, "main", &session);
+    if (rc != SQLITE_OK) {
+        err = std::string("cannot create a session: ") + sqlite3_errstr(rc);
+        return -1;
+    }
+
+    if (tables.empty()) {
+        rc = sqlite3session_attach(session, nullptr);
+    } else {
+        for (const auto& t : tables) {
+            rc = sqlite3session_attach(session, t.c_str());
+            if (rc != SQLITE_OK) {
+                break;
+            }
+        }
+    }
+    if (rc != SQLITE_OK) {
+        err = std::string("cannot attach tables to the session: ") + sqlite3_errstr(rc);
+        sqlite3session_delete(session);
+        session = nullptr;
+        return -1;
+    }
+    return 0;
+}
+
+int QoreSqlite3Session::take(bool patchset, int& size, void*& data, std::string& err) {
+    if (!session) {
+        // the recording could not be restarted after the last changeset was taken, so changes have been lost; the
+        // error is reported once and the recording is restarted for the next call
+        err = "changes were not recorded after the last changeset was taken: " + restart_error;
+        restart_error.clear();
+        start(restart_error);
+        return -1;
+    }
+
+    size = 0;
+    data = nullptr;
+    int rc = patchset
+        ? sqlite3session_patchset(session, &size, &data)
+        : sqlite3session_changeset(session, &size, &data);
+    if (rc != SQLITE_OK) {
+        err = std::string("cannot create the ") + (patchset ? "patchset: " : "changeset: ") + sqlite3_errstr(rc);
+        return -1;
+    }
+
+    // sessions cannot be reset, so the recording is restarted with a new one; the changes are returned in any case
+    sqlite3session_delete(session);
+    session = nullptr;
+    start(restart_error);
+    return 0;
+}
+
+int QoreSqlite3Session::apply(sqlite3* db, const BinaryNode* changeset, const ResolvedCallReferenceNode* handler,
+        QoreSqlite3ConflictAction action, ExceptionSink* xsink) {
+    QoreSqlite3ApplyContext ctx = {handler, action, xsink};
+    int rc = sqlite3changeset_apply(db, (int)changeset->size(), const_cast<void*>(changeset->getPtr()), nullptr,
+        conflict_handler, &ctx);
+    if (*xsink) {
+        return -1;
+    }
+    if (rc != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-SESSION-ERROR", "cannot apply the changeset: %s", rc == SQLITE_ABORT
+            ? "aborted because of a conflict" : sqlite3_errmsg(db));
+        return -1;
+    }
+    return 0;
+}
+#else
+QoreSqlite3Session* QoreSqlite3Session::create(sqlite3* db, const QoreValue tables, ExceptionSink* xsink) {
+    xsink->raiseException("SQLITE3-SESSION-ERROR", "the sqlite3 library was built without session support "
+        "(SQLITE_ENABLE_SESSION)");
+    return nullptr;
+}
+
+QoreSqlite3Session::~QoreSqlite3Session() {
+}
+
+int QoreSqlite3Session::start(std::string& err) {
+    assert(false);
+    return -1;
+}
+
+int QoreSqlite3Session::take(bool patchset, int& size, void*& data, std::string& err) {
+    assert(false);
+    return -1;
+}
+
+int QoreSqlite3Session::apply(sqlite3* db, const BinaryNode* changeset, const ResolvedCallReferenceNode* handler,
+        QoreSqlite3ConflictAction action, ExceptionSink* xsink) {
+    create(db, QoreValue(), xsink);
+    return -1;
+}
+#endif
@@ -0,0 +1,107 @@
+/*
+  sqlite3session.h
+
+  Qore Programming Language
+
+  Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SQLITE3SESSION_H
+#define SQLITE3SESSION_H
+
+#include <sqlite3.h>
+#include <qore/Qore.h>
+
+#include <string>
+#include <vector>
+
+//! The action taken for a conflict when applying a changeset
+enum QoreSqlite3ConflictAction {
+    SQLITE3_CONFLICT_ABORT,
+    SQLITE3_CONFLICT_OMIT,
+    SQLITE3_CONFLICT_REPLACE,
+};
+
+/*! \brief Captures the changes made on a connection with the sqlite3 session extension.
+
+    Changes to the attached tables are recorded from the time the session is created; take() returns them as a
+    changeset or patchset and restarts the recording, so that each changeset contains the changes made since the
+    previous one.
+
+    Requires an sqlite3 library built with SQLITE_ENABLE_SESSION and SQLITE_ENABLE_PREUPDATE_HOOK; otherwise create()
+    and apply() raise an exception.
+*/
+class QoreSqlite3Session {
+public:
+    /*! \brief Starts recording changes on the given connection.
+
+        \param db the connection
+        \param tables a table name, a list of table names or \c "*" for all tables
+        \param xsink exception handler
+
+        \retval QoreSqlite3Session* the new session; nullptr on error
+    */
+    DLLLOCAL static QoreSqlite3Session* create(sqlite3* db, const QoreValue tables, ExceptionSink* xsink);
+
+    DLLLOCAL ~QoreSqlite3Session();
+
+    //! Returns the list of attached tables
+    DLLLOCAL QoreListNode* getTables() const;
+
+    /*! \brief Returns the changes recorded so far and restarts the recording.
+
+        The changes are returned even if the recording cannot be restarted; the restart error is then reported by
+        the next call, as the changes made in between have not been recorded.
+
+        \param patchset if true, a patchset is returned, which omits the original values of updated and deleted rows
+        \param size set to the size of the changeset or patchset
+        \param data set to the changeset or patchset, to be freed with sqlite3_free()
+        \param err set to the error message on error
+
+        \retval int 0 on success, -1 on error
+    */
+    DLLLOCAL int take(bool patchset, int& size, void*& data, std::string& err);
+
+    /*! \brief Applies a changeset to the given connection.
+
+        \param db the connection
+        \param changeset the changeset or patchset
+        \param handler an optional conflict handler; if set, it is called for each conflict and returns the action
+        \param action the action for conflicts if there is no handler
+        \param xsink exception handler
+
+        \retval int 0 on success, -1 on error
+    */
+    DLLLOCAL static int apply(sqlite3* db, const BinaryNode* changeset, const ResolvedCallReferenceNode* handler,
+            QoreSqlite3ConflictAction action, ExceptionSink* xsink);
+
+private:
+    sqlite3* db;
+    //! The attached tables; empty if all tables are attached
+    std::vector<std::string> tables;
+    struct sqlite3_session* session = nullptr;
+    //! The error that kept the recording from being restarted after the last changeset was taken
+    std::string restart_error;
+
+    DLLLOCAL QoreSqlite3Session(sqlite3* db) : db(db) {
+    }
+
+    //! Creates the sqlite3 session and attaches the tables
+    DLLLOCAL int start(std::string& err);
+};
+
+#endif
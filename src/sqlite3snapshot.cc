@@ -0,0 +1,138 @@
+/*
+    sqlite3snapshot.cc
+
+    Qore Programming Language
+
+    Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "sqlite3snapshot.h"
+#include "config.h"
+
+#include <map>
+#include <mutex>
+
+bool QoreSqlite3Snapshot::isSupported() {
+#ifdef HAVE_SQLITE3_SNAPSHOT
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef HAVE_SQLITE3_SNAPSHOT
+// the registry of snapshots by handle
+typedef std::map<int64, QoreSqlite3Snapshot*> snapshot_map_t;
+static snapshot_map_t snapshot_map;
+static std::mutex snapshot_map_lock;
+static int64 snapshot_seq = 0;
+
+QoreSqlite3Snapshot* QoreSqlite3Snapshot::capture(sqlite3* db, std::string& err) {
+    const char* fn = sqlite3_db_filename(db, "main");
+    if (!fn || !*fn) {
+        err = "snapshots are only supported for WAL database files";
+        return nullptr;
+    }
+
+    sqlite3_snapshot* snapshot;
+    int rc = sqlite3_snapshot_get(db, "main", &snapshot);
+    if (rc != SQLITE_OK) {
+        err = std::string("cannot capture a snapshot (the database must be in WAL mode and the connection must be "
+            "in a transaction without uncommitted changes): ") + sqlite3_errstr(rc);
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> l(snapshot_map_lock);
+    QoreSqlite3Snapshot* s = new QoreSqlite3Snapshot(++snapshot_seq, fn, snapshot);
+    snapshot_map[s->id] = s;
+    return s;
+}
+
+QoreSqlite3Snapshot* QoreSqlite3Snapshot::capture(sqlite3* db, ExceptionSink* xsink) {
+    std::string err;
+    QoreSqlite3Snapshot* s = capture(db, err);
+    if (!s) {
+        xsink->raiseException("SQLITE3-SNAPSHOT-ERROR", "%s", err.c_str());
+    }
+    return s;
+}
+
+QoreSqlite3Snapshot* QoreSqlite3Snapshot::find(int64 id, ExceptionSink* xsink) {
+    std::lock_guard<std::mutex> l(snapshot_map_lock);
+    snapshot_map_t::iterator i = snapshot_map.find(id);
+    if (i == snapshot_map.end()) {
+        xsink->raiseException("SQLITE3-SNAPSHOT-ERROR", "snapshot " QLLD " does not exist or has already been "
+            "released", id);
+        return nullptr;
+    }
+    ++i->second->refs;
+    return i->second;
+}
+
+int QoreSqlite3Snapshot::open(sqlite3* db, ExceptionSink* xsink) {
+    const char* fn = sqlite3_db_filename(db, "main");
+    if (!fn || filename != fn) {
+        xsink->raiseException("SQLITE3-SNAPSHOT-ERROR", "snapshot " QLLD " was taken from '%s' and cannot be opened "
+            "on a connection to '%s'", id, filename.c_str(), fn ? fn : "");
+        return -1;
+    }
+
+    int rc = sqlite3_snapshot_open(db, "main", snapshot);
+    if (rc != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-SNAPSHOT-ERROR", "cannot open snapshot " QLLD "%s: %s", id,
+            rc == SQLITE_ERROR_SNAPSHOT ? " (it has been overwritten by a checkpoint)" : "", sqlite3_errstr(rc));
+        return -1;
+    }
+    return 0;
+}
+
+void QoreSqlite3Snapshot::deref() {
+    {
+        std::lock_guard<std::mutex> l(snapshot_map_lock);
+        if (--refs) {
+            return;
+        }
+        snapshot_map.erase(id);
+    }
+    sqlite3_snapshot_free(snapshot);
+    delete this;
+}
+#else
+QoreSqlite3Snapshot* QoreSqlite3Snapshot::capture(sqlite3* db, std::string& err) {
+    err = "the sqlite3 library was built without snapshot support (SQLITE_ENABLE_SNAPSHOT)";
+    return nullptr;
+}
+
+QoreSqlite3Snapshot* QoreSqlite3Snapshot::capture(sqlite3* db, ExceptionSink* xsink) {
+    xsink->raiseException("SQLITE3-SNAPSHOT-ERROR", "the sqlite3 library was built without snapshot support "
+        "(SQLITE_ENABLE_SNAPSHOT)");
+    return nullptr;
+}
+
+QoreSqlite3Snapshot* QoreSqlite3Snapshot::find(int64 id, ExceptionSink* xsink) {
+    return capture(nullptr, xsink);
+}
+
+int QoreSqlite3Snapshot::open(sqlite3* db, ExceptionSink* xsink) {
+    assert(false);
+    return -1;
+}
+
+void QoreSqlite3Snapshot::deref() {
+    assert(false);
+}
+#endif
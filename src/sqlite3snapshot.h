@@ -0,0 +1,95 @@
+/*
+  sqlite3snapshot.h
+
+  Qore Programming Language
+
+  Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SQLITE3SNAPSHOT_H
+#define SQLITE3SNAPSHOT_H
+
+#include <sqlite3.h>
+#include <qore/Qore.h>
+
+#include <string>
+
+/*! \brief A registered WAL read snapshot that can be shared between connections.
+
+    Snapshots are identified by integer handles so that they can be passed between connections through driver
+    options; they are reference-counted and freed when the last reference is released.  A snapshot can only be opened
+    as long as it has not been overwritten by a checkpoint, which is guaranteed while the transaction that captured it
+    is still open.
+
+    Requires an sqlite3 library built with SQLITE_ENABLE_SNAPSHOT; otherwise capture() and find() raise an exception.
+*/
+class QoreSqlite3Snapshot {
+public:
+    /*! \brief Captures and registers a snapshot of the main database of the given connection.
+
+        \param db a connection that is not in autocommit mode and has no write transaction open
+        \param xsink exception handler
+
+        \retval QoreSqlite3Snapshot* a snapshot with one reference for the caller; nullptr on error
+    */
+    DLLLOCAL static QoreSqlite3Snapshot* capture(sqlite3* db, ExceptionSink* xsink);
+
+    //! Captures a snapshot like capture(sqlite3*, ExceptionSink*) but returns the error message in \a err
+    DLLLOCAL static QoreSqlite3Snapshot* capture(sqlite3* db, std::string& err);
+
+    /*! \brief Returns a referenced snapshot for the given handle.
+
+        \retval QoreSqlite3Snapshot* a snapshot with a new reference for the caller; nullptr on error
+    */
+    DLLLOCAL static QoreSqlite3Snapshot* find(int64 id, ExceptionSink* xsink);
+
+    /*! \brief Starts or upgrades the read transaction of the given connection to refer to this snapshot.
+
+        \param db a connection to the same database file that is not in autocommit mode
+        \param xsink exception handler
+
+        \retval int 0 on success, -1 on error
+    */
+    DLLLOCAL int open(sqlite3* db, ExceptionSink* xsink);
+
+    //! Returns true if the sqlite3 library supports snapshots
+    DLLLOCAL static bool isSupported();
+
+    //! Returns the handle of the snapshot
+    DLLLOCAL int64 getId() const {
+        return id;
+    }
+
+    //! Releases a reference
+    DLLLOCAL void deref();
+
+private:
+    //! The handle
+    int64 id;
+    //! The database file the snapshot was taken from
+    std::string filename;
+    //! The snapshot
+    sqlite3_snapshot* snapshot;
+    //! Reference count; protected by the registry lock
+    int refs = 1;
+
+    DLLLOCAL QoreSqlite3Snapshot(int64 id, const char* filename, sqlite3_snapshot* snapshot)
+            : id(id), filename(filename), snapshot(snapshot) {
+    }
+};
+
+#endif
@@ -0,0 +1,85 @@
+/*
+    sqlite3stmtcache.cc
+
+    Qore Programming Language
+
+    Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "sqlite3stmtcache.h"
+
+void QoreSqlite3StatementCache::setMaxSize(size_t size) {
+    max_size = size;
+    trim(max_size);
+}
+
+sqlite3_stmt* QoreSqlite3StatementCache::take(const std::string& sql) {
+    auto i = index.find(sql);
+    if (i == index.end()) {
+        ++misses;
+        return nullptr;
+    }
+    ++hits;
+    sqlite3_stmt* stmt = i->second->second;
+    entries.erase(i->second);
+    index.erase(i);
+    return stmt;
+}
+
+void QoreSqlite3StatementCache::put(const std::string& sql, sqlite3_stmt* stmt) {
+    // a statement that is not reset keeps its read transaction open
+    sqlite3_reset(stmt);
+    if (!max_size || index.find(sql) != index.end()) {
+        sqlite3_finalize(stmt);
+        return;
+    }
+    sqlite3_clear_bindings(stmt);
+    trim(max_size - 1);
+    entries.emplace_front(sql, stmt);
+    index[sql] = entries.begin();
+}
+
+void QoreSqlite3StatementCache::clear() {
+    trim(0);
+}
+
+void QoreSqlite3StatementCache::trim(size_t size) {
+    while (entries.size() > size) {
+        index.erase(entries.back().first);
+        sqlite3_finalize(entries.back().second);
+        entries.pop_back();
+    }
+}
+
+int64 QoreSqlite3StatementCache::getReprepares() const {
+    int64 rv = 0;
+#ifdef SQLITE_STMTSTATUS_REPREPARE
+    for (const auto& e : entries) {
+        rv += sqlite3_stmt_status(e.second, SQLITE_STMTSTATUS_REPREPARE, 0);
+    }
+#endif
+    return rv;
+}
+
+QoreHashNode* QoreSqlite3StatementCache::getStats(ExceptionSink* xsink) const {
+    ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+    h->setKeyValue("entries", (int64)entries.size(), xsink);
+    h->setKeyValue("max_size", (int64)max_size, xsink);
+    h->setKeyValue("hits", hits, xsink);
+    h->setKeyValue("misses", misses, xsink);
+    return h.release();
+}
@@ -0,0 +1,96 @@
+/*
+  sqlite3stmtcache.h
+
+  Qore Programming Language
+
+  Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SQLITE3STMTCACHE_H
+#define SQLITE3STMTCACHE_H
+
+#include <sqlite3.h>
+#include <qore/Qore.h>
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+/*! \brief A cache of prepared statements on a connection, keyed by their SQL text.
+
+    A statement is removed from the cache while it is used, so that a statement that is run again before it is
+    finished, for example from an SQL function, is prepared separately; it is reset and its bindings are cleared
+    when it is returned.  SQLite prepares cached statements again automatically after schema changes.  The least
+    recently used statements are finalized when the cache is full.
+
+    A cache is only used by the thread that holds its connection, so it needs no locking.
+*/
+class QoreSqlite3StatementCache {
+public:
+    DLLLOCAL QoreSqlite3StatementCache(size_t max_size) : max_size(max_size) {
+    }
+
+    //! Finalizes all statements
+    DLLLOCAL ~QoreSqlite3StatementCache() {
+        clear();
+    }
+
+    //! Sets the maximum number of cached statements, finalizing statements if necessary
+    DLLLOCAL void setMaxSize(size_t size);
+
+    //! Returns the maximum number of cached statements
+    DLLLOCAL size_t getMaxSize() const {
+        return max_size;
+    }
+
+    /*! \brief Removes the statement for the given SQL text from the cache and returns it.
+
+        \retval sqlite3_stmt* the statement, which must be passed to put() or finalized; nullptr if the SQL text is
+        not in the cache
+    */
+    DLLLOCAL sqlite3_stmt* take(const std::string& sql);
+
+    //! Resets a statement and adds it to the cache under its SQL text, or finalizes it if it cannot be added
+    DLLLOCAL void put(const std::string& sql, sqlite3_stmt* stmt);
+
+    //! Finalizes all statements
+    DLLLOCAL void clear();
+
+    //! Returns the number of times the cached statements have been reprepared after schema changes
+    DLLLOCAL int64 getReprepares() const;
+
+    //! Returns a hash with the number of statements and hit and miss counters
+    DLLLOCAL QoreHashNode* getStats(ExceptionSink* xsink) const;
+
+private:
+    typedef std::list<std::pair<std::string, sqlite3_stmt*>> entry_list_t;
+
+    size_t max_size;
+
+    //! Statements in order of use, most recently used first
+    entry_list_t entries;
+    std::unordered_map<std::string, entry_list_t::iterator> index;
+
+    // statistics
+    int64 hits = 0;
+    int64 misses = 0;
+
+    //! Finalizes the least recently used statements until the cache has no more than the given number
+    DLLLOCAL void trim(size_t size);
+};
+
+#endif
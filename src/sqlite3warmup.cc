@@ -0,0 +1,228 @@
+/*
+    sqlite3warmup.cc
+
+    Qore Programming Language
+
+    Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "sqlite3warmup.h"
+#include "sqlite3module.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#include <chrono>
+
+typedef std::chrono::steady_clock warmup_clock;
+
+//! A table or index to read
+struct QoreSqlite3WarmUpObject {
+    std::string name;
+    std::string table;
+    bool index;
+    bool is_virtual;
+};
+
+// returns the number of pages the connection has read into its page cache so far
+static int64 get_cache_misses(sqlite3* db) {
+    int cur = 0;
+    int hiwtr = 0;
+    sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_MISS, &cur, &hiwtr, 0);
+    return cur;
+}
+
+// steps through all rows of a statement without reading their values; returns an SQLite error code
+static int step_all(sqlite3_stmt* stmt) {
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    }
+    return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+// prepares and runs a statement without reading its rows; returns an SQLite error code
+static int run_statement(sqlite3* db, const std::string& sql) {
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    ON_BLOCK_EXIT(sqlite3_finalize, stmt);
+    return step_all(stmt);
+}
+
+// returns a statement of a warm-up string without surrounding whitespace and a terminating semicolon, which is
+// the SQL text that it is cached under
+static std::string get_statement_text(const char* start, const char* end) {
+    while (start < end && isspace((unsigned char)*start)) {
+        ++start;
+    }
+    while (end > start && isspace((unsigned char)end[-1])) {
+        --end;
+    }
+    if (end > start && end[-1] == ';') {
+        --end;
+        while (end > start && isspace((unsigned char)end[-1])) {
+            --end;
+        }
+    }
+    return std::string(start, end - start);
+}
+
+// prepares the read-only statements in an SQL string and adds them to the statement cache
+static int prepare_statements(sqlite3* db, unsigned flags, QoreSqlite3StatementCache* cache, const std::string& sql,
+        QoreSqlite3WarmUpResult& result, ExceptionSink* xsink) {
+    const char* p = sql.c_str();
+    const char* end = p + sql.size();
+    while (p < end) {
+        sqlite3_stmt* stmt;
+        const char* tail;
+        if (qore_sqlite3_prepare(db, p, end - p, flags | SQLITE_PREPARE_PERSISTENT, &stmt, &tail) != SQLITE_OK) {
+            xsink->raiseException("SQLITE3-WARMUP-ERROR", "cannot prepare warm-up statement '%s': %s", sql.c_str(),
+                sqlite3_errmsg(db));
+            return -1;
+        }
+        std::string text = get_statement_text(p, tail);
+        p = tail;
+        // the rest of the string is only whitespace or comments
+        if (!stmt) {
+            continue;
+        }
+        // a warm-up must not change the database, as it is repeated for every new connection
+        if (!sqlite3_stmt_readonly(stmt)) {
+            sqlite3_finalize(stmt);
+            xsink->raiseException("SQLITE3-WARMUP-ERROR", "warm-up statement '%s' is not read-only", text.c_str());
+            return -1;
+        }
+        cache->put(text, stmt);
+        ++result.statements;
+    }
+    return 0;
+}
+
+// returns the tables and indexes for a name, or all of them for "*"
+static int get_objects(sqlite3* db, const std::string& schema, const std::string& name,
+        std::vector<QoreSqlite3WarmUpObject>& objects, ExceptionSink* xsink) {
+    bool all = name == "*";
+    // automatic indexes for unique and primary key constraints are read, internal tables are not
+    std::string sql = "select type, name, tbl_name, sql like 'create virtual table%' from "
+        + qore_sqlite3_quote_identifier(schema) + ".sqlite_master where type in ('table', 'index') and "
+        + (all ? std::string("(type = 'index' or name not like 'sqlite\\_%' escape '\\')") : "name = ?1");
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-WARMUP-ERROR", "cannot read the schema of database '%s': %s",
+            schema.c_str(), sqlite3_errmsg(db));
+        return -1;
+    }
+    ON_BLOCK_EXIT(sqlite3_finalize, stmt);
+    if (!all) {
+        sqlite3_bind_text(stmt, 1, name.c_str(), name.size(), SQLITE_STATIC);
+    }
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        objects.push_back(QoreSqlite3WarmUpObject{(const char*)sqlite3_column_text(stmt, 1),
+            (const char*)sqlite3_column_text(stmt, 2), !strcmp((const char*)sqlite3_column_text(stmt, 0), "index"),
+            (bool)sqlite3_column_int(stmt, 3)});
+    }
+    if (rc != SQLITE_DONE) {
+        xsink->raiseException("SQLITE3-WARMUP-ERROR", "cannot read the schema of database '%s': %s",
+            schema.c_str(), sqlite3_errmsg(db));
+        return -1;
+    }
+    if (!all && objects.empty()) {
+        xsink->raiseException("SQLITE3-WARMUP-ERROR", "no table or index '%s' in database '%s'", name.c_str(),
+            schema.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+// reads all pages of the tables and indexes for a name with full scans that select no columns
+static int read_objects(sqlite3* db, const std::string& spec, QoreSqlite3WarmUpResult& result,
+        ExceptionSink* xsink) {
+    size_t dot = spec.find('.');
+    std::string schema = dot == std::string::npos ? "main" : spec.substr(0, dot);
+    std::string name = dot == std::string::npos ? spec : spec.substr(dot + 1);
+    bool all = name == "*";
+
+    std::vector<QoreSqlite3WarmUpObject> objects;
+    if (get_objects(db, schema, name, objects, xsink)) {
+        return -1;
+    }
+    for (const QoreSqlite3WarmUpObject& obj : objects) {
+        // scanning virtual tables can be expensive; their shadow tables are read instead
+        if (all && obj.is_virtual) {
+            continue;
+        }
+        std::string sql = "select 1 from " + qore_sqlite3_quote_identifier(schema) + "."
+            + qore_sqlite3_quote_identifier(obj.table);
+        if (obj.index) {
+            sql += " indexed by " + qore_sqlite3_quote_identifier(obj.name);
+        } else if (!obj.is_virtual) {
+            sql += " not indexed";
+        }
+        if (run_statement(db, sql) != SQLITE_OK) {
+            // partial indexes cannot be scanned without their condition
+            if (all && obj.index) {
+                continue;
+            }
+            xsink->raiseException("SQLITE3-WARMUP-ERROR", "cannot read %s '%s': %s", obj.index ? "index" : "table",
+                obj.name.c_str(), sqlite3_errmsg(db));
+            return -1;
+        }
+        ++result.objects;
+    }
+    return 0;
+}
+
+QoreHashNode* QoreSqlite3WarmUpResult::getHash(ExceptionSink* xsink) const {
+    ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+    h->setKeyValue("statements", statements, xsink);
+    h->setKeyValue("objects", objects, xsink);
+    h->setKeyValue("pages", pages, xsink);
+    h->setKeyValue("duration_us", duration_us, xsink);
+    return h.release();
+}
+
+int QoreSqlite3WarmUp::run(sqlite3* db, unsigned flags, QoreSqlite3StatementCache* cache,
+        const std::vector<std::string>& sql, const std::vector<std::string>& objects, QoreSqlite3WarmUpResult& result,
+        ExceptionSink* xsink) {
+    warmup_clock::time_point start = warmup_clock::now();
+    int64 misses = get_cache_misses(db);
+    result = QoreSqlite3WarmUpResult();
+
+    // preparing any statement parses the schema of all databases on the connection
+    if (run_statement(db, "select 1 from sqlite_master limit 1") != SQLITE_OK) {
+        xsink->raiseException("SQLITE3-WARMUP-ERROR", "cannot load the schema: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+    for (const std::string& s : sql) {
+        if (prepare_statements(db, flags, cache, s, result, xsink)) {
+            return -1;
+        }
+    }
+    for (const std::string& o : objects) {
+        if (read_objects(db, o, result, xsink)) {
+            return -1;
+        }
+    }
+
+    result.pages = get_cache_misses(db) - misses;
+    result.duration_us = std::chrono::duration_cast<std::chrono::microseconds>(warmup_clock::now()
+        - start).count();
+    return 0;
+}
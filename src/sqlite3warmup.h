@@ -0,0 +1,75 @@
+/*
+  sqlite3warmup.h
+
+  Qore Programming Language
+
+  Copyright 2003 - 2026 Qore Technologies, s.r.o <http://qore.org>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SQLITE3WARMUP_H
+#define SQLITE3WARMUP_H
+
+#include "sqlite3stmtcache.h"
+
+#include <sqlite3.h>
+#include <qore/Qore.h>
+
+#include <string>
+#include <vector>
+
+//! Results of the last warm-up of a connection
+struct QoreSqlite3WarmUpResult {
+    //! the number of warm-up statements prepared
+    int64 statements = 0;
+    //! the number of tables and indexes read
+    int64 objects = 0;
+    //! the number of pages read into the page cache
+    int64 pages = 0;
+    //! the duration of the warm-up in microseconds
+    int64 duration_us = 0;
+
+    //! Returns the results as a hash
+    DLLLOCAL QoreHashNode* getHash(ExceptionSink* xsink) const;
+};
+
+/*! \brief Moves the work of the first requests on a new connection to the time it is opened.
+
+    A warm-up loads the schema of all databases on the connection, prepares the given read-only statements and adds
+    them to the statement cache, so that they are not compiled again when they are first run, and reads every page
+    of the given tables and indexes into the page cache with full scans that do not read column values.
+*/
+class QoreSqlite3WarmUp {
+public:
+    /*! \brief Warms up a connection.
+
+        \param db the connection
+        \param flags the SQLITE_PREPARE_* flags for the statements
+        \param cache the statement cache that prepared statements are added to
+        \param sql read-only SQL statements to prepare
+        \param objects names of tables and indexes to read, optionally qualified with a schema name; \c "*" or
+        \c "schema.*" reads all tables and indexes of a database
+        \param result updated with the results of the warm-up
+        \param xsink exception handler
+
+        \retval int 0 on success, -1 on error
+    */
+    DLLLOCAL static int run(sqlite3* db, unsigned flags, QoreSqlite3StatementCache* cache,
+            const std::vector<std::string>& sql, const std::vector<std::string>& objects,
+            QoreSqlite3WarmUpResult& result, ExceptionSink* xsink);
+};
+
+#endif